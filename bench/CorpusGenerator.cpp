@@ -0,0 +1,200 @@
+#include "CorpusGenerator.hpp"
+#include <string>
+
+namespace onyx::bench {
+
+namespace {
+
+class LineWriter {
+public:
+    explicit LineWriter(std::ostream& out) : m_out(out) {}
+
+    void line(int depth, std::string_view text) {
+        m_out << std::string(static_cast<std::size_t>(depth) * 4, ' ') << text << '\n';
+        m_lines++;
+    }
+    [[nodiscard]] std::size_t lines() const { return m_lines; }
+
+private:
+    std::ostream& m_out;
+    std::size_t m_lines = 0;
+};
+
+std::string num(std::size_t n) {
+    return std::to_string(n);
+}
+
+// Shared declarations every unit can rely on.
+void writePrologue(LineWriter& w) {
+    w.line(0, "@include \"stdio.h\"");
+    w.line(0, "@include \"stdint.h\"");
+    w.line(0, "@include \"stdbool.h\"");
+    w.line(0, "");
+    w.line(0, "shared Position {");
+    w.line(1, "x: f32");
+    w.line(1, "y: f32");
+    w.line(1, "z: f32");
+    w.line(0, "}");
+    w.line(0, "");
+    w.line(0, "shared Health {");
+    w.line(1, "hp: i32");
+    w.line(1, "max_hp: i32");
+    w.line(1, "alive: bool");
+    w.line(0, "}");
+    w.line(0, "");
+    w.line(0, "struct Counter {");
+    w.line(1, "value: i32");
+    w.line(0, "}");
+    w.line(0, "");
+    w.line(0, "resolve Counter {");
+    w.line(1, "fn reset() -> void {");
+    w.line(2, "self.value = 0");
+    w.line(1, "}");
+    w.line(1, "fn add(n: i32) -> void {");
+    w.line(2, "self.value = self.value + n");
+    w.line(1, "}");
+    w.line(1, "fn get() -> i32 {");
+    w.line(2, "return self.value");
+    w.line(1, "}");
+    w.line(0, "}");
+    w.line(0, "");
+    w.line(0, "fn inc(v: i32) -> i32 {");
+    w.line(1, "return v + 1");
+    w.line(0, "}");
+    w.line(0, "");
+    w.line(0, "fn scale(k: i32, v: i32) -> i32 {");
+    w.line(1, "return v * k");
+    w.line(0, "}");
+    w.line(0, "");
+}
+
+void writeStructs(LineWriter& w, std::size_t id) {
+    w.line(0, "@[aligned(8)]");
+    w.line(0, "struct Entity" + num(id) + " {");
+    w.line(1, "use Position");
+    w.line(1, "use Health");
+    w.line(1, "tag: u32");
+    w.line(1, "flags: u8");
+    w.line(1, "weight: f64");
+    w.line(1, "next: ptr");
+    w.line(0, "}");
+    w.line(0, "");
+}
+
+void writeResolve(LineWriter& w, std::size_t id, const CorpusOptions& options) {
+    const std::string type = "Body" + num(id);
+    w.line(0, "struct " + type + " {");
+    w.line(1, "use Position");
+    w.line(1, "count: i32");
+    w.line(0, "}");
+    w.line(0, "");
+    w.line(0, "resolve " + type + " {");
+    w.line(1, "fn step(n: i32) -> i32 {");
+    w.line(2, "var acc: i32 = 0");
+    int depth = 2;
+    for (std::size_t d = 0; d < options.nestDepth; ++d, ++depth) {
+        if (d % 2 == 0) w.line(depth, "if n > " + num(d) + " {");
+        else w.line(depth, "while acc < n {");
+        w.line(depth + 1, "acc = acc + self.count");
+    }
+    for (std::size_t d = options.nestDepth; d > 0; --d) {
+        --depth;
+        if ((d - 1) % 2 == 1) w.line(depth + 1, "acc = acc + 1");
+        w.line(depth, "}");
+    }
+    w.line(2, "return acc");
+    w.line(1, "}");
+    w.line(0, "");
+    w.line(1, "fn reset() -> void {");
+    w.line(2, "self.count = 0");
+    w.line(2, "self.x = 0");
+    w.line(1, "}");
+    w.line(0, "}");
+    w.line(0, "");
+}
+
+void writePipes(LineWriter& w, std::size_t id, const CorpusOptions& options) {
+    w.line(0, "fn pipeline" + num(id) + "(seed: i32) -> i32 {");
+    std::string chain = "seed";
+    for (std::size_t i = 0; i < options.pipeLength; ++i) {
+        chain += (i % 3 == 0) ? " |> inc(_)" : (i % 3 == 1) ? " |> scale(2, _)" : " |> inc()";
+    }
+    w.line(1, "var result: i32 = " + chain);
+    w.line(1, "result |> printf(\"pipeline" + num(id) + " %d\\n\", _)");
+    w.line(1, "return result");
+    w.line(0, "}");
+    w.line(0, "");
+}
+
+void writeMethods(LineWriter& w, std::size_t id, const CorpusOptions& options) {
+    w.line(0, "fn methods" + num(id) + "() -> i32 {");
+    w.line(1, "var c: Counter");
+    w.line(1, "c.reset()");
+    for (std::size_t i = 0; i < options.methodCalls; ++i) {
+        w.line(1, "c.add(" + num(i % 7 + 1) + ")");
+    }
+    w.line(1, "return c.get()");
+    w.line(0, "}");
+    w.line(0, "");
+}
+
+void writeNative(LineWriter& w, std::size_t id, const CorpusOptions& options) {
+    // native blocks end at the first line containing a closing brace, so the
+    // body sticks to brace-free C.
+    w.line(0, "native {");
+    for (std::size_t i = 0; i < options.nativeLines; ++i) {
+        const std::string name = "native_" + num(id) + "_" + num(i);
+        if (i % 2 == 0) w.line(1, "#define " + name + "_SCALE (" + num(i) + " * 3 + 1)");
+        else w.line(1, "static const int " + name + " = " + num(i) + " << 2;");
+    }
+    w.line(0, "}");
+    w.line(0, "");
+}
+
+} // namespace
+
+std::string_view mixName(FeatureMix mix) {
+    switch (mix) {
+    case FeatureMix::Structs: return "structs";
+    case FeatureMix::Resolve: return "resolve";
+    case FeatureMix::Pipes: return "pipes";
+    case FeatureMix::Methods: return "methods";
+    case FeatureMix::Native: return "native";
+    case FeatureMix::Mixed: return "mixed";
+    }
+    return "unknown";
+}
+
+std::optional<FeatureMix> parseMix(std::string_view name) {
+    for (FeatureMix mix : ALL_MIXES) {
+        if (mixName(mix) == name) return mix;
+    }
+    return std::nullopt;
+}
+
+std::size_t generateCorpus(const CorpusOptions& options, std::ostream& out) {
+    LineWriter w(out);
+    writePrologue(w);
+
+    // main() closes the file, so stop short of the target by its size.
+    const std::size_t target = options.lines > 4 ? options.lines - 4 : 0;
+    for (std::size_t id = 0; w.lines() < target; ++id) {
+        FeatureMix mix = options.mix;
+        if (mix == FeatureMix::Mixed) mix = ALL_MIXES[id % (std::size(ALL_MIXES) - 1)];
+        switch (mix) {
+        case FeatureMix::Structs: writeStructs(w, id); break;
+        case FeatureMix::Resolve: writeResolve(w, id, options); break;
+        case FeatureMix::Pipes: writePipes(w, id, options); break;
+        case FeatureMix::Methods: writeMethods(w, id, options); break;
+        case FeatureMix::Native: writeNative(w, id, options); break;
+        case FeatureMix::Mixed: break;
+        }
+    }
+
+    w.line(0, "fn main() -> i32 {");
+    w.line(1, "return 0");
+    w.line(0, "}");
+    return w.lines();
+}
+
+} // namespace onyx::bench
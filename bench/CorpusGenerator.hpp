@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <ostream>
+#include <string_view>
+
+namespace onyx::bench {
+
+// Which language features a synthetic corpus exercises.
+enum class FeatureMix {
+    Structs, // many structs built from `use` mixins
+    Resolve, // resolve blocks with deeply nested control flow
+    Pipes,   // long |> chains with placeholders
+    Methods, // dense obj.method() sugar
+    Native,  // large native { } blocks
+    Mixed    // all of the above, interleaved
+};
+
+inline constexpr FeatureMix ALL_MIXES[] = {
+    FeatureMix::Structs, FeatureMix::Resolve, FeatureMix::Pipes,
+    FeatureMix::Methods, FeatureMix::Native, FeatureMix::Mixed,
+};
+
+std::string_view mixName(FeatureMix mix);
+std::optional<FeatureMix> parseMix(std::string_view name);
+
+struct CorpusOptions {
+    FeatureMix mix = FeatureMix::Mixed;
+    std::size_t lines = 1000;     // approximate target; whole units are emitted
+    std::size_t pipeLength = 24;  // stages per |> chain
+    std::size_t nestDepth = 6;    // block depth inside resolve methods
+    std::size_t methodCalls = 32; // calls per method-sugar function
+    std::size_t nativeLines = 64; // lines per native block
+};
+
+// Writes a deterministic, valid .ox program of roughly `options.lines` lines.
+// Returns the number of lines written.
+std::size_t generateCorpus(const CorpusOptions& options, std::ostream& out);
+
+} // namespace onyx::bench
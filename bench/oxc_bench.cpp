@@ -0,0 +1,219 @@
+#include "CorpusGenerator.hpp"
+#include "../src/Transpiler.hpp"
+#include "../src/ThreadPool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// Throughput benchmark for the transpiler. Generates synthetic corpora of a
+// given feature mix and size, runs them through Transpiler::processFile and
+// reports per-pass timings. JSON output is meant to be archived per commit so
+// regressions can be diffed mechanically.
+
+namespace {
+
+using onyx::bench::FeatureMix;
+
+void printUsage(const std::string& programName) {
+    std::cout << "usage: " + programName + " [--mix <name|all>] [--lines N[,N...]] [--repeat R] [-j <jobs>]\n"
+                 "           [--format json|text] [--keep <dir>]\n"
+                 "       " + programName + " --generate <mix> <lines> <output.ox>\n"
+                 "mixes: structs resolve pipes methods native mixed\n";
+}
+
+struct Result {
+    FeatureMix mix;
+    std::size_t lines = 0;
+    std::uintmax_t bytes = 0;
+    onyx::PassTimings best;
+};
+
+std::vector<std::size_t> parseSizes(const std::string& list) {
+    std::vector<std::size_t> sizes;
+    std::stringstream stream(list);
+    for (std::string item; std::getline(stream, item, ',');) {
+        if (!item.empty()) sizes.push_back(std::stoul(item));
+    }
+    return sizes;
+}
+
+double seconds(std::chrono::nanoseconds ns) {
+    return std::chrono::duration<double>(ns).count();
+}
+
+void writePass(std::ostream& out, const char* name, std::chrono::nanoseconds ns, const Result& r) {
+    const double s = seconds(ns);
+    const double lps = s > 0 ? static_cast<double>(r.lines) / s : 0.0;
+    const double bps = s > 0 ? static_cast<double>(r.bytes) / s : 0.0;
+    char buffer[160];
+    std::snprintf(buffer, sizeof(buffer),
+                  "\"%s\":{\"seconds\":%.6f,\"lines_per_sec\":%.0f,\"bytes_per_sec\":%.0f}",
+                  name, s, lps, bps);
+    out << buffer;
+}
+
+void writeJson(std::ostream& out, const std::vector<Result>& results, unsigned repeat, unsigned jobs) {
+    out << "{\"tool\":\"oxc_bench\",\"version\":1,\"repeat\":" << repeat << ",\"jobs\":" << jobs
+        << ",\"results\":[";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << (i ? ",\n" : "\n") << "{\"mix\":\"" << onyx::bench::mixName(r.mix) << "\",\"lines\":" << r.lines
+            << ",\"bytes\":" << r.bytes << ",\"passes\":{";
+        writePass(out, "load", r.best.load, r);
+        out << ',';
+        writePass(out, "discovery", r.best.discovery, r);
+        out << ',';
+        writePass(out, "transpilation", r.best.transpilation, r);
+        out << ',';
+        writePass(out, "write", r.best.write, r);
+        out << ',';
+        writePass(out, "total", r.best.total(), r);
+        out << "}}";
+    }
+    out << "\n]}\n";
+}
+
+void writeText(std::ostream& out, const std::vector<Result>& results) {
+    char buffer[200];
+    std::snprintf(buffer, sizeof(buffer), "%-8s %10s %12s %10s %10s %10s %10s %10s %14s\n", "mix", "lines", "bytes",
+                  "load", "discovery", "transpile", "write", "total", "lines/s");
+    out << buffer;
+    for (const Result& r : results) {
+        const double total = seconds(r.best.total());
+        std::snprintf(buffer, sizeof(buffer), "%-8s %10zu %12ju %10.4f %10.4f %10.4f %10.4f %10.4f %14.0f\n",
+                      std::string(onyx::bench::mixName(r.mix)).c_str(), r.lines, r.bytes, seconds(r.best.load),
+                      seconds(r.best.discovery), seconds(r.best.transpilation), seconds(r.best.write), total,
+                      total > 0 ? static_cast<double>(r.lines) / total : 0.0);
+        out << buffer;
+    }
+}
+
+bool generateFile(FeatureMix mix, std::size_t lines, const std::filesystem::path& path, std::size_t& written) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    onyx::bench::CorpusOptions options;
+    options.mix = mix;
+    options.lines = lines;
+    written = onyx::bench::generateCorpus(options, out);
+    return static_cast<bool>(out);
+}
+
+} // namespace
+
+int main(const int argc, char* argv[]) {
+    std::vector<FeatureMix> mixes(std::begin(onyx::bench::ALL_MIXES), std::end(onyx::bench::ALL_MIXES));
+    std::vector<std::size_t> sizes = {1000, 10000, 100000};
+    unsigned repeat = 3;
+    unsigned jobs = 1;
+    bool json = true;
+    std::filesystem::path keepDir;
+
+    for (int i = 1; i < argc; ++i) try {
+        if (std::string arg = argv[i]; arg == "--mix" && i + 1 < argc) {
+            std::string name = argv[++i];
+            mixes.clear();
+            if (name == "all") {
+                mixes.assign(std::begin(onyx::bench::ALL_MIXES), std::end(onyx::bench::ALL_MIXES));
+            } else if (auto mix = onyx::bench::parseMix(name)) {
+                mixes.push_back(*mix);
+            } else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--lines" && i + 1 < argc)
+            sizes = parseSizes(argv[++i]);
+        else if (arg == "--repeat" && i + 1 < argc)
+            repeat = std::max(1u, static_cast<unsigned>(std::stoul(argv[++i])));
+        else if (arg == "-j" && i + 1 < argc)
+            jobs = static_cast<unsigned>(std::stoul(argv[++i]));
+        else if (arg == "--format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            if (format != "json" && format != "text") {
+                printUsage(argv[0]);
+                return 1;
+            }
+            json = format == "json";
+        } else if (arg == "--keep" && i + 1 < argc)
+            keepDir = argv[++i];
+        else if (arg == "--generate" && i + 3 < argc) {
+            auto mix = onyx::bench::parseMix(argv[i + 1]);
+            if (!mix) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            std::size_t written = 0;
+            if (!generateFile(*mix, std::stoul(argv[i + 2]), argv[i + 3], written)) {
+                std::cerr << "failed to write - " << argv[i + 3] << "\n";
+                return 1;
+            }
+            return 0;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    } catch (const std::exception&) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (sizes.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::error_code ec;
+    const bool keep = !keepDir.empty();
+    const std::filesystem::path workDir =
+        keep ? keepDir : std::filesystem::temp_directory_path() / ("oxc_bench-" + std::to_string(::getpid()));
+    std::filesystem::create_directories(workDir, ec);
+
+    std::unique_ptr<onyx::ThreadPool> pool;
+    if (jobs > 1) pool = std::make_unique<onyx::ThreadPool>(jobs);
+    onyx::TranspilerConfig config;
+    config.parallel = pool != nullptr;
+
+    std::vector<Result> results;
+    int status = 0;
+    for (FeatureMix mix : mixes) {
+        for (std::size_t size : sizes) {
+            const std::string stem = std::string(onyx::bench::mixName(mix)) + "-" + std::to_string(size);
+            const std::filesystem::path input = workDir / (stem + ".ox");
+            const std::filesystem::path output = workDir / (stem + ".c");
+
+            Result result;
+            result.mix = mix;
+            if (!generateFile(mix, size, input, result.lines)) {
+                std::cerr << "failed to write - " << input.string() << "\n";
+                return 1;
+            }
+            result.bytes = std::filesystem::file_size(input, ec);
+
+            // Keep the fastest run; later runs see a warm page cache either way.
+            for (unsigned run = 0; run < repeat; ++run) {
+                onyx::Transpiler transpiler(config, pool.get());
+                if (!transpiler.processFile(input, output)) {
+                    for (const auto& message : transpiler.diagnostics()) std::cerr << message << "\n";
+                    std::cerr << "failed to transpile - " << input.string() << "\n";
+                    status = 1;
+                    break;
+                }
+                if (run == 0 || transpiler.timings().total() < result.best.total()) result.best = transpiler.timings();
+            }
+            results.push_back(result);
+        }
+    }
+
+    if (!keep) std::filesystem::remove_all(workDir, ec);
+
+    if (json) writeJson(std::cout, results, repeat, jobs);
+    else writeText(std::cout, results);
+    return status;
+}
@@ -1,45 +1,342 @@
+#include "src/Server.hpp"
+#include "src/Subprocess.hpp"
 #include "src/Transpiler.hpp"
+#include "src/ThreadPool.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <set>
 #include <string>
+#include <thread>
+#include <vector>
 
 #define OX_IMPLEMENTATION_VERSION "0.0.1"
 #define OX_IMPLEMENTATION_DATE __DATE__ " " __TIME__
 
 void printUsage(const std::string& programName = "oxc") {
-    std::cout << "usage: " + programName + " <input.ox> [-o <output.c>]\n";
+    std::cout << "usage: " + programName + " <input.ox>... [-o <output.c>] [-d <outdir>] [-j <jobs>] [--serial] [--single-pass]\n"
+                 "           [-I <dir>] [--cache-dir <dir>] [-MD] [-MF <depfile>] [--stats[=text|json]] [--time-report]\n"
+                 "           [--layout-report] [--line-directives] [--source-map] [--instrument] [--profile-use <file>]\n"
+                 "           [--emit-header]\n"
+                 "       " + programName + " <input.ox> --cc <compiler> [--line-directives] [--instrument] [--profile-use <file>]\n"
+                 "           [-- <cflags>...]\n"
+                 "       " + programName + " --serve [--socket <path>] [-j <jobs>] [--serial] [--single-pass] [-I <dir>] [--cache-dir <dir>]\n";
 }
 
 void printVersion() {
     std::cout << OX_IMPLEMENTATION_VERSION << "\n";
 }
 
+struct Job {
+    std::filesystem::path input;
+    std::filesystem::path output;
+    std::filesystem::path depfile;
+    std::filesystem::path sourceMap;
+    std::filesystem::path header;
+    bool ok = false;
+    std::vector<std::string> diagnostics;
+    onyx::TranspileStats stats;
+    std::vector<onyx::StructLayout> layouts;
+};
+
+enum class StatsFormat { None, Text, Json };
+
+// Pipes the C for `job.input` into `<compiler> -x c - -x none <cflags>` while it
+// is produced. The compiler reports its own diagnostics; its exit code is ours.
+int runCompiler(Job& job, const onyx::TranspilerConfig& config, onyx::ThreadPool* pool,
+                const std::string& compiler, const std::vector<std::string>& cflags) {
+    std::vector<std::string> command = {compiler, "-x", "c", "-", "-x", "none"};
+    command.insert(command.end(), cflags.begin(), cflags.end());
+
+    onyx::Subprocess process;
+    std::string error;
+    if (!process.start(command, error)) {
+        job.diagnostics.push_back(error);
+        return 1;
+    }
+    // A small buffer hands the compiler its first lines early.
+    onyx::OutputWriter writer(64 * 1024);
+    writer.open(process.takeInput());
+
+    onyx::Transpiler transpiler(config, pool);
+    job.ok = transpiler.processFile(job.input, writer);
+    job.diagnostics = transpiler.diagnostics();
+    job.stats = transpiler.stats();
+    job.layouts = transpiler.layouts();
+    if (!job.ok && !writer.good()) {
+        // The compiler stopped reading, usually because it rejected its
+        // arguments and exited. It has said why, and its status is ours.
+        writer.close();
+        const int status = process.wait();
+        if (status > 0) {
+            job.ok = true;
+            job.diagnostics.clear();
+            return status;
+        }
+        if (status < 0) job.diagnostics.push_back("failed to wait for " + compiler);
+        return 1;
+    }
+    if (!job.ok) {
+        // Don't let the compiler report on a truncated unit.
+        process.kill();
+        process.wait();
+        return 1;
+    }
+    writer.close();
+    const int status = process.wait();
+    if (status < 0) job.diagnostics.push_back("failed to wait for " + compiler);
+    return status < 0 ? 1 : status;
+}
+
+void runJob(Job& job, onyx::TranspilerConfig config, onyx::ThreadPool* pool) {
+    config.depfile = job.depfile;
+    config.source_map = job.sourceMap;
+    config.header = job.header;
+    onyx::Transpiler transpiler(config, pool);
+    job.ok = transpiler.processFile(job.input, job.output);
+    job.diagnostics = transpiler.diagnostics();
+    job.stats = transpiler.stats();
+    job.layouts = transpiler.layouts();
+}
+
 int main(const int argc, char* argv[]) {
     if (argc < 2) {
         printUsage(argv[0]);
         return 1;
     }
 
-    const std::string inputPath = argv[1];
-    std::string outputPath = "out.c";
+    std::vector<std::filesystem::path> inputs;
+    std::string outputPath;
+    std::string outputDir;
+    unsigned jobs = std::thread::hardware_concurrency();
+    bool serial = false;
+    bool singlePass = false;
+    std::string cacheDir;
+    std::vector<std::filesystem::path> importDirs;
+    bool writeDepfiles = false;
+    std::string depfilePath;
+    StatsFormat statsFormat = StatsFormat::None;
+    bool layoutReport = false;
+    bool lineDirectives = false;
+    bool sourceMaps = false;
+    bool emitHeaders = false;
+    bool instrument = false;
+    std::string profilePath;
+    bool serve = false;
+    std::string compiler;
+    std::vector<std::string> cflags;
+    std::string socketPath;
+    std::size_t chunkLines = 0;
+
+    if (const char* env = std::getenv("OXC_CACHE_DIR")) cacheDir = env;
 
-    for (int i = 0; i < argc; ++i) {
+    for (int i = 1; i < argc; ++i) try {
         if (std::string arg = argv[i]; arg == "-o" && i + 1 < argc)
             outputPath = argv[++i];
+        else if (arg == "-d" && i + 1 < argc)
+            outputDir = argv[++i];
+        else if (arg == "-j" && i + 1 < argc)
+            jobs = static_cast<unsigned>(std::stoul(argv[++i]));
+        else if (arg.rfind("-j", 0) == 0 && arg.size() > 2)
+            jobs = static_cast<unsigned>(std::stoul(arg.substr(2)));
+        else if (arg == "--serial")
+            serial = true;
+        else if (arg == "--single-pass")
+            singlePass = true;
+        else if (arg == "--cache-dir" && i + 1 < argc)
+            cacheDir = argv[++i];
+        else if (arg == "-I" && i + 1 < argc)
+            importDirs.emplace_back(argv[++i]);
+        else if (arg.rfind("-I", 0) == 0 && arg.size() > 2)
+            importDirs.emplace_back(arg.substr(2));
+        else if (arg == "-MD")
+            writeDepfiles = true;
+        else if (arg == "-MF" && i + 1 < argc) {
+            writeDepfiles = true;
+            depfilePath = argv[++i];
+        }
+        else if (arg == "--stats" || arg == "--stats=text" || arg == "--time-report")
+            statsFormat = StatsFormat::Text;
+        else if (arg == "--stats=json")
+            statsFormat = StatsFormat::Json;
+        else if (arg == "--layout-report")
+            layoutReport = true;
+        else if (arg == "--line-directives")
+            lineDirectives = true;
+        else if (arg == "--source-map")
+            sourceMaps = true;
+        else if (arg == "--emit-header")
+            emitHeaders = true;
+        else if (arg == "--instrument")
+            instrument = true;
+        else if (arg == "--profile-use" && i + 1 < argc)
+            profilePath = argv[++i];
+        else if (arg == "--cc" && i + 1 < argc)
+            compiler = argv[++i];
+        else if (arg == "--") {
+            cflags.assign(argv + i + 1, argv + argc);
+            break;
+        }
+        else if (arg == "--serve")
+            serve = true;
+        else if (arg == "--socket" && i + 1 < argc) {
+            serve = true;
+            socketPath = argv[++i];
+        }
+        // Undocumented: smaller parallel chunks, so tests can split small files.
+        else if (arg == "--chunk-lines" && i + 1 < argc)
+            chunkLines = std::stoul(argv[++i]);
         else if (arg == "-v") {
             printVersion();
             return 0;
+        } else if (!arg.empty() && arg[0] != '-')
+            inputs.emplace_back(arg);
+        else {
+            printUsage(argv[0]);
+            return 1;
         }
+    } catch (const std::exception&) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (!cflags.empty() && compiler.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::shared_ptr<onyx::Profile> profile;
+    if (!profilePath.empty()) {
+        profile = std::make_shared<onyx::Profile>();
+        if (std::string error; !profile->load(profilePath, error)) {
+            std::cerr << error << "\n";
+            return 1;
+        }
+    }
+
+    if (serve) {
+        if (!inputs.empty() || !compiler.empty() || !outputPath.empty() || !outputDir.empty() || writeDepfiles ||
+            statsFormat != StatsFormat::None || layoutReport || sourceMaps || emitHeaders || instrument || profile) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        onyx::TranspilerConfig config;
+        config.parallel = !serial;
+        config.single_pass = singlePass;
+        config.cache_dir = cacheDir;
+        config.import_dirs = importDirs;
+        config.line_directives = lineDirectives;
+        if (chunkLines) config.chunk_lines = chunkLines;
+        std::unique_ptr<onyx::ThreadPool> pool;
+        if (jobs > 1) pool = std::make_unique<onyx::ThreadPool>(jobs);
+        onyx::Server server(config, pool.get());
+        if (socketPath.empty()) {
+            std::ios::sync_with_stdio(false);
+            return server.serve(std::cin, std::cout) ? 0 : 1;
+        }
+        std::string error;
+        server.listen(socketPath, error);
+        std::cerr << error << "\n";
+        return 1;
+    }
+
+    if (inputs.empty() || (!outputPath.empty() && (inputs.size() > 1 || !outputDir.empty())) ||
+        (!depfilePath.empty() && inputs.size() > 1) ||
+        (!compiler.empty() && (inputs.size() > 1 || !outputPath.empty() || !outputDir.empty() || writeDepfiles || sourceMaps || emitHeaders))) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Output names: -o for a single input, otherwise <stem>.c in -d (or "out.c"
+    // for a lone input without either flag, as before).
+    std::vector<Job> work(inputs.size());
+    std::set<std::filesystem::path> seen;
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        work[i].input = inputs[i];
+        if (!outputPath.empty())
+            work[i].output = outputPath;
+        else if (!outputDir.empty())
+            work[i].output = std::filesystem::path(outputDir) / inputs[i].stem().concat(".c");
+        else if (inputs.size() == 1)
+            work[i].output = "out.c";
+        else
+            work[i].output = std::filesystem::path(inputs[i]).replace_extension(".c");
+
+        if (!depfilePath.empty())
+            work[i].depfile = depfilePath;
+        else if (writeDepfiles)
+            work[i].depfile = std::filesystem::path(work[i].output).concat(".d");
+        if (sourceMaps) work[i].sourceMap = std::filesystem::path(work[i].output).concat(".map.json");
+        if (emitHeaders) work[i].header = std::filesystem::path(work[i].output).replace_extension(".h");
+
+        if (!seen.insert(work[i].output.lexically_normal()).second ||
+            (!work[i].header.empty() && !seen.insert(work[i].header.lexically_normal()).second)) {
+            std::cerr << "duplicate output - " << work[i].output.string() << "\n";
+            return 1;
+        }
+    }
+
+    if (!outputDir.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(outputDir, ec);
     }
 
     onyx::TranspilerConfig config;
     config.verbose = true;
+    config.parallel = !serial; // --serial also keeps each file on a single thread
+    config.single_pass = singlePass;
+    config.cache_dir = cacheDir;
+    config.import_dirs = importDirs;
+    config.layout_report = layoutReport;
+    config.line_directives = lineDirectives;
+    config.instrument = instrument;
+    config.profile = profile;
+    if (chunkLines) config.chunk_lines = chunkLines;
 
-    if (onyx::Transpiler transpiler(config);
-        transpiler.processFile(inputPath, outputPath)
-    ) {
-        return 0;
+    // One pool serves both levels: files run as tasks, and large files split
+    // their own work into chunk tasks on the same workers.
+    int compilerStatus = 0;
+    if (!compiler.empty()) {
+        std::unique_ptr<onyx::ThreadPool> pool;
+        if (jobs > 1) pool = std::make_unique<onyx::ThreadPool>(jobs);
+        compilerStatus = runCompiler(work[0], config, pool.get(), compiler, cflags);
+    } else if (jobs <= 1) {
+        for (Job& job : work) runJob(job, config, nullptr);
+    } else {
+        onyx::ThreadPool pool(jobs);
+        for (Job& job : work) pool.submit([&job, &config, &pool] { runJob(job, config, &pool); });
+        pool.wait();
+    }
+
+    // Diagnostics are reported in input order regardless of completion order.
+    int status = compilerStatus;
+    for (const Job& job : work) {
+        for (const auto& message : job.diagnostics) std::cerr << message << "\n";
+        if (!job.ok) {
+            std::cerr << "failed to transpile - " << job.input.string() << "\n";
+            status = 1;
+        }
     }
 
-    std::cerr << "failed to transpile - " << inputPath << "\n";
-    return 1;
-}
\ No newline at end of file
+    if (layoutReport) {
+        for (const Job& job : work) {
+            if (job.ok) onyx::writeLayoutReport(std::cerr, job.input.string(), job.layouts);
+        }
+    }
+
+    // Human-readable stats go to stderr next to diagnostics; JSON goes to
+    // stdout as one document so it can be captured for dashboards.
+    if (statsFormat == StatsFormat::Text) {
+        for (const Job& job : work) onyx::writeStatsText(std::cerr, job.input.string(), job.stats);
+    } else if (statsFormat == StatsFormat::Json) {
+        std::cout << "{\"files\":[";
+        for (std::size_t i = 0; i < work.size(); ++i) {
+            std::cout << (i ? ",\n" : "\n");
+            onyx::writeStatsJson(std::cout, work[i].input.string(), work[i].ok, work[i].stats);
+        }
+        std::cout << "\n]}\n";
+    }
+    return status;
+}
@@ -12,16 +12,21 @@ if [ ! -f "CMakeLists.txt" ]; then
 fi
 
 TEST_NAME=$1
-BUILD_DIR="build"
+BUILD_DIR="${BUILD_DIR:-build}"
 TEST_DIR="tests"
-OXC_PATH="${BUILD_DIR}/oxc"
+OXC_PATH="${OXC:-${BUILD_DIR}/oxc}"
 
 # Source, intermediate, and final paths
 ONYX_SRC="${TEST_DIR}/${TEST_NAME}.ox"
-C_OUT="${BUILD_DIR}/${TEST_DIR}/${TEST_NAME}.c"
 EXECUTABLE="${BUILD_DIR}/${TEST_DIR}/${TEST_NAME}"
 EXPECTED_OUTPUT="${TEST_DIR}/${TEST_NAME}.expected"
 ACTUAL_OUTPUT="${BUILD_DIR}/${TEST_DIR}/${TEST_NAME}.actual"
+# Extra oxc options for the test, one line, if any
+FLAGS_FILE="${TEST_DIR}/${TEST_NAME}.flags"
+OXC_FLAGS=""
+if [ -f "$FLAGS_FILE" ]; then
+    OXC_FLAGS=$(cat "$FLAGS_FILE")
+fi
 
 # --- Pre-flight Checks ---
 if [ -z "$TEST_NAME" ]; then
@@ -45,29 +50,58 @@ mkdir -p "${BUILD_DIR}/${TEST_DIR}"
 # --- Test Execution ---
 echo "--- Running Test: ${TEST_NAME} ---"
 
-# 1. Transpile Onyx to C
-echo "[1/4] Transpiling ${ONYX_SRC}..."
-${OXC_PATH} ${ONYX_SRC} -o ${C_OUT}
-echo "    > Transpiled C code at ${C_OUT}"
-
-# 2. Compile C code
-echo "[2/4] Compiling ${C_OUT}..."
+# 1. Transpile Onyx to C and compile it. The generated C is piped straight
+#    into the compiler; no intermediate .c file is written.
+echo "[1/3] Transpiling and compiling ${ONYX_SRC}..."
 # Use clang, respecting environment variables if set
-${CC:-clang} ${C_OUT} -o ${EXECUTABLE} -lm
+if [[ " ${OXC_FLAGS} " == *" --emit-header "* ]]; then
+    # Headers need files: every input (the test plus any .ox in its flags) is
+    # written to the build directory and compiled as its own translation unit.
+    ${OXC_PATH} ${ONYX_SRC} ${OXC_FLAGS} -d ${BUILD_DIR}/${TEST_DIR}
+    UNITS=""
+    for INPUT in ${ONYX_SRC} ${OXC_FLAGS}; do
+        if [[ "$INPUT" == *.ox ]]; then
+            UNITS="${UNITS} ${BUILD_DIR}/${TEST_DIR}/$(basename "${INPUT}" .ox).c"
+        fi
+    done
+    ${CC:-clang} ${UNITS} -I ${BUILD_DIR}/${TEST_DIR} -o ${EXECUTABLE} -lm
+else
+    ${OXC_PATH} ${ONYX_SRC} ${OXC_FLAGS} --cc ${CC:-clang} -- -o ${EXECUTABLE} -lm
+fi
 echo "    > Compiled executable at ${EXECUTABLE}"
 
-# 3. Run the executable
-echo "[3/4] Running executable..."
-${EXECUTABLE} > ${ACTUAL_OUTPUT}
+# 2. Run the executable
+echo "[2/3] Running executable..."
+# Instrumented tests write their profile next to the executable
+PROFILE="${BUILD_DIR}/${TEST_DIR}/${TEST_NAME}.prof"
+rm -f "${PROFILE}"
+ONYX_PROFILE="${PROFILE}" ${EXECUTABLE} > ${ACTUAL_OUTPUT}
 echo "    > Execution complete. Output captured in ${ACTUAL_OUTPUT}"
 
-# 4. Verify the output
+# 3. Verify the output
 if [ -f "$EXPECTED_OUTPUT" ]; then
-    echo "[4/4] Verifying output..."
+    echo "[3/3] Verifying output..."
     diff -u "${EXPECTED_OUTPUT}" "${ACTUAL_OUTPUT}"
     echo "    > Success: Output matches expected result."
 else
-    echo "[4/4] No expected output file found. Skipping verification."
+    echo "[3/3] No expected output file found. Skipping verification."
+fi
+
+# 4. Instrumented tests may also check the profile they wrote and the C a
+#    --profile-use rebuild generates from it.
+PROFILE_EXPECTED="${TEST_DIR}/${TEST_NAME}.prof.expected"
+PROFILE_USE_EXPECTED="${TEST_DIR}/${TEST_NAME}.use.expected"
+if [ -f "$PROFILE_EXPECTED" ]; then
+    echo "[profile] Verifying profile records..."
+    diff -u "${PROFILE_EXPECTED}" "${PROFILE}"
+    echo "    > Success: Profile matches expected records."
+fi
+if [ -f "$PROFILE_USE_EXPECTED" ]; then
+    echo "[profile] Rebuilding with --profile-use..."
+    PROFILE_USE_OUTPUT="${BUILD_DIR}/${TEST_DIR}/${TEST_NAME}.use.c"
+    ${OXC_PATH} ${ONYX_SRC} --profile-use "${PROFILE}" -o "${PROFILE_USE_OUTPUT}"
+    diff -u "${PROFILE_USE_EXPECTED}" "${PROFILE_USE_OUTPUT}"
+    echo "    > Success: Generated C matches expected result."
 fi
 
 echo "--- Test Passed: ${TEST_NAME} ---"
@@ -0,0 +1,20 @@
+#include "AllocationCounter.hpp"
+#include <utility>
+
+namespace {
+thread_local std::uint64_t* t_counter = nullptr;
+}
+
+namespace onyx {
+
+AllocationScope::AllocationScope(std::uint64_t& counter) : m_previous(std::exchange(t_counter, &counter)) {}
+
+AllocationScope::~AllocationScope() {
+    t_counter = m_previous;
+}
+
+void countAllocation(std::size_t size) noexcept {
+    if (t_counter) *t_counter += size;
+}
+
+} // namespace onyx
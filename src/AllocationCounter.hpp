@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace onyx {
+
+// Adds the size of every counted allocation made on this thread to `counter`
+// while the scope is alive. Scopes nest; the innermost one counts, so pool
+// tasks run while a thread waits are attributed to their own owner.
+//
+// The library does not replace global operator new itself. Programs that
+// want the counts link CountingNew.cpp, whose replacement reports each
+// request through countAllocation(); without it scopes count nothing.
+class AllocationScope {
+public:
+    explicit AllocationScope(std::uint64_t& counter);
+    ~AllocationScope();
+
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+
+private:
+    std::uint64_t* m_previous;
+};
+
+// Charges `size` bytes to the innermost AllocationScope on this thread.
+void countAllocation(std::size_t size) noexcept;
+
+} // namespace onyx
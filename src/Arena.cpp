@@ -0,0 +1,65 @@
+#include "Arena.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace onyx {
+
+void* Arena::allocate(std::size_t size, std::size_t align) {
+    while (m_current < m_blocks.size()) {
+        Block& block = m_blocks[m_current];
+        const std::size_t offset = (m_used + align - 1) & ~(align - 1);
+        if (offset + size <= block.size) {
+            m_used = offset + size;
+            return block.data.get() + offset;
+        }
+        // Fall through to the next retained block, or grow.
+        if (m_current + 1 == m_blocks.size()) break;
+        m_current++;
+        m_used = 0;
+    }
+
+    const std::size_t blockSize = std::max(m_blockSize, size + align);
+    m_blocks.push_back({std::make_unique_for_overwrite<std::byte[]>(blockSize), blockSize});
+    m_current = m_blocks.size() - 1;
+    m_used = 0;
+    return allocate(size, align);
+}
+
+std::string_view Arena::copy(std::string_view text) {
+    if (text.empty()) return {};
+    char* out = static_cast<char*>(allocate(text.size(), 1));
+    std::memcpy(out, text.data(), text.size());
+    return {out, text.size()};
+}
+
+std::string_view Arena::concat(std::initializer_list<std::string_view> parts) {
+    std::size_t size = 0;
+    for (std::string_view part : parts) size += part.size();
+    if (size == 0) return {};
+    char* out = static_cast<char*>(allocate(size, 1));
+    std::size_t at = 0;
+    for (std::string_view part : parts) {
+        std::memcpy(out + at, part.data(), part.size());
+        at += part.size();
+    }
+    return {out, size};
+}
+
+void Arena::rewind(Mark mark) {
+    m_current = mark.block;
+    m_used = mark.used;
+}
+
+void Arena::reset() {
+    m_blocks.clear();
+    m_current = 0;
+    m_used = 0;
+}
+
+std::size_t Arena::bytesReserved() const {
+    std::size_t total = 0;
+    for (const Block& block : m_blocks) total += block.size;
+    return total;
+}
+
+} // namespace onyx
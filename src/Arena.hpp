@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace onyx {
+
+// Bump allocator for per-file data. Objects are never destroyed individually,
+// so only trivially destructible types may live here. Blocks are kept across
+// rewind() for reuse and released together by reset() or destruction.
+class Arena {
+public:
+    static constexpr std::size_t DefaultBlockSize = 64 * 1024;
+
+    explicit Arena(std::size_t blockSize = DefaultBlockSize) : m_blockSize(blockSize) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(std::size_t size, std::size_t align);
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T{std::forward<Args>(args)...};
+    }
+
+    template <typename T>
+    T* makeArray(std::size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+        T* items = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        for (std::size_t i = 0; i < count; ++i) new (items + i) T{};
+        return items;
+    }
+
+    std::string_view copy(std::string_view text);
+    std::string_view concat(std::initializer_list<std::string_view> parts);
+
+    // Everything allocated after mark() is released by rewind(mark).
+    struct Mark {
+        std::size_t block = 0;
+        std::size_t used = 0;
+    };
+    [[nodiscard]] Mark mark() const { return {m_current, m_used}; }
+    void rewind(Mark mark);
+    // Rewinds to the point of construction when it goes out of scope.
+    class Scope {
+    public:
+        explicit Scope(Arena& arena) : m_arena(arena), m_mark(arena.mark()) {}
+        ~Scope() { m_arena.rewind(m_mark); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Arena& m_arena;
+        Mark m_mark;
+    };
+
+    // Frees every block.
+    void reset();
+
+    [[nodiscard]] std::size_t bytesReserved() const;
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size = 0;
+    };
+
+    std::size_t m_blockSize;
+    std::vector<Block> m_blocks;
+    std::size_t m_current = 0; // block being filled
+    std::size_t m_used = 0;    // bytes used in m_blocks[m_current]
+};
+
+} // namespace onyx
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace onyx {
+
+struct StructLayout;
+
+// One node per transpiled source line. Nodes live in the transpiler's arena;
+// their views point into the mapped source where the text is unchanged and
+// into the arena where it was rewritten or translated.
+enum class NodeKind : std::uint8_t {
+    Include,     // #include "<text>"
+    Import,      // <text>, an imported module's declarations as rendered C
+    Instance,    // <text>, generic instantiations first used by the next declaration, as rendered C
+    Comment,     // //<text>
+    Native,      // <text>, verbatim from a native block
+    SharedHead,  // // shared <name> (elided)[ [attributes: <attr>]]
+    GenericHead, // // generic <mods> <name> (instantiated per use)
+    StructHead,  // typedef struct <name> {
+    StructEnd,   // [<layout fields>] } [__attribute__((<attr>)) ]<name>; [<name>SoA] [layout checks]
+    ResolveHead, // // resolve <name>
+    ResolveEnd,  // // end resolve
+    UseMixin,    // one "<field>;" line per mixin field, then a blank line
+    Field,       // <type> <name>;
+    Function,    // [__attribute__((<attr>)) ][<mods> ]<type> [<owner>_]<name>(<params>) {  or  ;
+    Var,         // [<mods> ]<type> <name>[[<extent>]][ = <text>];
+    If,          // if (<text>) {
+    While,       // [<pragmas for attr>] while (<text>) {
+    Loop,        // [<pragmas for attr>] while (1) {
+    For,         // [<pragmas for attr>] for (<text>) {
+    Region,      // {, then onyx_region <name> (or onyx_pool <name> of <type>) released at the block's end
+    Line         // <text>[;], anything else
+};
+
+struct Param {
+    std::string_view type; // translated
+    std::string_view name;
+};
+
+struct Node {
+    NodeKind kind = NodeKind::Line;
+    int depth = 0; // indentation level
+    std::string_view name;
+    std::string_view type;  // translated C type
+    std::string_view attr;
+    std::string_view mods;
+    std::string_view owner; // resolve type of a method
+    std::string_view text;  // path, condition, initializer or verbatim line
+    std::string_view extent; // Var: array length
+    const Param* params = nullptr;
+    std::uint32_t paramCount = 0;
+    bool definition = false; // Function: has a body
+    bool semicolon = false;  // Line: append ';'
+    const std::vector<std::string>* fields = nullptr; // UseMixin
+    const StructLayout* layout = nullptr;             // StructEnd, when it emits more than the brace
+};
+
+} // namespace onyx
@@ -0,0 +1,1025 @@
+#include "Comptime.hpp"
+#include "Lexer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace onyx {
+
+// Statements and loop iterations one evaluation may run, and how deep const
+// fns may recurse, before it is taken for a runaway.
+static constexpr std::size_t STEP_LIMIT = std::size_t{1} << 24;
+static constexpr int CALL_DEPTH_LIMIT = 256;
+
+namespace {
+
+constexpr ConstType INT{32, true};
+constexpr ConstType SIZE{64, false};
+
+// Something only known at run time; the caller falls back to C.
+struct NotConstant {
+    std::string reason;
+};
+
+enum class Op : std::uint8_t {
+    Neg, Plus, Not, BitNot,
+    Mul, Div, Mod, Add, Sub, Shl, Shr,
+    Lt, Le, Gt, Ge, Eq, Ne,
+    BitAnd, BitXor, BitOr, And, Or
+};
+
+struct Expr {
+    enum class Kind : std::uint8_t { Literal, Name, Index, Call, Unary, Binary, Conditional, Cast, SizeOf };
+    Kind kind = Kind::Literal;
+    Op op = Op::Add;
+    ConstValue value;      // Literal; the target type of a Cast
+    std::string name;      // Name, Index, Call; the type of a SizeOf
+    std::vector<Expr> args; // operands, index or call arguments
+};
+
+std::uint64_t widthMask(unsigned bits) {
+    return bits >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << bits) - 1;
+}
+
+ConstValue makeInt(ConstType type, std::uint64_t raw) {
+    ConstValue v{type};
+    if (type.isBool) {
+        v.bits = raw != 0;
+        return v;
+    }
+    raw &= widthMask(type.bits);
+    if (type.isSigned && type.bits < 64 && (raw >> (type.bits - 1)) & 1) raw |= ~widthMask(type.bits);
+    v.bits = raw;
+    return v;
+}
+
+ConstValue makeReal(ConstType type, double real) {
+    ConstValue v{type};
+    v.real = type.bits == 32 ? static_cast<double>(static_cast<float>(real)) : real;
+    return v;
+}
+
+std::int64_t asSigned(const ConstValue& v) {
+    return static_cast<std::int64_t>(v.bits);
+}
+
+double asReal(const ConstValue& v) {
+    if (v.type.isFloat) return v.real;
+    return v.type.isSigned ? static_cast<double>(asSigned(v)) : static_cast<double>(v.bits);
+}
+
+bool truthy(const ConstValue& v) {
+    return v.type.isFloat ? v.real != 0 : v.bits != 0;
+}
+
+ConstType promote(ConstType t) {
+    return !t.isFloat && (t.bits < 32 || t.isBool) ? INT : t;
+}
+
+// The usual arithmetic conversions, under LP64.
+ConstType common(ConstType a, ConstType b) {
+    if (a.isFloat || b.isFloat) {
+        if ((a.isFloat && a.bits == 64) || (b.isFloat && b.bits == 64)) return ConstType{64, true, true};
+        return ConstType{32, true, true};
+    }
+    a = promote(a);
+    b = promote(b);
+    if (a.isSigned == b.isSigned) return a.bits >= b.bits ? a : b;
+    const ConstType u = a.isSigned ? b : a;
+    const ConstType s = a.isSigned ? a : b;
+    return u.bits >= s.bits ? u : s;
+}
+
+std::string typeName(ConstType t) {
+    if (t.isBool) return "bool";
+    if (t.isFloat) return t.bits == 32 ? "float" : "double";
+    if (t.bits == 32 && t.isSigned) return "int";
+    return std::string(t.isSigned ? "int" : "uint").append(std::to_string(t.bits)).append("_t");
+}
+
+// --- Parsing -----------------------------------------------------------------
+
+struct Tok {
+    enum class Kind : std::uint8_t { End, Number, Name, Char, Punct };
+    Kind kind = Kind::End;
+    std::string_view text;
+
+    [[nodiscard]] bool is(std::string_view punct) const { return kind == Kind::Punct && text == punct; }
+};
+
+std::vector<Tok> tokenize(std::string_view s) {
+    std::vector<Tok> toks;
+    std::size_t i = 0;
+    while (true) {
+        while (i < s.size() && isSpace(s[i])) ++i;
+        if (i >= s.size()) break;
+        const std::size_t start = i;
+        const char c = s[i];
+        Tok::Kind kind = Tok::Kind::Punct;
+        if ((c >= '0' && c <= '9') || (c == '.' && i + 1 < s.size() && s[i + 1] >= '0' && s[i + 1] <= '9')) {
+            // A C preprocessing number: digits, letters, dots and signed exponents.
+            kind = Tok::Kind::Number;
+            ++i;
+            while (i < s.size()) {
+                const char e = s[i - 1];
+                if (isWordChar(s[i]) || s[i] == '.') ++i;
+                else if ((s[i] == '+' || s[i] == '-') && (e == 'e' || e == 'E' || e == 'p' || e == 'P')) ++i;
+                else break;
+            }
+        } else if (isWordChar(c)) {
+            kind = Tok::Kind::Name;
+            while (i < s.size() && isWordChar(s[i])) ++i;
+        } else if (c == '\'') {
+            kind = Tok::Kind::Char;
+            for (++i; i < s.size() && s[i] != '\''; ++i) {
+                if (s[i] == '\\') ++i;
+            }
+            if (i >= s.size()) throw NotConstant{"unterminated character literal"};
+            ++i;
+        } else if (c == '"') {
+            throw NotConstant{"string literal"};
+        } else {
+            static constexpr std::string_view pairs[] = {"<<", ">>", "<=", ">=", "==", "!=", "&&", "||"};
+            ++i;
+            for (std::string_view pair : pairs) {
+                if (s.substr(start, 2) == pair) {
+                    ++i;
+                    break;
+                }
+            }
+        }
+        toks.push_back({kind, s.substr(start, i - start)});
+    }
+    toks.push_back({});
+    return toks;
+}
+
+ConstValue parseNumber(std::string_view t) {
+    const bool hex = t.size() > 1 && t[0] == '0' && (t[1] == 'x' || t[1] == 'X');
+    const bool real = hex ? t.find_first_of("pP") != std::string_view::npos
+                          : t.find_first_of(".eE") != std::string_view::npos;
+    if (real) {
+        bool single = false;
+        if (t.back() == 'f' || t.back() == 'F') {
+            single = true;
+            t.remove_suffix(1);
+        } else if (t.back() == 'l' || t.back() == 'L') {
+            t.remove_suffix(1);
+        }
+        const std::string text(t);
+        char* end = nullptr;
+        const double value = std::strtod(text.c_str(), &end);
+        if (end != text.c_str() + text.size()) throw NotConstant{"malformed number " + text};
+        return makeReal(ConstType{static_cast<std::uint8_t>(single ? 32 : 64), true, true}, value);
+    }
+
+    unsigned base = 10;
+    std::size_t i = 0;
+    if (hex) {
+        base = 16;
+        i = 2;
+    } else if (t.size() > 1 && t[0] == '0' && (t[1] == 'b' || t[1] == 'B')) {
+        base = 2;
+        i = 2;
+    } else if (t.size() > 1 && t[0] == '0') {
+        base = 8;
+        i = 1;
+    }
+    std::uint64_t value = 0;
+    const std::size_t digits = i;
+    for (; i < t.size(); ++i) {
+        const char c = t[i];
+        unsigned d = 0;
+        if (c >= '0' && c <= '9') d = static_cast<unsigned>(c - '0');
+        else if (c >= 'a' && c <= 'f') d = static_cast<unsigned>(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') d = static_cast<unsigned>(c - 'A' + 10);
+        else break;
+        if (d >= base) break;
+        if (value > (std::numeric_limits<std::uint64_t>::max() - d) / base) {
+            throw std::runtime_error("integer literal " + std::string(t) + " is too large");
+        }
+        value = value * base + d;
+    }
+    if (i == digits && base != 8) throw NotConstant{"malformed number " + std::string(t)};
+    bool isUnsigned = false;
+    int longs = 0;
+    for (; i < t.size(); ++i) {
+        if ((t[i] == 'u' || t[i] == 'U') && !isUnsigned) isUnsigned = true;
+        else if ((t[i] == 'l' || t[i] == 'L') && longs < 2) longs++;
+        else throw NotConstant{"malformed number " + std::string(t)};
+    }
+
+    // The first type of C's list for the literal's form that holds the value.
+    const bool decimal = base == 10;
+    auto fits = [value](ConstType type) {
+        return value <= (type.isSigned ? widthMask(type.bits) >> 1 : widthMask(type.bits));
+    };
+    std::vector<ConstType> candidates;
+    if (longs == 0 && !isUnsigned) candidates.push_back(INT);
+    if (longs == 0 && (isUnsigned || !decimal)) candidates.push_back(ConstType{32, false});
+    if (!isUnsigned) candidates.push_back(ConstType{64, true});
+    if (isUnsigned || !decimal) candidates.push_back(ConstType{64, false});
+    for (ConstType type : candidates) {
+        if (fits(type)) return makeInt(type, value);
+    }
+    throw std::runtime_error("integer literal " + std::string(t) + " is too large for its type");
+}
+
+ConstValue parseChar(std::string_view t) {
+    std::string_view body = t.substr(1, t.size() - 2);
+    int value = 0;
+    if (body.size() == 1 && body[0] != '\\') {
+        value = static_cast<signed char>(body[0]);
+    } else if (body.size() >= 2 && body[0] == '\\') {
+        const char e = body[1];
+        if (e >= '0' && e <= '7') {
+            unsigned v = 0;
+            for (std::size_t i = 1; i < body.size() && i < 4 && body[i] >= '0' && body[i] <= '7'; ++i) v = v * 8 + (body[i] - '0');
+            value = static_cast<signed char>(v);
+        } else if (e == 'x') {
+            value = static_cast<signed char>(std::strtoul(std::string(body.substr(2)).c_str(), nullptr, 16));
+        } else {
+            switch (e) {
+            case 'n': value = '\n'; break;
+            case 't': value = '\t'; break;
+            case 'r': value = '\r'; break;
+            case 'a': value = '\a'; break;
+            case 'b': value = '\b'; break;
+            case 'f': value = '\f'; break;
+            case 'v': value = '\v'; break;
+            case '\\': case '\'': case '"': case '?': value = e; break;
+            default: throw NotConstant{"unknown escape in " + std::string(t)};
+            }
+        }
+    } else {
+        throw NotConstant{"multi-character literal " + std::string(t)};
+    }
+    return makeInt(INT, static_cast<std::uint64_t>(static_cast<std::int64_t>(value)));
+}
+
+class Parser {
+public:
+    explicit Parser(std::string_view text) : m_toks(tokenize(text)) {}
+
+    Expr parse() {
+        Expr e = ternary();
+        if (peek().kind != Tok::Kind::End) throw NotConstant{"unexpected `" + std::string(peek().text) + "`"};
+        return e;
+    }
+
+private:
+    std::vector<Tok> m_toks;
+    std::size_t m_pos = 0;
+
+    const Tok& peek(std::size_t ahead = 0) const { return m_toks[std::min(m_pos + ahead, m_toks.size() - 1)]; }
+    const Tok& next() { return m_toks[m_pos < m_toks.size() - 1 ? m_pos++ : m_pos]; }
+    void expect(std::string_view punct) {
+        if (!peek().is(punct)) throw NotConstant{"expected `" + std::string(punct) + "`"};
+        ++m_pos;
+    }
+
+    Expr ternary() {
+        Expr cond = binary(0);
+        if (!peek().is("?")) return cond;
+        ++m_pos;
+        Expr e{.kind = Expr::Kind::Conditional};
+        e.args.push_back(std::move(cond));
+        e.args.push_back(ternary());
+        expect(":");
+        e.args.push_back(ternary());
+        return e;
+    }
+
+    // Binary operators by increasing precedence.
+    Expr binary(int level) {
+        struct Level {
+            std::string_view spellings[4];
+            Op ops[4];
+        };
+        static constexpr Level levels[] = {
+            {{"||"}, {Op::Or}},
+            {{"&&"}, {Op::And}},
+            {{"|"}, {Op::BitOr}},
+            {{"^"}, {Op::BitXor}},
+            {{"&"}, {Op::BitAnd}},
+            {{"==", "!="}, {Op::Eq, Op::Ne}},
+            {{"<", "<=", ">", ">="}, {Op::Lt, Op::Le, Op::Gt, Op::Ge}},
+            {{"<<", ">>"}, {Op::Shl, Op::Shr}},
+            {{"+", "-"}, {Op::Add, Op::Sub}},
+            {{"*", "/", "%"}, {Op::Mul, Op::Div, Op::Mod}},
+        };
+        if (level == static_cast<int>(std::size(levels))) return unary();
+        Expr lhs = binary(level + 1);
+        while (true) {
+            const Level& l = levels[level];
+            int found = -1;
+            for (int i = 0; i < 4 && !l.spellings[i].empty(); ++i) {
+                if (peek().is(l.spellings[i])) found = i;
+            }
+            if (found < 0) return lhs;
+            ++m_pos;
+            Expr e{.kind = Expr::Kind::Binary, .op = l.ops[found]};
+            e.args.push_back(std::move(lhs));
+            e.args.push_back(binary(level + 1));
+            lhs = std::move(e);
+        }
+    }
+
+    Expr unary() {
+        const Tok& t = peek();
+        const Op* op = nullptr;
+        static constexpr Op neg = Op::Neg, plus = Op::Plus, lnot = Op::Not, bnot = Op::BitNot;
+        if (t.is("-")) op = &neg;
+        else if (t.is("+")) op = &plus;
+        else if (t.is("!")) op = &lnot;
+        else if (t.is("~")) op = &bnot;
+        if (op) {
+            ++m_pos;
+            Expr e{.kind = Expr::Kind::Unary, .op = *op};
+            e.args.push_back(unary());
+            return e;
+        }
+        if (t.is("(") && peek(1).kind == Tok::Kind::Name) {
+            std::size_t close = 2;
+            while (peek(close).is("*")) ++close;
+            if (peek(close).is(")")) {
+                if (close > 2) throw NotConstant{"pointer cast"};
+                if (const std::optional<ConstType> type = constType(peek(1).text)) {
+                    m_pos += 3;
+                    Expr e{.kind = Expr::Kind::Cast};
+                    e.value.type = *type;
+                    e.args.push_back(unary());
+                    return e;
+                }
+            }
+        }
+        return primary();
+    }
+
+    Expr primary() {
+        const Tok t = next();
+        switch (t.kind) {
+        case Tok::Kind::Number:
+            return Expr{.kind = Expr::Kind::Literal, .value = parseNumber(t.text)};
+        case Tok::Kind::Char:
+            return Expr{.kind = Expr::Kind::Literal, .value = parseChar(t.text)};
+        case Tok::Kind::Name:
+            break;
+        case Tok::Kind::Punct:
+            if (t.is("(")) {
+                Expr e = ternary();
+                expect(")");
+                return e;
+            }
+            throw NotConstant{"unexpected `" + std::string(t.text) + "`"};
+        case Tok::Kind::End:
+            throw NotConstant{"missing operand"};
+        }
+
+        if (t.text == "true" || t.text == "false") return Expr{.kind = Expr::Kind::Literal, .value = makeInt(INT, t.text == "true")};
+        if (t.text == "sizeof") {
+            expect("(");
+            if (peek().kind != Tok::Kind::Name) throw NotConstant{"sizeof of an expression"};
+            std::string type(next().text);
+            while (peek().is("*")) type += next().text;
+            if (!peek().is(")")) throw NotConstant{"sizeof of an expression"};
+            ++m_pos;
+            Expr e{.kind = Expr::Kind::SizeOf};
+            e.name = std::move(type);
+            return e;
+        }
+        Expr e{.kind = Expr::Kind::Name};
+        e.name = t.text;
+        if (peek().is("(")) {
+            ++m_pos;
+            e.kind = Expr::Kind::Call;
+            if (!peek().is(")")) {
+                e.args.push_back(ternary());
+                while (peek().is(",")) {
+                    ++m_pos;
+                    e.args.push_back(ternary());
+                }
+            }
+            expect(")");
+        } else if (peek().is("[")) {
+            ++m_pos;
+            e.kind = Expr::Kind::Index;
+            e.args.push_back(ternary());
+            expect("]");
+        }
+        if (peek().is(".") || peek().is("[") || peek().is("(")) throw NotConstant{"member access"};
+        return e;
+    }
+};
+
+Expr parseExpr(std::string_view text) {
+    return Parser(text).parse();
+}
+
+} // namespace
+
+// --- Definitions ---------------------------------------------------------------
+
+struct ConstStmt {
+    ConstStatement::Kind kind;
+    std::size_t line = 0;
+    std::string name;
+    ConstType type;
+    std::optional<Op> op; // Assign: the operator of a compound assignment
+    Expr expr;
+    Expr limit;
+    bool hoisted = false;     // For: the bound is evaluated once, as the lowered C does
+    bool initialized = false; // Var: has an initializer; zero otherwise
+    std::vector<ConstStmt> body;
+    std::vector<ConstStmt> orElse;
+};
+
+struct ConstFunction {
+    std::string name;
+    std::size_t line = 0;
+    std::vector<std::pair<std::string, ConstType>> params;
+    ConstType ret;
+    std::vector<ConstStmt> body;
+};
+
+struct ConstConstant {
+    ConstType type;
+    std::string extent; // empty for a scalar
+    std::string expr;
+    std::optional<std::vector<ConstValue>> values;
+    bool evaluating = false;
+};
+
+std::optional<ConstType> constType(std::string_view type) {
+    if (type == "i32" || type == "int" || type == "int32_t") return INT;
+    if (type == "u32" || type == "uint32_t") return ConstType{32, false};
+    if (type == "u8" || type == "uint8_t") return ConstType{8, false};
+    if (type == "char" || type == "int8_t") return ConstType{8, true};
+    if (type == "bool") return ConstType{8, false, false, true};
+    if (type == "int16_t") return ConstType{16, true};
+    if (type == "uint16_t") return ConstType{16, false};
+    if (type == "int64_t") return ConstType{64, true};
+    if (type == "uint64_t" || type == "size_t") return SIZE;
+    if (type == "f32" || type == "float") return ConstType{32, true, true};
+    if (type == "f64" || type == "double") return ConstType{64, true, true};
+    return std::nullopt;
+}
+
+std::string constLiteral(const ConstValue& value) {
+    const ConstType t = value.type;
+    if (t.isFloat) {
+        if (!std::isfinite(value.real)) throw std::runtime_error("comptime result is not a finite number");
+        char buf[40];
+        std::snprintf(buf, sizeof buf, t.bits == 32 ? "%.9g" : "%.17g", value.real);
+        std::string text(buf);
+        if (text.find_first_of(".e") == std::string::npos) text += ".0";
+        if (t.bits == 32) text += "f";
+        return text;
+    }
+    if (t.isBool) return value.bits ? "1" : "0";
+    if (!t.isSigned) {
+        std::string text = std::to_string(value.bits);
+        if (t.bits == 64) text += "ULL";
+        else if (t.bits == 32) text += "u";
+        return text;
+    }
+    const std::int64_t v = asSigned(value);
+    if (t.bits == 64) {
+        if (v == std::numeric_limits<std::int64_t>::min()) return "(-9223372036854775807LL - 1)";
+        return std::to_string(v) + "LL";
+    }
+    if (t.bits == 32 && v == std::numeric_limits<std::int32_t>::min()) return "(-2147483647 - 1)";
+    return std::to_string(v);
+}
+
+ConstEvaluator::ConstEvaluator() = default;
+ConstEvaluator::~ConstEvaluator() = default;
+
+ConstEvaluator::ConstEvaluator(const ConstEvaluator& other) : m_functions(other.m_functions) {
+    for (const auto& [name, constant] : other.m_constants) m_constants.emplace(name, std::make_unique<ConstConstant>(*constant));
+}
+
+ConstEvaluator& ConstEvaluator::operator=(const ConstEvaluator& other) {
+    if (this != &other) {
+        ConstEvaluator copy(other);
+        m_functions = std::move(copy.m_functions);
+        m_constants = std::move(copy.m_constants);
+    }
+    return *this;
+}
+
+void ConstEvaluator::clear() {
+    m_functions.clear();
+    m_constants.clear();
+}
+
+namespace {
+
+ConstType requireType(std::string_view type, const std::string& what) {
+    const std::optional<ConstType> t = constType(type);
+    if (!t) throw std::runtime_error(what + " has type " + std::string(type) + ", which is not an integer or floating type");
+    return *t;
+}
+
+Expr requireExpr(std::string_view text) {
+    try {
+        return parseExpr(text);
+    } catch (const NotConstant& e) {
+        throw std::runtime_error("cannot evaluate `" + std::string(text) + "`: " + e.reason);
+    }
+}
+
+ConstStmt compile(const ConstStatement& s, bool inLoop) {
+    using Kind = ConstStatement::Kind;
+    ConstStmt out{s.kind, s.line, s.name};
+    try {
+        switch (s.kind) {
+        case Kind::Var:
+            out.type = requireType(s.type, s.name);
+            out.initialized = !s.expr.empty();
+            if (out.initialized) out.expr = requireExpr(s.expr);
+            break;
+        case Kind::Assign: {
+            static constexpr std::pair<std::string_view, Op> compound[] = {
+                {"+=", Op::Add}, {"-=", Op::Sub}, {"*=", Op::Mul}, {"/=", Op::Div}, {"%=", Op::Mod},
+                {"<<=", Op::Shl}, {">>=", Op::Shr}, {"&=", Op::BitAnd}, {"|=", Op::BitOr}, {"^=", Op::BitXor}};
+            for (const auto& [spelling, op] : compound) {
+                if (s.op == spelling) out.op = op;
+            }
+            out.expr = requireExpr(s.expr);
+            break;
+        }
+        case Kind::Return:
+            if (s.expr.empty()) throw std::runtime_error("return needs a value");
+            out.expr = requireExpr(s.expr);
+            break;
+        case Kind::If:
+        case Kind::While:
+            out.expr = requireExpr(s.expr);
+            break;
+        case Kind::For:
+            out.type = s.type.empty() ? INT : requireType(s.type, s.name);
+            if (out.type.isFloat) throw std::runtime_error("for " + s.name + " needs an integer type");
+            out.expr = requireExpr(s.expr);
+            out.limit = requireExpr(s.limit);
+            out.hoisted = out.limit.kind != Expr::Kind::Name && out.limit.kind != Expr::Kind::Literal;
+            break;
+        case Kind::Break:
+        case Kind::Continue:
+            if (!inLoop) throw std::runtime_error(std::string(s.kind == Kind::Break ? "break" : "continue") + " outside a loop");
+            break;
+        case Kind::Loop:
+            break;
+        }
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error("line " + std::to_string(s.line) + ": " + e.what());
+    }
+    const bool loop = s.kind == Kind::While || s.kind == Kind::Loop || s.kind == Kind::For;
+    for (const ConstStatement& inner : s.body) out.body.push_back(compile(inner, inLoop || loop));
+    for (const ConstStatement& inner : s.orElse) out.orElse.push_back(compile(inner, inLoop));
+    return out;
+}
+
+} // namespace
+
+void ConstEvaluator::defineFunction(const std::string& name, const std::vector<std::pair<std::string, std::string>>& params,
+                                    std::string_view ret, std::vector<ConstStatement> body, std::size_t line) {
+    auto fn = std::make_shared<ConstFunction>();
+    fn->name = name;
+    fn->line = line;
+    try {
+        if (ret.empty()) throw std::runtime_error("needs a return type");
+        fn->ret = requireType(ret, "the result");
+        for (const auto& [param, type] : params) fn->params.emplace_back(param, requireType(type, param));
+        for (const ConstStatement& s : body) fn->body.push_back(compile(s, false));
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error("const fn " + name + ": " + e.what());
+    }
+    m_functions[name] = std::move(fn);
+}
+
+void ConstEvaluator::defineConstant(const std::string& name, std::string_view type, std::string_view extent,
+                                    std::string_view expr) {
+    const std::optional<ConstType> t = constType(type);
+    if (!t || expr.empty()) return;
+    m_constants[name] = std::make_unique<ConstConstant>(ConstConstant{*t, std::string(extent), std::string(expr)});
+}
+
+bool ConstEvaluator::mentions(std::string_view expr) const {
+    if (empty()) return false;
+    Lexer lex(expr);
+    for (Token t = lex.next(); t.kind != TokenKind::End; t = lex.next()) {
+        if (!t.isWord()) continue;
+        const std::string word(t.text);
+        if (m_functions.count(word) || m_constants.count(word)) return true;
+    }
+    return false;
+}
+
+// --- Evaluation ------------------------------------------------------------------
+
+struct ConstMachine {
+    ConstEvaluator& evaluator;
+    const ConstEvaluator::SizeOf& sizeOf;
+    std::size_t steps = 0;
+    int depth = 0;
+    std::optional<ConstValue> index; // what `_` stands for in a table
+    struct Local {
+        std::string_view name;
+        ConstValue value;
+    };
+    std::vector<Local> locals;
+    std::size_t frame = 0;                // first local of the running call
+    const ConstFunction* function = nullptr;
+    std::size_t line = 0;                 // of the running statement
+
+    enum class Flow : std::uint8_t { Next, Break, Continue, Return };
+
+    [[noreturn]] void fail(const std::string& message) const {
+        if (!function) throw std::runtime_error("comptime: " + message);
+        throw std::runtime_error("const fn " + function->name + ", line " + std::to_string(line) + ": " + message);
+    }
+
+    void step() {
+        if (++steps > STEP_LIMIT) {
+            fail("gave up after " + std::to_string(STEP_LIMIT) + " steps; does a loop never end?");
+        }
+    }
+
+    ConstValue convert(const ConstValue& v, ConstType to) const {
+        if (to.isBool) return makeInt(to, truthy(v));
+        if (to.isFloat) return makeReal(to, asReal(v));
+        if (!v.type.isFloat) return makeInt(to, v.bits);
+        const double r = std::trunc(v.real);
+        const double lo = to.isSigned ? -std::ldexp(1.0, to.bits - 1) : 0.0;
+        const double hi = std::ldexp(1.0, to.isSigned ? to.bits - 1 : to.bits);
+        if (!(r >= lo && r < hi)) fail(constLiteral(v) + " does not fit in " + typeName(to));
+        return makeInt(to, to.isSigned ? static_cast<std::uint64_t>(static_cast<std::int64_t>(r)) : static_cast<std::uint64_t>(r));
+    }
+
+    ConstValue checkedSigned(ConstType t, std::int64_t r, bool overflow) const {
+        const std::int64_t lo = t.bits == 64 ? std::numeric_limits<std::int64_t>::min() : -(std::int64_t{1} << (t.bits - 1));
+        const std::int64_t hi = t.bits == 64 ? std::numeric_limits<std::int64_t>::max() : (std::int64_t{1} << (t.bits - 1)) - 1;
+        if (overflow || r < lo || r > hi) fail("signed integer overflow in " + typeName(t));
+        return makeInt(t, static_cast<std::uint64_t>(r));
+    }
+
+    ConstValue unary(Op op, const ConstValue& a) const {
+        if (op == Op::Not) return makeInt(INT, !truthy(a));
+        const ConstType t = promote(a.type);
+        const ConstValue v = convert(a, t);
+        if (t.isFloat) {
+            if (op == Op::BitNot) fail("~ on a floating value");
+            return makeReal(t, op == Op::Neg ? -v.real : v.real);
+        }
+        switch (op) {
+        case Op::Neg:
+            if (!t.isSigned) return makeInt(t, ~v.bits + 1);
+            return checkedSigned(t, asSigned(v) == std::numeric_limits<std::int64_t>::min() ? 0 : -asSigned(v),
+                                 asSigned(v) == std::numeric_limits<std::int64_t>::min());
+        case Op::BitNot:
+            return makeInt(t, ~v.bits);
+        default:
+            return v;
+        }
+    }
+
+    ConstValue shift(Op op, const ConstValue& a, const ConstValue& b) const {
+        const ConstType t = promote(a.type);
+        if (t.isFloat || b.type.isFloat) fail("shift of a floating value");
+        const ConstValue v = convert(a, t);
+        const ConstValue n = convert(b, promote(b.type));
+        if ((n.type.isSigned && asSigned(n) < 0) || n.bits >= t.bits) {
+            fail("shift by " + constLiteral(n) + " in " + typeName(t));
+        }
+        const unsigned count = static_cast<unsigned>(n.bits);
+        if (op == Op::Shr) return makeInt(t, t.isSigned ? static_cast<std::uint64_t>(asSigned(v) >> count) : v.bits >> count);
+        if (!t.isSigned) return makeInt(t, v.bits << count);
+        if (asSigned(v) < 0) fail("left shift of a negative value");
+        const std::uint64_t max = widthMask(t.bits) >> 1;
+        return checkedSigned(t, static_cast<std::int64_t>(v.bits << count), v.bits > (max >> count));
+    }
+
+    ConstValue binary(Op op, const ConstValue& a, const ConstValue& b) const {
+        if (op == Op::Shl || op == Op::Shr) return shift(op, a, b);
+        const ConstType t = common(a.type, b.type);
+        const ConstValue x = convert(a, t);
+        const ConstValue y = convert(b, t);
+        if (t.isFloat) {
+            switch (op) {
+            case Op::Mul: return makeReal(t, x.real * y.real);
+            case Op::Div: return makeReal(t, x.real / y.real);
+            case Op::Add: return makeReal(t, x.real + y.real);
+            case Op::Sub: return makeReal(t, x.real - y.real);
+            case Op::Lt: return makeInt(INT, x.real < y.real);
+            case Op::Le: return makeInt(INT, x.real <= y.real);
+            case Op::Gt: return makeInt(INT, x.real > y.real);
+            case Op::Ge: return makeInt(INT, x.real >= y.real);
+            case Op::Eq: return makeInt(INT, x.real == y.real);
+            case Op::Ne: return makeInt(INT, x.real != y.real);
+            default: fail("integer operator on a floating value");
+            }
+        }
+        if (!t.isSigned) {
+            switch (op) {
+            case Op::Mul: return makeInt(t, x.bits * y.bits);
+            case Op::Div:
+            case Op::Mod:
+                if (y.bits == 0) fail("division by zero");
+                return makeInt(t, op == Op::Div ? x.bits / y.bits : x.bits % y.bits);
+            case Op::Add: return makeInt(t, x.bits + y.bits);
+            case Op::Sub: return makeInt(t, x.bits - y.bits);
+            case Op::Lt: return makeInt(INT, x.bits < y.bits);
+            case Op::Le: return makeInt(INT, x.bits <= y.bits);
+            case Op::Gt: return makeInt(INT, x.bits > y.bits);
+            case Op::Ge: return makeInt(INT, x.bits >= y.bits);
+            default: break;
+            }
+        } else {
+            const std::int64_t p = asSigned(x);
+            const std::int64_t q = asSigned(y);
+            constexpr std::int64_t MIN = std::numeric_limits<std::int64_t>::min();
+            constexpr std::int64_t MAX = std::numeric_limits<std::int64_t>::max();
+            switch (op) {
+            case Op::Mul: {
+                const std::int64_t r = static_cast<std::int64_t>(x.bits * y.bits);
+                const bool overflow = p == -1 ? q == MIN : q == -1 ? p == MIN : p != 0 && r / p != q;
+                return checkedSigned(t, r, overflow);
+            }
+            case Op::Div:
+            case Op::Mod:
+                if (q == 0) fail("division by zero");
+                if (q == -1) return checkedSigned(t, op == Op::Div ? (p == MIN ? 0 : -p) : 0, p == MIN);
+                return checkedSigned(t, op == Op::Div ? p / q : p % q, false);
+            case Op::Add:
+                return checkedSigned(t, static_cast<std::int64_t>(x.bits + y.bits), (q > 0 && p > MAX - q) || (q < 0 && p < MIN - q));
+            case Op::Sub:
+                return checkedSigned(t, static_cast<std::int64_t>(x.bits - y.bits), (q < 0 && p > MAX + q) || (q > 0 && p < MIN + q));
+            case Op::Lt: return makeInt(INT, p < q);
+            case Op::Le: return makeInt(INT, p <= q);
+            case Op::Gt: return makeInt(INT, p > q);
+            case Op::Ge: return makeInt(INT, p >= q);
+            default: break;
+            }
+        }
+        switch (op) {
+        case Op::Eq: return makeInt(INT, x.bits == y.bits);
+        case Op::Ne: return makeInt(INT, x.bits != y.bits);
+        case Op::BitAnd: return makeInt(t, x.bits & y.bits);
+        case Op::BitXor: return makeInt(t, x.bits ^ y.bits);
+        case Op::BitOr: return makeInt(t, x.bits | y.bits);
+        default: fail("unsupported operator");
+        }
+    }
+
+    const std::vector<ConstValue>& constant(const std::string& name) {
+        const auto it = evaluator.m_constants.find(name);
+        if (it == evaluator.m_constants.end()) throw NotConstant{"`" + name + "` is not a constant"};
+        ConstConstant& c = *it->second;
+        if (c.values) return *c.values;
+        if (c.evaluating) fail("constant " + name + " depends on itself");
+        // Evaluated on its own, as if at its definition; only successes are
+        // kept, since a sizeof may become known further down the file.
+        c.evaluating = true;
+        ConstMachine inner{evaluator, sizeOf};
+        inner.steps = steps;
+        try {
+            std::vector<ConstValue> values;
+            const Expr e = parseExpr(c.expr);
+            std::size_t n = 1;
+            if (!c.extent.empty()) {
+                const ConstValue extent = inner.eval(parseExpr(c.extent));
+                if (extent.type.isFloat || (extent.type.isSigned && asSigned(extent) < 0)) fail("bad length for " + name);
+                n = extent.bits;
+            }
+            for (std::size_t i = 0; i < n; ++i) {
+                if (!c.extent.empty()) inner.index = makeInt(INT, i);
+                values.push_back(inner.convert(inner.eval(e), c.type));
+            }
+            c.values = std::move(values);
+        } catch (...) {
+            c.evaluating = false;
+            throw;
+        }
+        c.evaluating = false;
+        steps = inner.steps;
+        return *c.values;
+    }
+
+    const ConstValue* local(std::string_view name) {
+        for (std::size_t i = locals.size(); i-- > frame;) {
+            if (locals[i].name == name) return &locals[i].value;
+        }
+        return nullptr;
+    }
+
+    ConstValue eval(const Expr& e) {
+        switch (e.kind) {
+        case Expr::Kind::Literal:
+            return e.value;
+        case Expr::Kind::Name: {
+            if (const ConstValue* v = local(e.name)) return *v;
+            if (e.name == "_" && index) return *index;
+            const auto it = evaluator.m_constants.find(e.name);
+            if (it != evaluator.m_constants.end() && !it->second->extent.empty()) throw NotConstant{"array " + e.name + " used as a value"};
+            return constant(e.name).front();
+        }
+        case Expr::Kind::Index: {
+            const std::vector<ConstValue>& values = constant(e.name);
+            const ConstValue at = eval(e.args[0]);
+            if (at.type.isFloat) fail("floating index into " + e.name);
+            if ((at.type.isSigned && asSigned(at) < 0) || at.bits >= values.size()) {
+                fail("index " + constLiteral(at) + " is outside " + e.name + "[" + std::to_string(values.size()) + "]");
+            }
+            return values[at.bits];
+        }
+        case Expr::Kind::Call: {
+            const auto it = evaluator.m_functions.find(e.name);
+            if (it == evaluator.m_functions.end()) throw NotConstant{"`" + e.name + "` is not a const fn"};
+            std::vector<ConstValue> args;
+            for (const Expr& arg : e.args) args.push_back(eval(arg));
+            return call(*it->second, std::move(args));
+        }
+        case Expr::Kind::Unary:
+            return unary(e.op, eval(e.args[0]));
+        case Expr::Kind::Binary:
+            if (e.op == Op::And) return makeInt(INT, truthy(eval(e.args[0])) && truthy(eval(e.args[1])));
+            if (e.op == Op::Or) return makeInt(INT, truthy(eval(e.args[0])) || truthy(eval(e.args[1])));
+            return binary(e.op, eval(e.args[0]), eval(e.args[1]));
+        case Expr::Kind::Conditional:
+            return eval(e.args[truthy(eval(e.args[0])) ? 1 : 2]);
+        case Expr::Kind::Cast:
+            return convert(eval(e.args[0]), e.value.type);
+        case Expr::Kind::SizeOf: {
+            const std::optional<std::size_t> size = sizeOf ? sizeOf(e.name) : std::nullopt;
+            if (!size) throw NotConstant{"sizeof(" + e.name + ") is not known here"};
+            return makeInt(SIZE, *size);
+        }
+        }
+        fail("unsupported expression");
+    }
+
+    ConstValue call(const ConstFunction& fn, std::vector<ConstValue> args) {
+        if (args.size() != fn.params.size()) {
+            fail("const fn " + fn.name + " takes " + std::to_string(fn.params.size()) + " arguments, not " +
+                 std::to_string(args.size()));
+        }
+        if (depth >= CALL_DEPTH_LIMIT) fail("const fn calls nested deeper than " + std::to_string(CALL_DEPTH_LIMIT));
+        step();
+        const std::size_t savedFrame = frame;
+        const std::size_t savedSize = locals.size();
+        const ConstFunction* savedFunction = function;
+        const std::size_t savedLine = line;
+        frame = locals.size();
+        for (std::size_t i = 0; i < args.size(); ++i) locals.push_back({fn.params[i].first, convert(args[i], fn.params[i].second)});
+        function = &fn;
+        line = fn.line;
+        depth++;
+        ConstValue result;
+        Flow flow = Flow::Next;
+        try {
+            flow = run(fn.body, result);
+        } catch (const NotConstant& e) {
+            fail(e.reason);
+        }
+        if (flow != Flow::Return) fail("reached the end without returning a value");
+        result = convert(result, fn.ret);
+        depth--;
+        function = savedFunction;
+        line = savedLine;
+        locals.resize(savedSize);
+        frame = savedFrame;
+        return result;
+    }
+
+    Flow run(const std::vector<ConstStmt>& block, ConstValue& result) {
+        const std::size_t scope = locals.size();
+        Flow flow = Flow::Next;
+        for (const ConstStmt& s : block) {
+            flow = execute(s, result);
+            if (flow != Flow::Next) break;
+        }
+        locals.resize(scope);
+        return flow;
+    }
+
+    Flow loopBody(const std::vector<ConstStmt>& body, ConstValue& result, bool& done) {
+        step();
+        const Flow flow = run(body, result);
+        done = flow == Flow::Break || flow == Flow::Return;
+        return flow == Flow::Return ? Flow::Return : Flow::Next;
+    }
+
+    Flow execute(const ConstStmt& s, ConstValue& result) {
+        using Kind = ConstStatement::Kind;
+        line = s.line;
+        step();
+        switch (s.kind) {
+        case Kind::Var:
+            locals.push_back({s.name, s.initialized ? convert(eval(s.expr), s.type)
+                                                    : s.type.isFloat ? makeReal(s.type, 0) : makeInt(s.type, 0)});
+            return Flow::Next;
+        case Kind::Assign: {
+            ConstValue* target = nullptr;
+            for (std::size_t i = locals.size(); i-- > frame && !target;) {
+                if (locals[i].name == s.name) target = &locals[i].value;
+            }
+            if (!target) fail("cannot assign to " + s.name + ", which is not a local variable");
+            ConstValue value = eval(s.expr);
+            if (s.op) value = binary(*s.op, *target, value);
+            *target = convert(value, target->type);
+            return Flow::Next;
+        }
+        case Kind::If:
+            if (truthy(eval(s.expr))) return run(s.body, result);
+            return run(s.orElse, result);
+        case Kind::While:
+            for (bool done = false; !done && truthy(eval(s.expr));) {
+                if (loopBody(s.body, result, done) == Flow::Return) return Flow::Return;
+            }
+            return Flow::Next;
+        case Kind::Loop:
+            for (bool done = false; !done;) {
+                if (loopBody(s.body, result, done) == Flow::Return) return Flow::Return;
+            }
+            return Flow::Next;
+        case Kind::For: {
+            const std::size_t scope = locals.size();
+            locals.push_back({s.name, convert(eval(s.expr), s.type)});
+            const ConstValue bound = eval(s.limit);
+            Flow flow = Flow::Next;
+            for (bool done = false; !done;) {
+                if (!truthy(binary(Op::Lt, locals[scope].value, s.hoisted ? bound : eval(s.limit)))) break;
+                flow = loopBody(s.body, result, done);
+                if (flow == Flow::Return) break;
+                if (!done) locals[scope].value = convert(binary(Op::Add, locals[scope].value, makeInt(INT, 1)), s.type);
+            }
+            locals.resize(scope);
+            return flow;
+        }
+        case Kind::Break:
+            return Flow::Break;
+        case Kind::Continue:
+            return Flow::Continue;
+        case Kind::Return:
+            result = eval(s.expr);
+            return Flow::Return;
+        }
+        return Flow::Next;
+    }
+};
+
+std::optional<ConstValue> ConstEvaluator::evaluate(std::string_view expr, const SizeOf& sizeOf, std::string_view type,
+                                                   std::string* why) {
+    std::optional<ConstType> target;
+    if (!type.empty() && !(target = constType(type))) {
+        if (why) *why = std::string(type) + " is not an integer or floating type";
+        return std::nullopt;
+    }
+    ConstMachine machine{*this, sizeOf};
+    try {
+        const ConstValue value = machine.eval(parseExpr(expr));
+        return target ? machine.convert(value, *target) : value;
+    } catch (const NotConstant& e) {
+        if (why) *why = e.reason;
+        return std::nullopt;
+    }
+}
+
+std::optional<std::vector<ConstValue>> ConstEvaluator::table(std::string_view expr, std::string_view type,
+                                                             std::size_t count, const SizeOf& sizeOf, std::string* why) {
+    const std::optional<ConstType> t = constType(type);
+    if (!t) {
+        if (why) *why = std::string(type) + " is not an integer or floating type";
+        return std::nullopt;
+    }
+    ConstMachine machine{*this, sizeOf};
+    try {
+        const Expr e = parseExpr(expr);
+        std::vector<ConstValue> values;
+        values.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            machine.index = makeInt(INT, i);
+            values.push_back(machine.convert(machine.eval(e), *t));
+        }
+        return values;
+    } catch (const NotConstant& e) {
+        if (why) *why = e.reason;
+        return std::nullopt;
+    }
+}
+
+std::optional<std::size_t> ConstEvaluator::count(std::string_view expr, const SizeOf& sizeOf) {
+    const std::optional<ConstValue> value = evaluate(expr, sizeOf);
+    if (!value) return std::nullopt;
+    if (value->type.isFloat || (value->type.isSigned && asSigned(*value) < 0)) {
+        throw std::runtime_error("array length " + std::string(expr) + " is not a non-negative integer");
+    }
+    return value->bits;
+}
+
+} // namespace onyx
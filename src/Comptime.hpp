@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace onyx {
+
+// An arithmetic C type as the evaluator models it. Everything narrower than
+// int promotes to int, as in C.
+struct ConstType {
+    std::uint8_t bits = 32;
+    bool isSigned = true;
+    bool isFloat = false;
+    bool isBool = false;
+};
+
+// The arithmetic type spelled `type`, in Onyx (i32, u8, f64, ...) or as C
+// (int, uint32_t, double, ...); nullopt for anything else.
+std::optional<ConstType> constType(std::string_view type);
+
+struct ConstValue {
+    ConstType type;
+    std::uint64_t bits = 0; // integers, sign-extended from the type's width
+    double real = 0;        // floating types
+};
+
+// `value` as a C literal of its own type: 42, 3988292384u, -1LL, 0.5f.
+// Throws for infinities and NaNs, which have no literal.
+std::string constLiteral(const ConstValue& value);
+
+// A const fn body, one statement per source line, as the transpiler's line
+// grammar reads it. Expressions stay text until the function is defined.
+struct ConstStatement {
+    enum class Kind : std::uint8_t { Var, Assign, If, While, Loop, For, Break, Continue, Return };
+    Kind kind = Kind::Return;
+    std::size_t line = 0;
+    std::string name; // Var, Assign, For
+    std::string type; // Var, For; empty for a For over i32
+    std::string op;   // Assign: "=", "+=", "<<=", ...
+    std::string expr; // initializer, assigned value, condition, lower bound or returned value
+    std::string limit; // For: upper bound, exclusive
+    std::vector<ConstStatement> body;
+    std::vector<ConstStatement> orElse; // If: the else block
+};
+
+struct ConstFunction;
+struct ConstConstant;
+
+// Evaluates const fns and constant initializers while transpiling. Integer
+// arithmetic follows C's promotions and conversions; what C leaves undefined
+// (signed overflow, division by zero, oversized shifts) is an error here.
+//
+// Names and calls that only have a value at run time make an evaluation
+// "not constant" rather than fail, so callers can fall back to emitting the
+// expression as C. Inside a const fn they are errors.
+class ConstEvaluator {
+public:
+    // Sizes for sizeof(T); nullopt when T has none or it differs by target.
+    using SizeOf = std::function<std::optional<std::size_t>(std::string_view type)>;
+
+    ConstEvaluator();
+    ~ConstEvaluator();
+    ConstEvaluator(const ConstEvaluator& other);
+    ConstEvaluator& operator=(const ConstEvaluator& other);
+
+    // Throws when the body uses something the evaluator cannot run.
+    void defineFunction(const std::string& name, const std::vector<std::pair<std::string, std::string>>& params,
+                        std::string_view ret, std::vector<ConstStatement> body, std::size_t line);
+    // A top-level `var const`. `extent` is the array length, empty for a
+    // scalar. Types other than arithmetic ones are ignored.
+    void defineConstant(const std::string& name, std::string_view type, std::string_view extent, std::string_view expr);
+    void clear();
+
+    // True when `expr` names a constant or calls a const fn.
+    [[nodiscard]] bool mentions(std::string_view expr) const;
+    [[nodiscard]] bool empty() const { return m_functions.empty() && m_constants.empty(); }
+
+    // The value of `expr`, converted to `type` unless that is empty, or
+    // nullopt when it is not constant; `why` then says what was not.
+    std::optional<ConstValue> evaluate(std::string_view expr, const SizeOf& sizeOf, std::string_view type = {},
+                                       std::string* why = nullptr);
+    // `expr` converted to `type` for each index in [0, count), with `_` as
+    // the index; nullopt when it is not constant.
+    std::optional<std::vector<ConstValue>> table(std::string_view expr, std::string_view type, std::size_t count,
+                                                 const SizeOf& sizeOf, std::string* why = nullptr);
+    // The integer value of `expr`, for array lengths; nullopt when it is not
+    // constant, throws when it is negative or not an integer.
+    std::optional<std::size_t> count(std::string_view expr, const SizeOf& sizeOf);
+
+private:
+    friend struct ConstMachine;
+    std::unordered_map<std::string, std::shared_ptr<const ConstFunction>> m_functions;
+    std::unordered_map<std::string, std::unique_ptr<ConstConstant>> m_constants; // values are computed on first use
+};
+
+} // namespace onyx
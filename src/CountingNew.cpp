@@ -0,0 +1,27 @@
+// Replacement global allocation functions that feed AllocationScope. Linked
+// into the oxc and oxc_bench executables only, never into libox, so programs
+// embedding the library keep their own operator new.
+#include "AllocationCounter.hpp"
+#include <cstdlib>
+#include <new>
+
+// Array and nothrow forms forward here in the standard library, so this is
+// the one place sizes are seen.
+void* operator new(std::size_t size) {
+    onyx::countAllocation(size);
+    if (size == 0) size = 1;
+    while (true) {
+        if (void* p = std::malloc(size)) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,335 @@
+#include "Emitter.hpp"
+#include "Layout.hpp"
+#include <algorithm>
+#include <initializer_list>
+
+namespace onyx {
+
+namespace {
+
+// The struct-of-arrays container for an @[soa] struct: one array per field
+// and helpers that grow, fill and release them together. Each array is a
+// separate allocation, so the pointers are restrict-qualified. stdlib.h
+// comes from the layout prelude.
+void emitSoaContainer(OutputWriter& out, std::string_view element, const StructLayout& layout) {
+    const std::string soa = std::string(element).append("SoA");
+    auto each = [&](auto fn) {
+        for (const FieldLayout& field : layout.fields) fn(std::string_view(field.type), std::string_view(field.name));
+    };
+    auto line = [&](std::initializer_list<std::string_view> parts) {
+        for (std::string_view part : parts) out.write(part);
+        out.write("\n");
+    };
+
+    line({"typedef struct ", soa, " {"});
+    each([&](std::string_view type, std::string_view name) { line({"    ", type, "* restrict ", name, ";"}); });
+    line({"    size_t len;"});
+    line({"    size_t cap;"});
+    line({"} ", soa, ";"});
+
+    line({"static inline int ", soa, "_reserve(", soa, "* self, size_t cap) {"});
+    line({"    if (cap <= self->cap) return 1;"});
+    each([&](std::string_view type, std::string_view name) {
+        line({"    { ", type, "* grown = (", type, "*)realloc(self->", name, ", cap * sizeof(", type, ")); ",
+              "if (!grown) return 0; self->", name, " = grown; }"});
+    });
+    line({"    self->cap = cap;"});
+    line({"    return 1;"});
+    line({"}"});
+
+    line({"static inline int ", soa, "_resize(", soa, "* self, size_t len) {"});
+    line({"    if (!", soa, "_reserve(self, len)) return 0;"});
+    line({"    self->len = len;"});
+    line({"    return 1;"});
+    line({"}"});
+
+    line({"static inline int ", soa, "_push(", soa, "* self, ", element, " value) {"});
+    line({"    if (self->len == self->cap && !", soa, "_reserve(self, self->cap ? self->cap * 2 : 16)) return 0;"});
+    each([&](std::string_view, std::string_view name) { line({"    self->", name, "[self->len] = value.", name, ";"}); });
+    line({"    self->len++;"});
+    line({"    return 1;"});
+    line({"}"});
+
+    line({"static inline ", element, " ", soa, "_get(const ", soa, "* self, size_t index) {"});
+    line({"    ", element, " value;"});
+    each([&](std::string_view, std::string_view name) { line({"    value.", name, " = self->", name, "[index];"}); });
+    line({"    return value;"});
+    line({"}"});
+
+    line({"static inline void ", soa, "_set(", soa, "* self, size_t index, ", element, " value) {"});
+    each([&](std::string_view, std::string_view name) { line({"    self->", name, "[index] = value.", name, ";"}); });
+    line({"}"});
+
+    line({"static inline void ", soa, "_free(", soa, "* self) {"});
+    each([&](std::string_view, std::string_view name) { line({"    free(self->", name, ");"}); });
+    line({"    *self = (", soa, "){0};"});
+    line({"}"});
+}
+
+// Pins the computed size and offsets so the layout cannot drift unnoticed.
+// Layouts holding pointers assume 8-byte pointers and are only checked there.
+// stddef.h, for offsetof, comes from the layout prelude.
+void emitLayoutChecks(OutputWriter& out, std::string_view name, const StructLayout& layout) {
+    const std::string_view guard = layout.pointerSized ? "sizeof(void*) != 8 || " : "";
+    const std::string message = std::string(", \"layout of ").append(name).append(" changed\");\n");
+    out.write("_Static_assert(");
+    out.write(guard);
+    out.write("sizeof(");
+    out.write(name);
+    out.write(") == ");
+    out.write(std::to_string(layout.size));
+    out.write(message);
+    for (const FieldLayout& field : layout.fields) {
+        out.write("_Static_assert(");
+        out.write(guard);
+        out.write("offsetof(");
+        out.write(name);
+        out.write(", ");
+        out.write(field.name);
+        out.write(") == ");
+        out.write(std::to_string(field.offset));
+        out.write(message);
+    }
+}
+
+// Loop hints, as the transpiler normalised them, for the compiler that
+// understands each one. Clang's nearest match for ivdep is assume_safety.
+void emitLoopPragmas(OutputWriter& out, std::string_view hints) {
+    while (!hints.empty()) {
+        const std::size_t comma = hints.find(", ");
+        const std::string_view hint = hints.substr(0, comma);
+        hints = comma == std::string_view::npos ? std::string_view() : hints.substr(comma + 2);
+        if (hint.substr(0, 7) == "unroll(") {
+            out.write("#pragma GCC unroll ");
+            out.write(hint.substr(7, hint.size() - 8));
+            out.write("\n");
+        } else if (hint == "vectorize") {
+            out.write("#if defined(__clang__)\n#pragma clang loop vectorize(enable)\n#endif\n");
+        } else if (hint == "ivdep") {
+            out.write("#if defined(__clang__)\n#pragma clang loop vectorize(assume_safety)\n#else\n#pragma GCC ivdep\n#endif\n");
+        }
+    }
+}
+
+} // namespace
+
+void writeIndent(OutputWriter& out, int depth) {
+    static constexpr std::string_view SPACES = "                                                                ";
+    for (std::size_t n = static_cast<std::size_t>(depth) * 4; n > 0;) {
+        const std::size_t step = std::min(n, SPACES.size());
+        out.write(SPACES.substr(0, step));
+        n -= step;
+    }
+}
+
+bool rendersEmpty(const Node& node) {
+    switch (node.kind) {
+    case NodeKind::UseMixin: return !node.fields || node.fields->empty();
+    case NodeKind::Import:
+    case NodeKind::Instance: return node.text.empty();
+    case NodeKind::Line: return node.depth == 0 && node.text.empty() && !node.semicolon;
+    default: return false;
+    }
+}
+
+void emitNode(OutputWriter& out, const Node& node) {
+    if (rendersEmpty(node)) return;
+
+    if (node.kind == NodeKind::UseMixin) {
+        for (const std::string& field : *node.fields) {
+            writeIndent(out, node.depth);
+            out.write(field);
+            out.write(";\n");
+        }
+        out.write("\n");
+        return;
+    }
+    if (node.kind == NodeKind::Import || node.kind == NodeKind::Instance) {
+        out.write(node.text);
+        return;
+    }
+    if (node.kind == NodeKind::While || node.kind == NodeKind::Loop || node.kind == NodeKind::For) {
+        emitLoopPragmas(out, node.attr);
+    }
+    if (node.kind != NodeKind::Include) writeIndent(out, node.depth);
+
+    switch (node.kind) {
+    case NodeKind::Include:
+        out.write("#include \"");
+        out.write(node.text);
+        out.write("\"");
+        break;
+    case NodeKind::Comment:
+        out.write("//");
+        out.write(node.text);
+        break;
+    case NodeKind::Native:
+    case NodeKind::Line:
+        out.write(node.text);
+        if (node.semicolon) out.write(";");
+        break;
+    case NodeKind::SharedHead:
+        out.write("// shared ");
+        out.write(node.name);
+        out.write(" (elided)");
+        if (!node.attr.empty()) {
+            out.write(" [attributes: ");
+            out.write(node.attr);
+            out.write("]");
+        }
+        break;
+    case NodeKind::StructHead:
+        out.write("typedef struct ");
+        out.write(node.name);
+        out.write(" {");
+        break;
+    case NodeKind::StructEnd:
+        if (node.layout && node.layout->reordered) {
+            // The closing line's indentation is already written; fields sit one deeper.
+            for (const FieldLayout& field : node.layout->fields) {
+                out.write("    ");
+                out.write(field.type);
+                out.write(" ");
+                out.write(field.name);
+                out.write(";\n");
+                writeIndent(out, node.depth);
+            }
+        }
+        // Attributes go on the struct itself; after the typedef name GCC
+        // ignores packed and leaves aligned out of the size.
+        out.write("} ");
+        if (!node.attr.empty()) {
+            out.write("__attribute__((");
+            out.write(node.attr);
+            out.write(")) ");
+        }
+        out.write(node.name);
+        out.write(";\n");
+        if (node.layout && node.layout->soa) {
+            out.write("\n");
+            emitSoaContainer(out, node.name, *node.layout);
+        }
+        if (node.layout && node.layout->checked) emitLayoutChecks(out, node.name, *node.layout);
+        return;
+    case NodeKind::ResolveHead:
+        out.write("// resolve ");
+        out.write(node.name);
+        break;
+    case NodeKind::ResolveEnd:
+        out.write("// end resolve");
+        break;
+    case NodeKind::Field:
+        out.write(node.type);
+        out.write(" ");
+        out.write(node.name);
+        out.write(";");
+        break;
+    case NodeKind::Function:
+        if (!node.attr.empty()) {
+            out.write("__attribute__((");
+            out.write(node.attr);
+            out.write(")) ");
+        }
+        if (!node.mods.empty()) {
+            out.write(node.mods);
+            out.write(" ");
+        }
+        out.write(node.type);
+        out.write(" ");
+        if (!node.owner.empty()) {
+            out.write(node.owner);
+            out.write("_");
+        }
+        out.write(node.name);
+        out.write("(");
+        for (std::uint32_t i = 0; i < node.paramCount; ++i) {
+            if (i) out.write(", ");
+            out.write(node.params[i].type);
+            out.write(" ");
+            out.write(node.params[i].name);
+        }
+        out.write(node.definition ? ") {" : ");");
+        break;
+    case NodeKind::Var:
+        if (!node.mods.empty()) {
+            out.write(node.mods);
+            out.write(" ");
+        }
+        out.write(node.type);
+        out.write(" ");
+        out.write(node.name);
+        if (!node.extent.empty()) {
+            out.write("[");
+            out.write(node.extent);
+            out.write("]");
+        }
+        if (!node.text.empty()) {
+            out.write(" = ");
+            out.write(node.text);
+        }
+        out.write(";");
+        break;
+    case NodeKind::If:
+        out.write("if (");
+        out.write(node.text);
+        out.write(") {");
+        break;
+    case NodeKind::While:
+        out.write("while (");
+        out.write(node.text);
+        out.write(") {");
+        break;
+    case NodeKind::Loop:
+        out.write("while (1) {");
+        break;
+    case NodeKind::For:
+        out.write("for (");
+        out.write(node.text);
+        out.write(") {");
+        break;
+    case NodeKind::Region:
+        // The cleanup runs on every way out of the block, return and break included.
+        out.write("{\n");
+        writeIndent(out, node.depth + 1);
+        if (node.type.empty()) {
+            out.write("onyx_region ");
+            out.write(node.name);
+            out.write(" __attribute__((cleanup(onyx_region_release))) = {.name = \"");
+            out.write(node.name);
+            out.write("\"};");
+        } else {
+            out.write("onyx_pool ");
+            out.write(node.name);
+            out.write(" __attribute__((cleanup(onyx_pool_release))) = onyx_pool_make(\"");
+            out.write(node.name);
+            out.write("\", sizeof(");
+            out.write(node.type);
+            out.write("), __alignof__(");
+            out.write(node.type);
+            out.write("));");
+        }
+        break;
+    case NodeKind::GenericHead:
+        out.write("// generic ");
+        out.write(node.mods);
+        out.write(" ");
+        out.write(node.name);
+        out.write(" (instantiated per use)");
+        break;
+    case NodeKind::UseMixin: // its fields were written above
+    case NodeKind::Import:
+    case NodeKind::Instance:
+        break;
+    }
+    out.write("\n");
+}
+
+std::string renderNode(const Node& node) {
+    std::string text;
+    OutputWriter out(0);
+    out.open(text);
+    emitNode(out, node);
+    return text;
+}
+
+} // namespace onyx
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Ast.hpp"
+#include "OutputWriter.hpp"
+#include <string>
+
+namespace onyx {
+
+// Writes the C for one node, including its trailing newline, straight into
+// the output buffer.
+void emitNode(OutputWriter& out, const Node& node);
+
+// Nodes that produce no output at all (not even a newline).
+bool rendersEmpty(const Node& node);
+
+// The text emitNode would write, for output that has to be held back.
+std::string renderNode(const Node& node);
+
+// Writes `depth` levels of four-space indentation. `depth` must not be negative.
+void writeIndent(OutputWriter& out, int depth);
+
+} // namespace onyx
@@ -0,0 +1,105 @@
+#include "Generics.hpp"
+#include "Lexer.hpp"
+
+namespace onyx {
+
+namespace {
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && isSpace(s.front())) s.remove_prefix(1);
+    while (!s.empty() && isSpace(s.back())) s.remove_suffix(1);
+    return s;
+}
+
+// Index of the `>` closing the list opened at `open`, or npos when the list
+// holds anything but type spellings.
+std::size_t closeArguments(std::string_view s, std::size_t open) {
+    int depth = 0;
+    for (std::size_t i = open; i < s.size(); ++i) {
+        const char c = s[i];
+        if (c == '<') {
+            depth++;
+        } else if (c == '>') {
+            if (--depth == 0) return i;
+        } else if (!isWordChar(c) && !isSpace(c) && c != '*' && c != ',') {
+            return std::string_view::npos;
+        }
+    }
+    return std::string_view::npos;
+}
+
+} // namespace
+
+bool nextGenericSpelling(std::string_view s, std::size_t from, GenericSpelling& spelling) {
+    for (std::size_t lt = s.find('<', from); lt != std::string_view::npos; lt = s.find('<', lt + 1)) {
+        std::size_t begin = lt;
+        while (begin > from && isWordChar(s[begin - 1])) --begin;
+        if (begin == lt || (s[begin] >= '0' && s[begin] <= '9')) continue;
+        const std::size_t gt = closeArguments(s, lt);
+        if (gt == std::string_view::npos) continue;
+
+        spelling.name = s.substr(begin, lt - begin);
+        spelling.args.clear();
+        int depth = 0;
+        std::size_t start = lt + 1;
+        for (std::size_t i = lt + 1; i <= gt; ++i) {
+            if (s[i] == '<') depth++;
+            else if (s[i] == '>' && depth > 0) depth--;
+            else if ((s[i] == ',' && depth == 0) || i == gt) {
+                spelling.args.push_back(trim(s.substr(start, i - start)));
+                start = i + 1;
+            }
+        }
+        bool empty = false;
+        for (std::string_view arg : spelling.args) empty = empty || arg.empty();
+        if (empty) continue;
+        spelling.begin = begin;
+        spelling.end = gt + 1;
+        return true;
+    }
+    return false;
+}
+
+std::string mangleGeneric(std::string_view spelling) {
+    spelling = trim(spelling);
+    GenericSpelling generic;
+    std::string out;
+    std::size_t rest = 0;
+    if (nextGenericSpelling(spelling, 0, generic) && generic.begin == 0) {
+        out = generic.name;
+        for (std::string_view arg : generic.args) out.append("_").append(mangleGeneric(arg));
+        rest = generic.end;
+    }
+    for (char c : spelling.substr(rest)) {
+        if (c == '*') out += "_ptr";
+        else if (!isSpace(c)) out += c;
+    }
+    return out;
+}
+
+bool matchGenericHead(std::string_view line, std::string_view& keyword, std::string_view& name,
+                      std::vector<std::string_view>& params) {
+    Lexer lex(line);
+    const Token kw = lex.next();
+    const Keyword k = kw.keyword();
+    if (k != Keyword::Struct && k != Keyword::Resolve && k != Keyword::Shared) return false;
+    const Token id = lex.next();
+    if (!id.isWord() || !id.spaced) return false;
+    const Token open = lex.next();
+    if (!open.is('<') || open.spaced) return false;
+    params.clear();
+    for (;;) {
+        const Token param = lex.next();
+        if (!param.isWord()) return false;
+        params.push_back(param.text);
+        const Token sep = lex.next();
+        if (sep.is('>')) break;
+        if (!sep.is(',')) return false;
+    }
+    if (!lex.next().is('{')) return false;
+    keyword = kw.text;
+    name = id.text;
+    return true;
+}
+
+} // namespace onyx
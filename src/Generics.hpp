@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace onyx {
+
+// One `Name<arg, ...>` type spelling.
+struct GenericSpelling {
+    std::string_view name;
+    std::vector<std::string_view> args; // trimmed; may be generic spellings themselves
+    std::size_t begin = 0;              // byte range of the whole spelling in the scanned text
+    std::size_t end = 0;
+};
+
+// The first generic spelling at or after `from`: an identifier immediately
+// followed by `<`, then type spellings (words, `*`, nested spellings)
+// separated by commas, then the matching `>`. Comparisons such as `a < b`
+// or `x<y && z>w` do not qualify.
+bool nextGenericSpelling(std::string_view s, std::size_t from, GenericSpelling& spelling);
+
+// The C identifier an instantiation is emitted under:
+// Vec<i32> -> Vec_i32, Map<str, Vec<u8*>> -> Map_str_Vec_u8_ptr.
+std::string mangleGeneric(std::string_view spelling);
+
+// `keyword Name<P, ...> {` as a generic struct, resolve or shared block opens.
+bool matchGenericHead(std::string_view line, std::string_view& keyword, std::string_view& name,
+                      std::vector<std::string_view>& params);
+
+} // namespace onyx
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace onyx {
+
+// Streaming 64-bit content hash (8 bytes per step, murmur-style mixing). Used
+// to key cached outputs; not cryptographic.
+class Hasher {
+public:
+    explicit Hasher(std::uint64_t seed = 0x9e3779b97f4a7c15ull) : m_state(seed) {}
+
+    Hasher& update(std::string_view data) {
+        const char* p = data.data();
+        std::size_t n = data.size();
+        for (; n >= 8; p += 8, n -= 8) {
+            std::uint64_t word;
+            std::memcpy(&word, p, 8);
+            mix(word);
+        }
+        std::uint64_t tail = 0;
+        std::memcpy(&tail, p, n);
+        mix(tail ^ (static_cast<std::uint64_t>(data.size()) << 56));
+        return *this;
+    }
+
+    Hasher& update(std::uint64_t value) {
+        mix(value);
+        return *this;
+    }
+
+    [[nodiscard]] std::uint64_t digest() const {
+        std::uint64_t h = m_state;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    [[nodiscard]] std::string hex() const { return toHex(digest()); }
+
+    static std::string toHex(std::uint64_t h) {
+        static constexpr char digits[] = "0123456789abcdef";
+        std::string out(16, '0');
+        for (int i = 15; i >= 0; --i, h >>= 4) out[i] = digits[h & 0xf];
+        return out;
+    }
+
+private:
+    void mix(std::uint64_t k) {
+        k *= 0x87c37b91114253d5ull;
+        k = (k << 31) | (k >> 33);
+        k *= 0x4cf5ad432745937full;
+        m_state ^= k;
+        m_state = ((m_state << 27) | (m_state >> 37)) * 5 + 0x52dce729;
+    }
+
+    std::uint64_t m_state;
+};
+
+} // namespace onyx
@@ -0,0 +1,99 @@
+#include "Layout.hpp"
+#include "Lexer.hpp"
+#include "Simd.hpp"
+#include <algorithm>
+#include <cstdio>
+
+namespace onyx {
+
+bool lookupLayout(std::string_view type, const std::unordered_map<std::string, TypeLayout>& structs,
+                  TypeLayout& layout) {
+    if (!type.empty() && type.back() == '*') {
+        layout = {8, 8, true};
+        return true;
+    }
+    if (type == "char" || type == "bool" || type == "uint8_t" || type == "int8_t") layout = {1, 1};
+    else if (type == "uint16_t" || type == "int16_t") layout = {2, 2};
+    else if (type == "int" || type == "uint32_t" || type == "int32_t" || type == "float") layout = {4, 4};
+    else if (type == "double" || type == "uint64_t" || type == "int64_t") layout = {8, 8};
+    else if (const VectorType* vector = findVectorType(type)) layout = {vector->size, vector->size};
+    else if (auto it = structs.find(std::string(type)); it != structs.end()) layout = it->second;
+    else return false;
+    return true;
+}
+
+void reorderFields(StructLayout& layout, bool byAlignment) {
+    std::stable_sort(layout.fields.begin(), layout.fields.end(), [byAlignment](const FieldLayout& a, const FieldLayout& b) {
+        if (a.hot != b.hot) return a.hot;
+        return (a.hot || byAlignment) && a.align > b.align;
+    });
+}
+
+void computeOffsets(StructLayout& layout, bool packed, std::size_t minAlign) {
+    std::size_t offset = 0;
+    std::size_t align = 1;
+    std::size_t used = 0;
+    for (FieldLayout& field : layout.fields) {
+        const std::size_t a = packed ? 1 : field.align;
+        offset = (offset + a - 1) / a * a;
+        field.offset = offset;
+        offset += field.size;
+        used += field.size;
+        align = std::max(align, a);
+    }
+    align = std::max(align, minAlign);
+    layout.align = align;
+    layout.size = (offset + align - 1) / align * align;
+    layout.padding = layout.size - used;
+}
+
+void writeLayoutReport(std::ostream& out, std::string_view input, const std::vector<StructLayout>& layouts) {
+    char buffer[160];
+    out << "layout - " << input << "\n";
+    for (const StructLayout& layout : layouts) {
+        if (!layout.known()) {
+            out << "  struct " << layout.name << ": unknown (field type " << layout.unknownType << ")\n";
+            continue;
+        }
+        std::snprintf(buffer, sizeof(buffer), "  struct %s: size %zu, align %zu, padding %zu%s\n", layout.name.c_str(),
+                      layout.size, layout.align, layout.padding, layout.reordered ? " (reordered)" : "");
+        out << buffer;
+        std::size_t end = 0;
+        auto gap = [&](std::size_t until) {
+            if (until <= end) return;
+            std::snprintf(buffer, sizeof(buffer), "    %6zu %5zu  (padding)\n", end, until - end);
+            out << buffer;
+        };
+        for (const FieldLayout& field : layout.fields) {
+            gap(field.offset);
+            std::snprintf(buffer, sizeof(buffer), "    %6zu %5zu  %s %s%s\n", field.offset, field.size, field.type.c_str(),
+                          field.name.c_str(), field.hot ? " [hot]" : "");
+            out << buffer;
+            end = field.offset + field.size;
+        }
+        gap(layout.size);
+    }
+}
+
+LayoutHeaders layoutHeadersIn(std::string_view line) {
+    const std::size_t open = line.find("@[");
+    if (open == std::string_view::npos) return 0;
+    LayoutHeaders headers = 0;
+    Lexer lex(line.substr(open + 2));
+    for (Token t = lex.next(); t.kind != TokenKind::End && !t.is(']'); t = lex.next()) {
+        if (!t.isWord()) continue;
+        if (t.text == "soa") headers |= LAYOUT_STDLIB;
+        // The attributes that get a struct checked. A bare hot is the
+        // function attribute.
+        else if (t.text == "reorder" || ((t.text == "hot" || t.text == "align") && lex.peek().is('(')))
+            headers |= LAYOUT_STDDEF;
+    }
+    return headers;
+}
+
+void writeLayoutPrelude(std::string& out, LayoutHeaders headers) {
+    if (headers & LAYOUT_STDDEF) out += "#include <stddef.h>\n";
+    if (headers & LAYOUT_STDLIB) out += "#include <stdlib.h>\n";
+}
+
+} // namespace onyx
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace onyx {
+
+inline constexpr std::size_t CACHE_LINE = 64;
+
+// Size and alignment of a C type under the LP64 model the generated C is
+// normally built for.
+struct TypeLayout {
+    std::size_t size = 0;
+    std::size_t align = 1;
+    bool pointerSized = false; // holds a pointer somewhere; differs on 32-bit targets
+};
+
+struct FieldLayout {
+    std::string type; // C type
+    std::string name;
+    std::size_t size = 0;
+    std::size_t align = 1;
+    std::size_t offset = 0;
+    bool hot = false;
+};
+
+// One struct's fields in emission order and where they land.
+struct StructLayout {
+    std::string name;
+    std::vector<FieldLayout> fields;
+    std::size_t size = 0;
+    std::size_t align = 1;
+    std::size_t padding = 0;
+    bool pointerSized = false;
+    std::string unknownType; // first field type without a known layout; size and offsets are then unset
+
+    // What the struct's closing line emits besides `} name;`.
+    bool soa = false;       // the <name>SoA container
+    bool reordered = false; // the fields themselves, held back until the end
+    bool sorted = false;    // ...ordered by alignment, not just hot fields first
+    bool checked = false;   // _Static_assert checks of size and offsets
+
+    [[nodiscard]] bool known() const { return unknownType.empty(); }
+};
+
+// Layouts of primitive C types (as translateType spells them), vector types,
+// pointers and the structs in `structs`; false for anything else.
+bool lookupLayout(std::string_view type, const std::unordered_map<std::string, TypeLayout>& structs,
+                  TypeLayout& layout);
+
+// Hot fields first, then, when `byAlignment`, the rest by decreasing
+// alignment. Both groups keep source order among equals.
+void reorderFields(StructLayout& layout, bool byAlignment);
+
+// Assigns offsets and the total size. `packed` drops all padding; `minAlign`
+// comes from an aligned(N) attribute.
+void computeOffsets(StructLayout& layout, bool packed, std::size_t minAlign);
+
+void writeLayoutReport(std::ostream& out, std::string_view input, const std::vector<StructLayout>& layouts);
+
+// Headers the C for struct attributes relies on, written once in the
+// prelude rather than next to every struct. Bit set as for VectorSet.
+enum LayoutHeader : unsigned {
+    LAYOUT_STDLIB = 1, // @[soa] containers allocate with realloc and free
+    LAYOUT_STDDEF = 2, // layout checks use offsetof
+};
+using LayoutHeaders = unsigned;
+
+// The headers the attributes on `line` call for.
+LayoutHeaders layoutHeadersIn(std::string_view line);
+void writeLayoutPrelude(std::string& out, LayoutHeaders headers);
+
+} // namespace onyx
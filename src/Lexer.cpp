@@ -0,0 +1,94 @@
+#include "Lexer.hpp"
+
+namespace onyx {
+
+Keyword classifyKeyword(std::string_view word) {
+    switch (word.size()) {
+    case 2:
+        if (word == "fn") return Keyword::Fn;
+        if (word == "if") return Keyword::If;
+        break;
+    case 3:
+        if (word == "var") return Keyword::Var;
+        if (word == "use") return Keyword::Use;
+        if (word == "for") return Keyword::For;
+        break;
+    case 4:
+        if (word == "loop") return Keyword::Loop;
+        if (word == "pool") return Keyword::Pool;
+        break;
+    case 5:
+        if (word == "while") return Keyword::While;
+        if (word == "const") return Keyword::Const;
+        break;
+    case 6:
+        if (word == "struct") return Keyword::Struct;
+        if (word == "shared") return Keyword::Shared;
+        if (word == "native") return Keyword::Native;
+        if (word == "inline") return Keyword::Inline;
+        if (word == "extern") return Keyword::Extern;
+        if (word == "static") return Keyword::Static;
+        if (word == "import") return Keyword::Import;
+        if (word == "region") return Keyword::Region;
+        break;
+    case 7:
+        if (word == "resolve") return Keyword::Resolve;
+        if (word == "include") return Keyword::Include;
+        break;
+    case 8:
+        if (word == "volatile") return Keyword::Volatile;
+        if (word == "register") return Keyword::Register;
+        break;
+    default:
+        break;
+    }
+    return Keyword::None;
+}
+
+Keyword Token::keyword() const {
+    return kind == TokenKind::Word ? classifyKeyword(text) : Keyword::None;
+}
+
+Token Lexer::next() {
+    Token tok;
+    const std::size_t start = m_pos;
+    while (m_pos < m_line.size() && isSpace(m_line[m_pos])) ++m_pos;
+    tok.spaced = m_pos != start;
+    tok.offset = m_pos;
+    if (m_pos >= m_line.size()) return tok;
+
+    const char c = m_line[m_pos];
+    std::size_t end = m_pos + 1;
+    if (isWordChar(c)) {
+        tok.kind = TokenKind::Word;
+        while (end < m_line.size() && isWordChar(m_line[end])) ++end;
+    } else if (c == '"' || c == '\'') {
+        // Only terminated literals form a single token; a stray quote is punctuation.
+        std::size_t i = end;
+        while (i < m_line.size() && m_line[i] != c) i += m_line[i] == '\\' ? 2 : 1;
+        if (i < m_line.size()) {
+            tok.kind = TokenKind::String;
+            end = i + 1;
+        } else {
+            tok.kind = TokenKind::Punct;
+        }
+    } else {
+        tok.kind = TokenKind::Punct;
+        if (end < m_line.size()) {
+            const char n = m_line[end];
+            if (((c == '-' || c == '|') && n == '>') || (c == '@' && n == '[')) ++end;
+        }
+    }
+    tok.text = m_line.substr(m_pos, end - m_pos);
+    m_pos = end;
+    return tok;
+}
+
+Token Lexer::peek() {
+    const std::size_t saved = m_pos;
+    Token tok = next();
+    m_pos = saved;
+    return tok;
+}
+
+} // namespace onyx
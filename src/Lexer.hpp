@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace onyx {
+
+enum class TokenKind : std::uint8_t {
+    End,
+    Word,   // [A-Za-z0-9_]+ (identifiers, keywords, numbers)
+    String, // terminated "..." or '...' literal
+    Punct   // single character, or one of "->", "|>", "@["
+};
+
+enum class Keyword : std::uint8_t {
+    None,
+    Fn, Var, Struct, Shared, Resolve, Use,
+    If, While, Loop, For, Native,
+    Inline, Extern, Static,
+    Volatile, Register, Const,
+    Include, Import,
+    Region, Pool
+};
+
+struct Token {
+    TokenKind kind = TokenKind::End;
+    std::string_view text;
+    std::size_t offset = 0; // byte offset into the scanned line
+    bool spaced = false;    // preceded by whitespace
+
+    [[nodiscard]] std::size_t end() const { return offset + text.size(); }
+    [[nodiscard]] bool is(char c) const {
+        return kind == TokenKind::Punct && text.size() == 1 && text[0] == c;
+    }
+    [[nodiscard]] bool is(std::string_view punct) const {
+        return kind == TokenKind::Punct && text == punct;
+    }
+    [[nodiscard]] bool isWord() const { return kind == TokenKind::Word; }
+    [[nodiscard]] Keyword keyword() const;
+};
+
+// Character classes matching the semantics of std::regex's \s and \w.
+constexpr bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+constexpr bool isWordChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+Keyword classifyKeyword(std::string_view word);
+
+// Pull lexer over a single source line. Tokens are views into the line; the
+// lexer never allocates.
+class Lexer {
+public:
+    explicit Lexer(std::string_view line, std::size_t pos = 0) : m_line(line), m_pos(pos) {}
+
+    Token next();
+    Token peek();
+
+    [[nodiscard]] std::string_view line() const { return m_line; }
+    [[nodiscard]] std::size_t position() const { return m_pos; }
+    void seek(std::size_t pos) { m_pos = pos; }
+
+private:
+    std::string_view m_line;
+    std::size_t m_pos;
+};
+
+} // namespace onyx
@@ -0,0 +1,70 @@
+#include "MappedFile.hpp"
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ONYX_HAVE_MMAP 1
+#endif
+
+namespace onyx {
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this == &other) return *this;
+    close();
+    m_mapped = std::exchange(other.m_mapped, false);
+    m_size = std::exchange(other.m_size, 0);
+    m_fallback = std::move(other.m_fallback);
+    m_data = m_mapped ? std::exchange(other.m_data, nullptr) : m_fallback.data();
+    other.m_data = nullptr;
+    return *this;
+}
+
+bool MappedFile::open(const std::filesystem::path& path) {
+    close();
+#ifdef ONYX_HAVE_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st {};
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* addr = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            ::madvise(addr, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+            m_data = static_cast<const char*>(addr);
+            m_size = static_cast<std::size_t>(st.st_size);
+            m_mapped = true;
+        }
+    }
+    ::close(fd);
+    if (m_mapped) return true;
+#endif
+    // Fallback for platforms without mmap and for non-regular files (pipes).
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    m_fallback = buffer.str();
+    m_data = m_fallback.data();
+    m_size = m_fallback.size();
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef ONYX_HAVE_MMAP
+    if (m_mapped) ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+    m_mapped = false;
+    m_data = nullptr;
+    m_size = 0;
+    m_fallback.clear();
+}
+
+} // namespace onyx
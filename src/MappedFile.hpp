@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace onyx {
+
+// Read-only view of a whole input file. On POSIX systems the file is
+// memory-mapped so that lines can be walked as string_views without copying;
+// elsewhere it falls back to reading the file into memory.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path& path) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool open(const std::filesystem::path& path);
+    void close();
+
+    [[nodiscard]] std::string_view view() const { return {m_data, m_size}; }
+    [[nodiscard]] bool empty() const { return m_size == 0; }
+
+private:
+    const char* m_data = nullptr;
+    std::size_t m_size = 0;
+    bool m_mapped = false;
+    std::string m_fallback;
+};
+
+} // namespace onyx
@@ -0,0 +1,120 @@
+#include "Module.hpp"
+#include <cstring>
+
+namespace onyx {
+
+namespace {
+
+constexpr std::string_view MAGIC{"OXI\0", 4};
+
+template <typename T>
+void put(std::string& out, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+}
+
+void putString(std::string& out, std::string_view text) {
+    put(out, static_cast<std::uint32_t>(text.size()));
+    out.append(text);
+}
+
+void putList(std::string& out, const std::vector<std::string>& items) {
+    put(out, static_cast<std::uint32_t>(items.size()));
+    for (const std::string& item : items) putString(out, item);
+}
+
+// Bounds-checked cursor over serialized bytes. Any short read latches
+// failure and yields zeros from then on.
+class Reader {
+public:
+    explicit Reader(std::string_view bytes) : m_bytes(bytes) {}
+
+    template <typename T>
+    T get() {
+        T value{};
+        if (!take(sizeof(T))) return value;
+        std::memcpy(&value, m_bytes.data() + m_pos - sizeof(T), sizeof(T));
+        return value;
+    }
+    std::string_view getString() {
+        const auto size = get<std::uint32_t>();
+        if (!take(size)) return {};
+        return m_bytes.substr(m_pos - size, size);
+    }
+    // Counts are checked against what is left so a corrupt file cannot
+    // trigger a huge reservation.
+    std::uint32_t getCount() {
+        const auto count = get<std::uint32_t>();
+        if (count > m_bytes.size() - m_pos) m_failed = true;
+        return m_failed ? 0 : count;
+    }
+    void getList(std::vector<std::string_view>& items) {
+        const auto count = getCount();
+        items.reserve(count);
+        for (std::uint32_t i = 0; i < count && !m_failed; ++i) items.push_back(getString());
+    }
+
+    [[nodiscard]] bool ok() const { return !m_failed; }
+    [[nodiscard]] bool atEnd() const { return m_pos == m_bytes.size(); }
+
+private:
+    bool take(std::size_t size) {
+        if (m_failed || size > m_bytes.size() - m_pos) {
+            m_failed = true;
+            return false;
+        }
+        m_pos += size;
+        return true;
+    }
+
+    std::string_view m_bytes;
+    std::size_t m_pos = 0;
+    bool m_failed = false;
+};
+
+} // namespace
+
+std::string serializeInterface(const InterfaceData& data) {
+    std::string out(MAGIC);
+    put(out, INTERFACE_SCHEMA);
+    put(out, data.sourceHash);
+    put(out, static_cast<std::uint32_t>(data.imports.size()));
+    for (const auto& [spelling, key] : data.imports) {
+        putString(out, spelling);
+        put(out, key);
+    }
+    putList(out, data.includes);
+    put(out, static_cast<std::uint32_t>(data.mixins.size()));
+    for (const auto& [name, fields] : data.mixins) {
+        putString(out, name);
+        putList(out, fields);
+    }
+    putList(out, data.structs);
+    putList(out, data.prototypes);
+    return out;
+}
+
+bool parseInterface(std::string_view bytes, InterfaceView& view) {
+    if (bytes.substr(0, MAGIC.size()) != MAGIC) return false;
+    Reader in(bytes.substr(MAGIC.size()));
+    if (in.get<std::uint32_t>() != INTERFACE_SCHEMA) return false;
+    view = {};
+    view.sourceHash = in.get<std::uint64_t>();
+    for (auto count = in.getCount(); count > 0 && in.ok(); --count) {
+        InterfaceView::Import& import = view.imports.emplace_back();
+        import.spelling = in.getString();
+        import.key = in.get<std::uint64_t>();
+    }
+    in.getList(view.includes);
+    for (auto count = in.getCount(); count > 0 && in.ok(); --count) {
+        InterfaceView::Mixin& mixin = view.mixins.emplace_back();
+        mixin.name = in.getString();
+        in.getList(mixin.fields);
+    }
+    in.getList(view.structs);
+    in.getList(view.prototypes);
+    return in.ok() && in.atEnd();
+}
+
+} // namespace onyx
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace onyx {
+
+// Bump when the .oxi layout or the C it describes changes.
+inline constexpr std::uint32_t INTERFACE_SCHEMA = 3;
+
+// What another file needs to use a module, already translated to C: the
+// headers its declarations rely on, its mixins, its struct typedefs and the
+// prototypes of its functions and resolve methods.
+struct InterfaceData {
+    std::uint64_t sourceHash = 0;
+    std::vector<std::pair<std::string, std::uint64_t>> imports; // spelling as written, module key
+    std::vector<std::string> includes;
+    std::vector<std::pair<std::string, std::vector<std::string>>> mixins;
+    std::vector<std::string> structs;    // one rendered typedef each
+    std::vector<std::string> prototypes;
+};
+
+// The same, as views into a serialized interface. Parsing only slices the
+// bytes, so a memory-mapped .oxi is usable without copying.
+struct InterfaceView {
+    struct Import {
+        std::string_view spelling;
+        std::uint64_t key = 0;
+    };
+    struct Mixin {
+        std::string_view name;
+        std::vector<std::string_view> fields;
+    };
+    std::uint64_t sourceHash = 0;
+    std::vector<Import> imports;
+    std::vector<std::string_view> includes;
+    std::vector<Mixin> mixins;
+    std::vector<std::string_view> structs;
+    std::vector<std::string_view> prototypes;
+};
+
+// Layout (host byte order): "OXI\0", u32 schema, u64 source hash, then each
+// list as a u32 count of u32-length-prefixed strings; imports carry a u64
+// key after their spelling and mixins a nested field list after their name.
+std::string serializeInterface(const InterfaceData& data);
+// False when `bytes` is not a complete interface of this schema.
+bool parseInterface(std::string_view bytes, InterfaceView& view);
+
+} // namespace onyx
@@ -0,0 +1,62 @@
+#include "OutputCache.hpp"
+#include "MappedFile.hpp"
+#include <atomic>
+#include <random>
+#include <string>
+
+namespace onyx {
+
+std::optional<std::filesystem::path> OutputCache::lookup(std::string_view key) const {
+    std::error_code ec;
+    auto path = entryPath(key);
+    if (std::filesystem::is_regular_file(path, ec)) return path;
+    return std::nullopt;
+}
+
+bool OutputCache::store(std::string_view key, const std::filesystem::path& contents) const {
+    const auto path = entryPath(key);
+    const auto temp = uniqueSibling(path);
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    if (!std::filesystem::copy_file(contents, temp, std::filesystem::copy_options::overwrite_existing, ec)) return false;
+    std::filesystem::rename(temp, path, ec);
+    if (ec) std::filesystem::remove(temp, ec);
+    return !ec;
+}
+
+std::filesystem::path OutputCache::entryPath(std::string_view key) const {
+    std::string name(key);
+    return m_dir / name.substr(0, 2) / (name + ".c");
+}
+
+bool sameContents(const std::filesystem::path& a, const std::filesystem::path& b) {
+    std::error_code ec;
+    const auto sizeA = std::filesystem::file_size(a, ec);
+    if (ec) return false;
+    const auto sizeB = std::filesystem::file_size(b, ec);
+    if (ec || sizeA != sizeB) return false;
+    if (sizeA == 0) return true;
+    MappedFile fa(a), fb(b);
+    return !fa.empty() && fa.view() == fb.view();
+}
+
+bool commitOutput(const std::filesystem::path& staging, const std::filesystem::path& target) {
+    std::error_code ec;
+    if (sameContents(staging, target)) {
+        std::filesystem::remove(staging, ec);
+        return true;
+    }
+    std::filesystem::rename(staging, target, ec);
+    if (ec) std::filesystem::remove(staging, ec);
+    return !ec;
+}
+
+std::filesystem::path uniqueSibling(const std::filesystem::path& path) {
+    static std::atomic<unsigned> counter{0};
+    static const unsigned salt = std::random_device{}();
+    auto temp = path;
+    temp += ".tmp." + std::to_string(salt) + "." + std::to_string(counter++);
+    return temp;
+}
+
+} // namespace onyx
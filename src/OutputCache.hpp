@@ -0,0 +1,36 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+namespace onyx {
+
+// Content-addressed store of transpiled outputs: <dir>/<xx>/<key>.c, where
+// the key hashes everything the output depends on. Entries are written
+// atomically, so several oxc processes may share one directory.
+class OutputCache {
+public:
+    explicit OutputCache(std::filesystem::path dir) : m_dir(std::move(dir)) {}
+
+    [[nodiscard]] std::optional<std::filesystem::path> lookup(std::string_view key) const;
+    bool store(std::string_view key, const std::filesystem::path& contents) const;
+
+private:
+    [[nodiscard]] std::filesystem::path entryPath(std::string_view key) const;
+
+    std::filesystem::path m_dir;
+};
+
+// Whether two files hold exactly the same bytes.
+bool sameContents(const std::filesystem::path& a, const std::filesystem::path& b);
+
+// Moves `staging` over `target` unless `target` already has identical
+// contents, in which case `target` (and its timestamp) is left untouched.
+// Returns false on I/O failure.
+bool commitOutput(const std::filesystem::path& staging, const std::filesystem::path& target);
+
+// Name for a temporary sibling of `path` that is unique to this call.
+std::filesystem::path uniqueSibling(const std::filesystem::path& path);
+
+} // namespace onyx
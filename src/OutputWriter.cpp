@@ -0,0 +1,75 @@
+#include "OutputWriter.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace onyx {
+
+OutputWriter::OutputWriter(std::size_t capacity) : m_buffer(capacity) {}
+
+OutputWriter::~OutputWriter() {
+    close();
+}
+
+bool OutputWriter::open(const std::filesystem::path& path) {
+    close();
+    m_file = std::fopen(path.string().c_str(), "wb");
+    m_failed = m_file == nullptr;
+    if (m_file) std::setvbuf(m_file, nullptr, _IONBF, 0); // we buffer ourselves
+    return m_file != nullptr;
+}
+
+bool OutputWriter::open(std::FILE* stream) {
+    close();
+    m_file = stream;
+    m_failed = m_file == nullptr;
+    if (m_file) std::setvbuf(m_file, nullptr, _IONBF, 0);
+    return m_file != nullptr;
+}
+
+void OutputWriter::open(std::string& target) {
+    close();
+    m_string = &target;
+    m_failed = false;
+}
+
+bool OutputWriter::close() {
+    if (m_string) {
+        m_string = nullptr;
+        return true;
+    }
+    if (!m_file) return false;
+    bool ok = flush();
+    const auto start = std::chrono::steady_clock::now();
+    ok = std::fclose(m_file) == 0 && ok;
+    m_ioTime += std::chrono::steady_clock::now() - start;
+    m_file = nullptr;
+    return ok;
+}
+
+void OutputWriter::write(std::string_view text) {
+    if (m_string) {
+        m_string->append(text);
+        return;
+    }
+    while (!text.empty()) {
+        if (m_used == m_buffer.size() && !flush()) return;
+        const std::size_t n = std::min(text.size(), m_buffer.size() - m_used);
+        std::memcpy(m_buffer.data() + m_used, text.data(), n);
+        m_used += n;
+        text.remove_prefix(n);
+    }
+}
+
+bool OutputWriter::flush() {
+    if (m_string) return true;
+    if (!m_file || m_failed) return false;
+    if (m_used > 0) {
+        const auto start = std::chrono::steady_clock::now();
+        if (std::fwrite(m_buffer.data(), 1, m_used, m_file) != m_used) m_failed = true;
+        m_ioTime += std::chrono::steady_clock::now() - start;
+    }
+    m_used = 0;
+    return !m_failed;
+}
+
+} // namespace onyx
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace onyx {
+
+// Buffered line writer. Output accumulates in a fixed-size buffer that is
+// flushed to the underlying file whenever it fills, so memory use stays
+// constant regardless of how much is written.
+class OutputWriter {
+public:
+    static constexpr std::size_t DefaultCapacity = 1 << 20;
+
+    explicit OutputWriter(std::size_t capacity = DefaultCapacity);
+    ~OutputWriter();
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    bool open(const std::filesystem::path& path);
+    // Takes ownership of an already open stream, such as a pipe.
+    bool open(std::FILE* stream);
+    // Appends to `target` instead of a file; nothing is buffered.
+    void open(std::string& target);
+    bool close();
+
+    void write(std::string_view text);
+    void writeLine(std::string_view line) {
+        write(line);
+        write("\n");
+    }
+    bool flush();
+
+    [[nodiscard]] bool good() const { return (m_file || m_string) && !m_failed; }
+    // Wall time spent handing data to the file, across all flushes.
+    [[nodiscard]] std::chrono::nanoseconds ioTime() const { return m_ioTime; }
+
+private:
+    std::FILE* m_file = nullptr;
+    std::string* m_string = nullptr;
+    std::vector<char> m_buffer;
+    std::size_t m_used = 0;
+    bool m_failed = false;
+    std::chrono::nanoseconds m_ioTime{0};
+};
+
+} // namespace onyx
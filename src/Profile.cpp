@@ -0,0 +1,130 @@
+#include "Profile.hpp"
+#include "Hash.hpp"
+#include "MappedFile.hpp"
+#include <algorithm>
+#include <charconv>
+
+namespace onyx {
+
+bool ProfileCounts::hot(std::size_t line) const {
+    const auto it = functions.find(line);
+    return it != functions.end() && it->second * 100 >= maxEntries;
+}
+
+bool ProfileCounts::cold(std::size_t line) const {
+    return !functions.empty() && !functions.count(line);
+}
+
+int ProfileCounts::expected(std::size_t line) const {
+    const auto it = branches.find(line);
+    if (it == branches.end()) return -1;
+    const auto [taken, notTaken] = it->second;
+    if (taken >= 9 * notTaken) return 1;
+    if (notTaken >= 9 * taken) return 0;
+    return -1;
+}
+
+// Sites are combined by addition so the result does not depend on map order.
+std::uint64_t ProfileCounts::hash() const {
+    std::uint64_t sum = 0;
+    for (const auto& [line, entries] : functions) sum += Hasher(1).update(static_cast<std::uint64_t>(line)).update(entries).digest();
+    for (const auto& [line, counts] : branches) {
+        sum += Hasher(2).update(static_cast<std::uint64_t>(line)).update(counts.first).update(counts.second).digest();
+    }
+    return sum;
+}
+
+namespace {
+
+// Space-separated unsigned number at `pos`, which moves past it.
+bool readNumber(std::string_view line, std::size_t& pos, std::uint64_t& value) {
+    while (pos < line.size() && line[pos] == ' ') ++pos;
+    const auto [end, ec] = std::from_chars(line.data() + pos, line.data() + line.size(), value);
+    if (ec != std::errc() || end == line.data() + pos) return false;
+    pos = static_cast<std::size_t>(end - line.data());
+    return true;
+}
+
+} // namespace
+
+bool Profile::load(const std::filesystem::path& path, std::string& error) {
+    MappedFile file;
+    if (!file.open(path)) {
+        error = "cannot read profile " + path.string();
+        return false;
+    }
+    const std::string_view text = file.view();
+    std::size_t number = 0;
+    for (std::size_t pos = 0; pos < text.size();) {
+        std::size_t end = text.find('\n', pos);
+        if (end == std::string_view::npos) end = text.size();
+        std::string_view line = text.substr(pos, end - pos);
+        pos = end + 1;
+        number++;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty()) continue;
+
+        const bool function = line.rfind("fn ", 0) == 0;
+        if (!function && line.rfind("br ", 0) != 0) {
+            error = path.string() + ":" + std::to_string(number) + ": unknown profile record";
+            return false;
+        }
+        std::size_t at = 2;
+        std::uint64_t first = 0, second = 0, site = 0;
+        if (!readNumber(line, at, first) || (!function && !readNumber(line, at, second)) || !readNumber(line, at, site) ||
+            at + 1 >= line.size() || line[at] != ' ') {
+            error = path.string() + ":" + std::to_string(number) + ": malformed profile record";
+            return false;
+        }
+        ProfileCounts& counts = m_files[std::string(line.substr(at + 1))];
+        if (function) {
+            std::uint64_t& entries = counts.functions[site];
+            entries += first;
+            counts.maxEntries = std::max(counts.maxEntries, entries);
+        } else {
+            auto& branch = counts.branches[site];
+            branch.first += first;
+            branch.second += second;
+        }
+    }
+    return true;
+}
+
+const ProfileCounts* Profile::find(std::string_view sourcePath) const {
+    const auto it = m_files.find(std::string(sourcePath));
+    return it == m_files.end() ? nullptr : &it->second;
+}
+
+void writeProfileRuntime(std::string& out, std::size_t lines, std::string_view sourcePath) {
+    const std::string size = std::to_string(lines + 1);
+    // The path goes into printf formats inside C string literals.
+    std::string path;
+    for (char c : sourcePath) {
+        if (c == '%') path += '%';
+        else if (c == '"' || c == '\\') path += '\\';
+        path += c;
+    }
+
+    out += "// profile counters (--instrument)\n";
+    out += "#include <stdio.h>\n";
+    out += "#include <stdlib.h>\n";
+    out += "static unsigned long long onyx_prof_fn[" + size + "];\n";
+    out += "static unsigned long long onyx_prof_br[" + size + "][2];\n";
+    out += "static inline int onyx_prof_branch(unsigned line, int taken) {\n";
+    out += "    onyx_prof_br[line][!taken]++;\n";
+    out += "    return taken;\n";
+    out += "}\n";
+    out += "__attribute__((destructor)) static void onyx_prof_dump(void) {\n";
+    out += "    const char* path = getenv(\"ONYX_PROFILE\");\n";
+    out += "    FILE* out = fopen(path && *path ? path : \"oxprof.data\", \"a\");\n";
+    out += "    if (!out) return;\n";
+    out += "    for (unsigned i = 0; i < " + size + "; i++) {\n";
+    out += "        if (onyx_prof_fn[i]) fprintf(out, \"fn %llu %u " + path + "\\n\", onyx_prof_fn[i], i);\n";
+    out += "        if (onyx_prof_br[i][0] || onyx_prof_br[i][1])\n";
+    out += "            fprintf(out, \"br %llu %llu %u " + path + "\\n\", onyx_prof_br[i][0], onyx_prof_br[i][1], i);\n";
+    out += "    }\n";
+    out += "    fclose(out);\n";
+    out += "}\n";
+}
+
+} // namespace onyx
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace onyx {
+
+// Counts one source file collected by an --instrument build, keyed by the
+// line of the function head or condition.
+struct ProfileCounts {
+    std::unordered_map<std::size_t, std::uint64_t> functions; // entries
+    std::unordered_map<std::size_t, std::pair<std::uint64_t, std::uint64_t>> branches; // taken, not taken
+    std::uint64_t maxEntries = 0;
+
+    // Entered at least 1% as often as the file's busiest function.
+    [[nodiscard]] bool hot(std::size_t line) const;
+    // Never entered, in a file that did run.
+    [[nodiscard]] bool cold(std::size_t line) const;
+    // 1 when the condition held at least 90% of the times it was tested, 0
+    // when it held at most 10%, -1 otherwise or when unknown.
+    [[nodiscard]] int expected(std::size_t line) const;
+    // Identifies the counts for cache keys.
+    [[nodiscard]] std::uint64_t hash() const;
+};
+
+// What instrumented programs append to their profile file, one record per
+// line, source path last:
+//
+//   fn <entries> <line> <path>
+//   br <taken> <not taken> <line> <path>
+//
+// Records for the same site, e.g. from several runs, add up.
+class Profile {
+public:
+    bool load(const std::filesystem::path& path, std::string& error);
+    // Counts for a source file as named on the instrumenting command line.
+    [[nodiscard]] const ProfileCounts* find(std::string_view sourcePath) const;
+
+private:
+    std::unordered_map<std::string, ProfileCounts> m_files;
+};
+
+// Counters for a file of `lines` source lines and the destructor that dumps
+// them to $ONYX_PROFILE, or oxprof.data when it is unset.
+void writeProfileRuntime(std::string& out, std::size_t lines, std::string_view sourcePath);
+
+} // namespace onyx
@@ -0,0 +1,155 @@
+#include "Region.hpp"
+#include "Lexer.hpp"
+
+namespace onyx {
+
+namespace {
+
+// Blocks double from one page up to 1 MiB; larger requests get a block of
+// their own size. Each allocation is one bounds check on the newest block.
+constexpr std::string_view REGION_RUNTIME = R"(// region allocator runtime
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#ifdef ONYX_REGION_DEBUG
+#include <stdio.h>
+#endif
+typedef struct onyx_region_block {
+    struct onyx_region_block* next;
+    size_t size;
+    size_t used;
+    unsigned char data[];
+} onyx_region_block;
+typedef struct onyx_region {
+    const char* name;
+    onyx_region_block* head;
+    size_t used;
+    size_t peak;
+    size_t allocations;
+    size_t blocks;
+} onyx_region;
+typedef struct onyx_pool {
+    const char* name;
+    size_t size;
+    size_t align;
+    void* free;
+    size_t live;
+    size_t peak;
+    onyx_region slabs;
+} onyx_pool;
+static void* onyx_region_grow(onyx_region* r, size_t size, size_t align);
+static inline void* onyx_region_alloc(onyx_region* r, size_t size, size_t align) {
+    onyx_region_block* b = r->head;
+    if (b) {
+        const uintptr_t base = (uintptr_t)b->data;
+        const size_t at = (size_t)(((base + b->used + align - 1) & ~(uintptr_t)(align - 1)) - base);
+        if (at <= b->size && size <= b->size - at) {
+            r->used += at + size - b->used;
+            if (r->used > r->peak) r->peak = r->used;
+            r->allocations++;
+            b->used = at + size;
+            return b->data + at;
+        }
+    }
+    return onyx_region_grow(r, size, align);
+}
+__attribute__((cold, noinline, unused)) static void* onyx_region_grow(onyx_region* r, size_t size, size_t align) {
+    size_t cap = r->head ? r->head->size * 2 : 4096 - sizeof(onyx_region_block);
+    if (cap > ((size_t)1 << 20)) cap = (size_t)1 << 20;
+    if (size > SIZE_MAX - sizeof(onyx_region_block) - align) return NULL;
+    if (cap < size + align) cap = size + align;
+    onyx_region_block* b = (onyx_region_block*)malloc(sizeof(onyx_region_block) + cap);
+    if (!b) return NULL;
+    b->next = r->head;
+    b->size = cap;
+    b->used = 0;
+    r->head = b;
+    r->blocks++;
+    return onyx_region_alloc(r, size, align);
+}
+static inline void* onyx_region_alloc_array(onyx_region* r, size_t n, size_t size, size_t align) {
+    if (size && n > SIZE_MAX / size) return NULL;
+    return onyx_region_alloc(r, n * size, align);
+}
+static inline void onyx_region_reset(onyx_region* r) {
+    onyx_region_block* keep = r->head;
+    if (keep) {
+        for (onyx_region_block* b = keep->next; b;) {
+            onyx_region_block* next = b->next;
+            free(b);
+            b = next;
+        }
+        keep->next = NULL;
+        keep->used = 0;
+    }
+    r->used = 0;
+}
+static inline void onyx_region_release(onyx_region* r) {
+#ifdef ONYX_REGION_DEBUG
+    if (r->name) {
+        fprintf(stderr, "region %s: high-water %zu bytes, %zu allocations, %zu blocks\n", r->name, r->peak,
+                r->allocations, r->blocks);
+    }
+#endif
+    for (onyx_region_block* b = r->head; b;) {
+        onyx_region_block* next = b->next;
+        free(b);
+        b = next;
+    }
+    r->head = NULL;
+    r->used = 0;
+}
+static inline onyx_pool onyx_pool_make(const char* name, size_t size, size_t align) {
+    onyx_pool p = {0};
+    p.name = name;
+    p.size = size < sizeof(void*) ? sizeof(void*) : size;
+    p.align = align < __alignof__(void*) ? __alignof__(void*) : align;
+    return p;
+}
+static inline void* onyx_pool_alloc(onyx_pool* p, size_t size) {
+#ifdef ONYX_REGION_DEBUG
+    if (size > p->size) {
+        fprintf(stderr, "pool %s: %zu-byte object in a pool of %zu-byte objects\n", p->name, size, p->size);
+        abort();
+    }
+#else
+    (void)size;
+#endif
+    void* obj = p->free;
+    if (obj) __builtin_memcpy(&p->free, obj, sizeof p->free);
+    else obj = onyx_region_alloc(&p->slabs, p->size, p->align);
+    if (obj && ++p->live > p->peak) p->peak = p->live;
+    return obj;
+}
+static inline void onyx_pool_free(onyx_pool* p, void* obj) {
+    if (!obj) return;
+    __builtin_memcpy(obj, &p->free, sizeof p->free);
+    p->free = obj;
+    p->live--;
+}
+static inline void onyx_pool_release(onyx_pool* p) {
+#ifdef ONYX_REGION_DEBUG
+    fprintf(stderr, "pool %s: high-water %zu objects of %zu bytes, %zu live at release\n", p->name, p->peak, p->size,
+            p->live);
+#endif
+    onyx_region_release(&p->slabs);
+    p->free = NULL;
+    p->live = 0;
+}
+)";
+
+} // namespace
+
+bool mentionsRegions(std::string_view line) {
+    const Keyword head = Lexer(line).peek().keyword();
+    if (head == Keyword::Region || head == Keyword::Pool) return true;
+    if (line.find("alloc") == std::string_view::npos && line.find("onyx_") == std::string_view::npos) return false;
+    return line.find("alloc<") != std::string_view::npos || line.find("alloc_array<") != std::string_view::npos ||
+           line.find("onyx_region") != std::string_view::npos || line.find("onyx_pool") != std::string_view::npos;
+}
+
+void writeRegionRuntime(std::string& out) {
+    out += REGION_RUNTIME;
+}
+
+} // namespace onyx
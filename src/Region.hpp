@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace onyx {
+
+// True when `line` needs the region runtime: a `region`/`pool` block, an
+// alloc<T>/alloc_array<T> call or a spelled onyx_region/onyx_pool type.
+bool mentionsRegions(std::string_view line);
+
+// The bump-pointer region and fixed-size pool allocators as static C:
+//
+//   onyx_region_alloc(r, size, align), onyx_region_alloc_array(r, n, size, align)
+//   onyx_region_reset(r)     keeps the newest block for reuse
+//   onyx_region_release(r)   frees every block; the cleanup of a region block
+//   onyx_pool_make(name, size, align), onyx_pool_alloc(p, size), onyx_pool_free(p, obj)
+//   onyx_pool_release(p)     the cleanup of a pool block
+//
+// Built with -DONYX_REGION_DEBUG, releases report high-water marks on stderr.
+void writeRegionRuntime(std::string& out);
+
+} // namespace onyx
@@ -0,0 +1,263 @@
+#include "Rewriter.hpp"
+#include "Simd.hpp"
+
+namespace onyx {
+
+namespace {
+
+bool adjacent(const Token& a, const Token& b) {
+    return a.end() == b.offset;
+}
+
+// Builds pre_n ... pre_1 core post_1 ... post_n.
+void assemble(const std::string& core, const std::vector<std::pair<std::string, std::string>>& wraps,
+              std::string& out) {
+    for (auto it = wraps.rbegin(); it != wraps.rend(); ++it) out += it->first;
+    out += core;
+    for (const auto& wrap : wraps) out += wrap.second;
+}
+
+} // namespace
+
+std::string_view CallRewriter::rewrite(std::string_view text) {
+    m_text = text;
+    m_tokens.clear();
+    Lexer lex(text);
+    for (Token tok = lex.next(); tok.kind != TokenKind::End; tok = lex.next()) m_tokens.push_back(tok);
+
+    // Match parentheses once; unmatched ones are ordinary punctuation.
+    m_match.assign(m_tokens.size(), NoMatch);
+    std::vector<std::size_t> open;
+    for (std::size_t i = 0; i < m_tokens.size(); ++i) {
+        if (m_tokens[i].is('(')) {
+            open.push_back(i);
+        } else if (m_tokens[i].is(')') && !open.empty()) {
+            m_match[open.back()] = i;
+            open.pop_back();
+        }
+    }
+
+    m_stats.rewriteLines++;
+    m_stats.rewriteTokens += m_tokens.size();
+    m_out.clear();
+    rewriteList(0, m_tokens.size(), 0, text.size(), m_out);
+    return m_out;
+}
+
+// Comma-separated expressions; everything between them is copied verbatim.
+void CallRewriter::rewriteList(std::size_t first, std::size_t last, std::size_t from, std::size_t to,
+                               std::string& out) {
+    std::size_t cursor = from;
+    std::size_t piece = first;
+    for (std::size_t i = first; i <= last;) {
+        if (i == last || m_tokens[i].is(',')) {
+            if (i > piece) {
+                out.append(m_text, cursor, m_tokens[piece].offset - cursor);
+                rewritePiece(piece, i, out);
+                cursor = m_tokens[i - 1].end();
+            }
+            if (i == last) break;
+            piece = ++i;
+            continue;
+        }
+        i = m_tokens[i].is('(') ? skipGroup(i) : i + 1;
+    }
+    out.append(m_text, cursor, to - cursor);
+}
+
+// One expression: an optional assignment or keyword prefix, then a pipe chain.
+void CallRewriter::rewritePiece(std::size_t first, std::size_t last, std::string& out) {
+    std::size_t expr = first;
+    bool pipes = false;
+    for (std::size_t i = first; i < last; i = m_tokens[i].is('(') ? skipGroup(i) : i + 1) {
+        if (isAssignment(i, first, last)) {
+            expr = i + 1;
+            pipes = false;
+        } else if (m_tokens[i].is("|>")) {
+            pipes = true;
+        }
+    }
+    if (!pipes) {
+        rewriteSpan(first, last, out);
+        return;
+    }
+
+    const std::string_view lead = m_tokens[first].text;
+    if (expr == first && first + 1 < last && m_tokens[first].isWord() &&
+        (lead == "return" || lead == "if" || lead == "while")) {
+        expr = first + 1;
+    }
+    if (expr > first) {
+        rewriteSpan(first, expr, out);
+        out.append(m_text, m_tokens[expr - 1].end(), m_tokens[expr].offset - m_tokens[expr - 1].end());
+    }
+
+    std::vector<Range> segments;
+    std::size_t begin = expr;
+    for (std::size_t i = expr; i < last; i = m_tokens[i].is('(') ? skipGroup(i) : i + 1) {
+        if (m_tokens[i].is("|>")) {
+            segments.emplace_back(begin, i);
+            begin = i + 1;
+        }
+    }
+    segments.emplace_back(begin, last);
+    rewriteChain(segments, out);
+}
+
+// Tokens copied with their spacing, expanding method calls and recursing into
+// parenthesised argument lists.
+void CallRewriter::rewriteSpan(std::size_t first, std::size_t last, std::string& out) {
+    for (std::size_t i = first; i < last;) {
+        if (i > first) out.append(m_text, m_tokens[i - 1].end(), m_tokens[i].offset - m_tokens[i - 1].end());
+        const Token& tok = m_tokens[i];
+
+        if (isMethodCall(i, last)) {
+            const std::size_t open = i + 3;
+            const std::size_t close = m_match[open];
+            m_stats.symbolLookups++;
+            if (const std::string_view type = m_symbols.lookup(tok.text); !type.empty()) {
+                // Vectors are values: their helpers take them as such.
+                out.append(type).append("_").append(m_tokens[i + 2].text).append(findVectorType(type) ? "(" : "(&");
+                out.append(tok.text);
+                if (m_tokens[close].offset > m_tokens[open].end()) {
+                    out += ", ";
+                    rewriteList(open + 1, close, m_tokens[open].end(), m_tokens[close].offset, out);
+                }
+                out += ')';
+                m_stats.methodCallIterations++;
+                i = close + 1;
+                continue;
+            }
+            out.append(tok.text).append(".").append(m_tokens[i + 2].text);
+            i = open;
+            continue;
+        }
+        if (tok.is('(') && m_match[i] != NoMatch) {
+            out += '(';
+            rewriteList(i + 1, m_match[i], tok.end(), m_tokens[m_match[i]].offset, out);
+            out += ')';
+            i = m_match[i] + 1;
+            continue;
+        }
+        out += tok.text;
+        ++i;
+    }
+}
+
+void CallRewriter::rewriteChain(const std::vector<Range>& segments, std::string& out) {
+    std::string core;
+    std::vector<std::pair<std::string, std::string>> wraps;
+    rewriteSpan(segments[0].first, segments[0].second, core);
+
+    for (std::size_t s = 1; s < segments.size(); ++s) {
+        const auto [b, e] = segments[s];
+        const std::size_t pipe = b - 1;
+        const bool valid = (!core.empty() || !wraps.empty()) && b + 1 < e && m_tokens[b].isWord() &&
+                           m_tokens[b + 1].is('(') && adjacent(m_tokens[b], m_tokens[b + 1]) &&
+                           m_match[b + 1] != NoMatch;
+
+        if (!valid) {
+            // Not a call stage: the operator stays and joins the piped value.
+            std::string joined;
+            assemble(core, wraps, joined);
+            wraps.clear();
+            if (pipe > segments[0].first) {
+                joined.append(m_text, m_tokens[pipe - 1].end(), m_tokens[pipe].offset - m_tokens[pipe - 1].end());
+            }
+            joined += "|>";
+            if (b < e) {
+                joined.append(m_text, m_tokens[pipe].end(), m_tokens[b].offset - m_tokens[pipe].end());
+                rewriteSpan(b, e, joined);
+            }
+            core = std::move(joined);
+            continue;
+        }
+
+        const std::string_view func = m_tokens[b].text;
+        const std::size_t open = b + 1;
+        const std::size_t close = m_match[open];
+        std::string args;
+        rewriteList(open + 1, close, m_tokens[open].end(), m_tokens[close].offset, args);
+        std::string trailing;
+        if (close + 1 < e) {
+            trailing.append(m_text, m_tokens[close].end(), m_tokens[close + 1].offset - m_tokens[close].end());
+            rewriteSpan(close + 1, e, trailing);
+        }
+
+        std::vector<std::size_t> placeholders;
+        Lexer lex(args);
+        for (Token tok = lex.next(); tok.kind != TokenKind::End; tok = lex.next()) {
+            if (tok.isWord() && tok.text == "_") placeholders.push_back(tok.offset);
+        }
+
+        // Resolve-style functions (Type_fn) of a typed variable take its address.
+        if (wraps.empty()) {
+            m_stats.symbolLookups++;
+            const std::string_view type = m_symbols.lookup(core);
+            if (!type.empty() && !findVectorType(type) && func.size() > type.size() &&
+                func.compare(0, type.size(), type) == 0 && func[type.size()] == '_') {
+                core.insert(0, "&");
+            }
+        }
+        m_stats.pipeIterations++;
+
+        if (placeholders.size() <= 1) {
+            std::string pre(func);
+            pre += '(';
+            std::string post;
+            if (placeholders.empty()) {
+                if (m_tokens[close].offset > m_tokens[open].end()) post.append(", ").append(args);
+            } else {
+                pre.append(args, 0, placeholders[0]);
+                post.append(args, placeholders[0] + 1);
+            }
+            post += ')';
+            post += trailing;
+            wraps.emplace_back(std::move(pre), std::move(post));
+        } else {
+            std::string value;
+            assemble(core, wraps, value);
+            wraps.clear();
+            core.assign(func).append("(");
+            std::size_t at = 0;
+            for (std::size_t p : placeholders) {
+                core.append(args, at, p - at).append(value);
+                at = p + 1;
+            }
+            core.append(args, at).append(")").append(trailing);
+        }
+    }
+    assemble(core, wraps, out);
+}
+
+// recv.method( with recv a free-standing identifier: not itself a member of
+// something else (a.b.c(), p->q.r()) and not glued to a literal.
+bool CallRewriter::isMethodCall(std::size_t i, std::size_t last) const {
+    if (i + 3 >= last) return false;
+    const Token& recv = m_tokens[i];
+    if (!recv.isWord() || !m_tokens[i + 1].is('.') || !m_tokens[i + 2].isWord() || !m_tokens[i + 3].is('(')) {
+        return false;
+    }
+    if (!adjacent(recv, m_tokens[i + 1]) || !adjacent(m_tokens[i + 1], m_tokens[i + 2]) ||
+        !adjacent(m_tokens[i + 2], m_tokens[i + 3]) || m_match[i + 3] == NoMatch) {
+        return false;
+    }
+    if (recv.offset > 0) {
+        const char before = m_text[recv.offset - 1];
+        if (before == '.' || before == '>' || before == '"') return false;
+    }
+    return true;
+}
+
+// A lone `=` or a compound assignment (`+=`, `|=`, ...); not `==`, `!=`, `<=`, `>=`.
+bool CallRewriter::isAssignment(std::size_t i, std::size_t first, std::size_t last) const {
+    if (!m_tokens[i].is('=')) return false;
+    if (i + 1 < last && m_tokens[i + 1].is('=') && adjacent(m_tokens[i], m_tokens[i + 1])) return false;
+    if (i > first && adjacent(m_tokens[i - 1], m_tokens[i])) {
+        const Token& prev = m_tokens[i - 1];
+        if (prev.is('=') || prev.is('!') || prev.is('<') || prev.is('>')) return false;
+    }
+    return true;
+}
+
+} // namespace onyx
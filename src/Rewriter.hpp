@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Lexer.hpp"
+#include "Stats.hpp"
+#include "SymbolTable.hpp"
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace onyx {
+
+// Expands call sugar in one line of expression text:
+//
+//   recv.method(args)  ->  Type_method(&recv, args)   when recv has a known type
+//                          Type_method(recv, args)    ...that is a SIMD vector
+//   lhs |> f(args)     ->  f(lhs, args), or f(args) with each `_` replaced by lhs
+//
+// The line is tokenized once and parentheses are matched up front, so nested
+// calls, string literals and pipes inside arguments are handled structurally.
+// A pipe's lhs starts after any top-level assignment or leading
+// return/if/while, and extends back to the start of its argument or line.
+// Chains are assembled from per-stage prefixes and suffixes, keeping the cost
+// linear in the line length; only stages with several placeholders copy
+// their input.
+class CallRewriter {
+public:
+    CallRewriter(const SymbolTable& symbols, TranspileStats& stats) : m_symbols(symbols), m_stats(stats) {}
+
+    // The rewritten text. The view stays valid until the next call.
+    std::string_view rewrite(std::string_view text);
+
+private:
+    using Range = std::pair<std::size_t, std::size_t>; // token indices [first, last)
+
+    void rewriteList(std::size_t first, std::size_t last, std::size_t from, std::size_t to, std::string& out);
+    void rewritePiece(std::size_t first, std::size_t last, std::string& out);
+    void rewriteSpan(std::size_t first, std::size_t last, std::string& out);
+    void rewriteChain(const std::vector<Range>& segments, std::string& out);
+    bool isMethodCall(std::size_t i, std::size_t last) const;
+    bool isAssignment(std::size_t i, std::size_t first, std::size_t last) const;
+    // Index past the token closing the group opened at `i`, or i + 1.
+    [[nodiscard]] std::size_t skipGroup(std::size_t i) const {
+        return m_match[i] != NoMatch ? m_match[i] + 1 : i + 1;
+    }
+
+    static constexpr std::size_t NoMatch = static_cast<std::size_t>(-1);
+
+    const SymbolTable& m_symbols;
+    TranspileStats& m_stats;
+    std::string_view m_text;
+    std::vector<Token> m_tokens;
+    std::vector<std::size_t> m_match; // index of the matching paren, or NoMatch
+    std::string m_out;
+};
+
+} // namespace onyx
@@ -0,0 +1,263 @@
+#include "Server.hpp"
+#include <condition_variable>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define ONYX_HAVE_UNIX_SOCKETS 1
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+namespace onyx {
+
+namespace {
+
+struct Request {
+    std::string command;
+    std::size_t length = 0;
+    std::string argument; // rest of the header line
+};
+
+bool readRequest(std::istream& in, Request& request) {
+    std::string header;
+    if (!std::getline(in, header)) return false;
+    if (!header.empty() && header.back() == '\r') header.pop_back();
+    std::istringstream fields(header);
+    if (!(fields >> request.command >> request.length)) return false;
+    std::getline(fields >> std::ws, request.argument);
+    return true;
+}
+
+void reply(std::ostream& out, bool ok, std::string_view payload) {
+    out << (ok ? "ok " : "error ") << payload.size() << '\n';
+    out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+    out.flush();
+}
+
+std::string joinLines(const std::vector<std::string>& lines) {
+    std::string text;
+    for (const auto& line : lines) text.append(line).push_back('\n');
+    return text;
+}
+
+#ifdef ONYX_HAVE_UNIX_SOCKETS
+// Stream buffer over a connected socket; owns and closes the descriptor.
+class SocketBuffer : public std::streambuf {
+public:
+    explicit SocketBuffer(int fd) : m_fd(fd) {
+        setg(m_in, m_in, m_in);
+        setp(m_out, m_out + sizeof(m_out));
+    }
+    ~SocketBuffer() override {
+        sync();
+        ::close(m_fd);
+    }
+
+protected:
+    int_type underflow() override {
+        ssize_t n;
+        do n = ::read(m_fd, m_in, sizeof(m_in));
+        while (n < 0 && errno == EINTR);
+        if (n <= 0) return traits_type::eof();
+        setg(m_in, m_in, m_in + n);
+        return traits_type::to_int_type(*gptr());
+    }
+    int_type overflow(int_type c) override {
+        if (!drain()) return traits_type::eof();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+    int sync() override { return drain() ? 0 : -1; }
+
+private:
+    bool drain() {
+        for (const char* p = pbase(); p < pptr();) {
+            const ssize_t n = ::send(m_fd, p, static_cast<std::size_t>(pptr() - p), MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+        }
+        setp(m_out, m_out + sizeof(m_out));
+        return true;
+    }
+
+    int m_fd;
+    char m_in[64 * 1024];
+    char m_out[64 * 1024];
+};
+#endif
+
+} // namespace
+
+Server::Server(TranspilerConfig config, ThreadPool* pool, std::size_t memoBytes)
+    : m_config(std::move(config)), m_pool(pool), m_memoLimit(memoBytes) {}
+
+bool Server::serve(std::istream& in, std::ostream& out) {
+    // One transpiler per session keeps its buffers warm between requests.
+    Transpiler transpiler(m_config, m_pool);
+    TranspileStats last;
+    bool lastOk = true;
+    std::string payload;
+    std::string output;
+
+    for (Request request; readRequest(in, request);) {
+        payload.resize(request.length);
+        if (!in.read(payload.data(), static_cast<std::streamsize>(payload.size()))) {
+            reply(out, false, "truncated request\n");
+            return false;
+        }
+
+        if (request.command == "transpile") {
+            const std::string name = request.argument.empty() ? "input.ox" : request.argument;
+            // Imported modules can change under an unchanged source, so
+            // only self-contained sources are memoized.
+            const bool memoize = payload.find("@import") == std::string::npos;
+            const std::string key = memoize ? transpiler.cacheKey(name, payload) : std::string();
+            output.clear();
+            if (memoize && recall(key, output)) {
+                last = {};
+                last.cached = true;
+                lastOk = true;
+                reply(out, true, output);
+                continue;
+            }
+            lastOk = transpiler.transpile(payload, output, name);
+            last = transpiler.stats();
+            if (lastOk && memoize) remember(key, output);
+            reply(out, lastOk, lastOk ? output : joinLines(transpiler.diagnostics()));
+        } else if (request.command == "file") {
+            const std::size_t split = payload.find('\n');
+            if (split == std::string::npos) {
+                reply(out, false, "expected \"<input>\\n<output>\"\n");
+                continue;
+            }
+            const std::filesystem::path input = payload.substr(0, split);
+            lastOk = transpiler.processFile(input, payload.substr(split + 1));
+            last = transpiler.stats();
+            std::string diagnostics = joinLines(transpiler.diagnostics());
+            if (!lastOk) diagnostics += "failed to transpile - " + input.string() + "\n";
+            reply(out, lastOk, diagnostics);
+        } else if (request.command == "stats") {
+            std::ostringstream json;
+            writeStatsJson(json, "", lastOk, last);
+            reply(out, true, json.str());
+        } else if (request.command == "reset") {
+            transpiler.reset();
+            forget();
+            last = {};
+            lastOk = true;
+            reply(out, true, "");
+        } else if (request.command == "quit") {
+            reply(out, true, "");
+            return true;
+        } else {
+            reply(out, false, "unknown request - " + request.command + "\n");
+        }
+    }
+    // End of stream is a normal way to finish; a header we could not parse is not.
+    if (in.eof()) return true;
+    reply(out, false, "malformed request\n");
+    return false;
+}
+
+bool Server::listen(const std::filesystem::path& socketPath, std::string& error) {
+#ifdef ONYX_HAVE_UNIX_SOCKETS
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    const std::string path = socketPath.string();
+    if (path.size() >= sizeof(address.sun_path)) {
+        error = "socket path too long - " + path;
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        error = std::string("failed to create socket - ") + std::strerror(errno);
+        return false;
+    }
+    ::unlink(path.c_str()); // a socket left behind by an earlier server
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listener, SOMAXCONN) != 0) {
+        error = "failed to listen on " + path + " - " + std::strerror(errno);
+        ::close(listener);
+        return false;
+    }
+
+    std::mutex mutex;
+    std::condition_variable idle;
+    std::size_t active = 0;
+    for (;;) {
+        const int client = ::accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        {
+            std::lock_guard lock(mutex);
+            active++;
+        }
+        std::thread([this, client, &mutex, &idle, &active] {
+            {
+                SocketBuffer buffer(client);
+                std::istream in(&buffer);
+                std::ostream out(&buffer);
+                serve(in, out);
+            }
+            std::lock_guard lock(mutex);
+            if (--active == 0) idle.notify_all();
+        }).detach();
+    }
+
+    error = std::string("failed to accept - ") + std::strerror(errno);
+    ::close(listener);
+    ::unlink(path.c_str());
+    std::unique_lock lock(mutex);
+    idle.wait(lock, [&active] { return active == 0; });
+    return false;
+#else
+    (void)socketPath;
+    error = "unix sockets are not supported on this platform";
+    return false;
+#endif
+}
+
+bool Server::recall(const std::string& key, std::string& output) {
+    std::lock_guard lock(m_memoMutex);
+    const auto it = m_memo.find(key);
+    if (it == m_memo.end()) return false;
+    output = it->second;
+    return true;
+}
+
+void Server::remember(const std::string& key, const std::string& output) {
+    const std::size_t size = key.size() + output.size();
+    if (size > m_memoLimit) return;
+    std::lock_guard lock(m_memoMutex);
+    if (m_memoBytes + size > m_memoLimit) {
+        m_memo.clear();
+        m_memoBytes = 0;
+    }
+    if (m_memo.emplace(key, output).second) m_memoBytes += size;
+}
+
+void Server::forget() {
+    std::lock_guard lock(m_memoMutex);
+    m_memo.clear();
+    m_memoBytes = 0;
+}
+
+} // namespace onyx
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "Transpiler.hpp"
+
+namespace onyx {
+
+class ThreadPool;
+
+// Long-lived transpile service for build systems and editors, so a warm
+// process handles many requests instead of one oxc process per file.
+//
+// Every request is a header line followed by a payload of exactly <n> bytes:
+//
+//   transpile <n> [name]   payload is Onyx source; replies with the C text
+//   file <n>               payload is "<input>\n<output>"; runs processFile
+//   stats <n>              replies with the JSON stats of the last request
+//   reset <n>              drops warm state and memoized outputs
+//   quit <n>               ends the session
+//
+// Every reply is "ok <n>\n" or "error <n>\n" followed by <n> bytes: the C
+// text, diagnostics (one per line) or nothing.
+class Server {
+public:
+    static constexpr std::size_t DefaultMemoBytes = 64u << 20;
+
+    explicit Server(TranspilerConfig config, ThreadPool* pool = nullptr, std::size_t memoBytes = DefaultMemoBytes);
+
+    // Handles one client until it sends `quit` or the stream ends. Returns
+    // false if the session ended on a malformed request.
+    bool serve(std::istream& in, std::ostream& out);
+
+    // Accepts clients on a Unix socket, one thread per connection. Only
+    // returns once the socket fails, with the reason in `error`.
+    bool listen(const std::filesystem::path& socketPath, std::string& error);
+
+private:
+    TranspilerConfig m_config;
+    ThreadPool* m_pool = nullptr;
+
+    // Outputs of earlier `transpile` requests by cache key, shared by all
+    // sessions. Dropped wholesale when it outgrows m_memoLimit.
+    std::mutex m_memoMutex;
+    std::unordered_map<std::string, std::string> m_memo;
+    std::size_t m_memoBytes = 0;
+    std::size_t m_memoLimit;
+
+    bool recall(const std::string& key, std::string& output);
+    void remember(const std::string& key, const std::string& output);
+    void forget();
+};
+
+} // namespace onyx
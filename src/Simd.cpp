@@ -0,0 +1,98 @@
+#include "Simd.hpp"
+#include "Lexer.hpp"
+
+namespace onyx {
+
+namespace {
+
+constexpr VectorType VECTOR_TYPES[] = {
+    {"f32x4", "float", "float", "i32x4", 4, 16},
+    {"f32x8", "float", "float", "i32x8", 8, 32},
+    {"f64x2", "double", "double", "i64x2", 2, 16},
+    {"f64x4", "double", "double", "i64x4", 4, 32},
+    {"i32x4", "int", "int", "i32x4", 4, 16},
+    {"i32x8", "int", "int", "i32x8", 8, 32},
+    {"u32x4", "unsigned int", "unsigned int", "i32x4", 4, 16},
+    {"u32x8", "unsigned int", "unsigned int", "i32x8", 8, 32},
+    {"i64x2", "long long", "long long", "i64x2", 2, 16},
+    {"i64x4", "long long", "long long", "i64x4", 4, 32},
+    {"u8x16", "unsigned char", "unsigned int", "u8x16", 16, 16},
+    {"u8x32", "unsigned char", "unsigned int", "u8x32", 32, 32},
+};
+
+VectorSet bit(const VectorType* type) {
+    return VectorSet{1} << (type - VECTOR_TYPES);
+}
+
+} // namespace
+
+const VectorType* findVectorType(std::string_view name) {
+    if (name.size() != 5) return nullptr;
+    for (const VectorType& type : VECTOR_TYPES) {
+        if (type.name == name) return &type;
+    }
+    return nullptr;
+}
+
+VectorSet vectorTypesIn(std::string_view text) {
+    VectorSet used = 0;
+    for (std::size_t x = text.find('x', 1); x != std::string_view::npos; x = text.find('x', x + 1)) {
+        if (text[x - 1] < '0' || text[x - 1] > '9') continue;
+        std::size_t b = x;
+        while (b > 0 && isWordChar(text[b - 1])) --b;
+        std::size_t e = x + 1;
+        while (e < text.size() && isWordChar(text[e])) ++e;
+        if (const VectorType* type = findVectorType(text.substr(b, e - b))) used |= bit(type);
+        x = e - 1;
+    }
+    return used;
+}
+
+void writeVectorPrelude(std::string& out, VectorSet used) {
+    for (const VectorType& type : VECTOR_TYPES) {
+        if (used & bit(&type)) used |= bit(findVectorType(type.mask));
+    }
+    out += "// SIMD vector types\n";
+    for (const VectorType& type : VECTOR_TYPES) {
+        if (!(used & bit(&type))) continue;
+        out.append("typedef ").append(type.element).append(" ").append(type.name);
+        out.append(" __attribute__((vector_size(")
+            .append(std::to_string(type.size))
+            .append(")));\n");
+    }
+
+    for (const VectorType& type : VECTOR_TYPES) {
+        if (!(used & bit(&type))) continue;
+        const std::string t(type.name), e(type.element), n = std::to_string(type.lanes);
+        const std::string loop = "    for (int i = 0; i < " + n + "; i++) ";
+        out += "static inline " + t + " " + t + "_load(const " + e + "* p) {\n";
+        out += "    " + t + " v;\n";
+        out += "    __builtin_memcpy(&v, p, sizeof v);\n";
+        out += "    return v;\n";
+        out += "}\n";
+        out += "static inline void " + t + "_store(" + t + " v, " + e + "* p) {\n";
+        out += "    __builtin_memcpy(p, &v, sizeof v);\n";
+        out += "}\n";
+        out += "static inline " + t + " " + t + "_splat(" + e + " x) {\n";
+        out += "    " + t + " v = {0};\n";
+        out += loop + "v[i] = x;\n";
+        out += "    return v;\n";
+        out += "}\n";
+        out.append("static inline ").append(type.sum).append(" " + t + "_sum(" + t + " v) {\n");
+        out.append("    ").append(type.sum).append(" s = 0;\n");
+        out += loop + "s += v[i];\n";
+        out += "    return s;\n";
+        out += "}\n";
+        out.append("static inline " + t + " " + t + "_shuffle(" + t + " v, ").append(type.mask).append(" mask) {\n");
+        out += "#if defined(__clang__)\n";
+        out += "    " + t + " r = {0};\n";
+        out += loop + "r[i] = v[mask[i] & " + std::to_string(type.lanes - 1) + "];\n";
+        out += "    return r;\n";
+        out += "#else\n";
+        out += "    return __builtin_shuffle(v, mask);\n";
+        out += "#endif\n";
+        out += "}\n";
+    }
+}
+
+} // namespace onyx
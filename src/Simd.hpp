@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace onyx {
+
+// A SIMD vector type, lowered to a GCC/Clang vector_size typedef under its
+// own name. Element-wise operators and lane indexing (v[i]) are the
+// compilers' own; the helpers in the prelude cover the rest.
+struct VectorType {
+    std::string_view name;    // f32x4
+    std::string_view element; // C element type
+    std::string_view sum;     // C type of the horizontal sum
+    std::string_view mask;    // integer vector of the same shape, for shuffles
+    unsigned lanes = 0;
+    unsigned size = 0;        // bytes; also the alignment
+};
+
+// The vector type spelled `name`, or null.
+const VectorType* findVectorType(std::string_view name);
+
+// Bit i set: the i-th vector type is named somewhere in `text`.
+using VectorSet = std::uint32_t;
+VectorSet vectorTypesIn(std::string_view text);
+
+// Typedefs for the types in `used` (and their shuffle masks), followed by
+// their static inline helpers: <T>_load, _store, _splat, _sum, _shuffle.
+void writeVectorPrelude(std::string& out, VectorSet used);
+
+} // namespace onyx
@@ -0,0 +1,104 @@
+#include "Stats.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+namespace onyx {
+
+namespace {
+
+double seconds(std::chrono::nanoseconds ns) {
+    return std::chrono::duration<double>(ns).count();
+}
+
+} // namespace
+
+std::string jsonString(std::string_view s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            out += buffer;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+void TranspileStats::merge(const TranspileStats& other) {
+    rewriteLines += other.rewriteLines;
+    rewriteTokens += other.rewriteTokens;
+    methodCallIterations += other.methodCallIterations;
+    pipeIterations += other.pipeIterations;
+    symbolLookups += other.symbolLookups;
+    peakScopeDepth = std::max(peakScopeDepth, other.peakScopeDepth);
+    bytesAllocated += other.bytesAllocated;
+    modulesLoaded += other.modulesLoaded;
+    modulesBuilt += other.modulesBuilt;
+    chunks += other.chunks;
+}
+
+void writeStatsText(std::ostream& out, std::string_view input, const TranspileStats& stats) {
+    char buffer[128];
+    auto row = [&](const char* label, double value, const char* format) {
+        std::snprintf(buffer, sizeof(buffer), format, label, value);
+        out << buffer;
+    };
+
+    out << "stats - " << input << (stats.cached ? " (cached)" : "") << "\n";
+    const double total = seconds(stats.timings.total());
+    auto pass = [&](const char* label, std::chrono::nanoseconds ns) {
+        const double s = seconds(ns);
+        std::snprintf(buffer, sizeof(buffer), "  %-22s %10.6f s %6.1f%%\n", label, s, total > 0 ? 100.0 * s / total : 0.0);
+        out << buffer;
+    };
+    pass("load", stats.timings.load);
+    pass("discovery", stats.timings.discovery);
+    pass("transpilation", stats.timings.transpilation);
+    pass("write", stats.timings.write);
+    row("total", total, "  %-22s %10.6f s\n");
+
+    row("rewritten lines", static_cast<double>(stats.rewriteLines), "  %-22s %10.0f\n");
+    row("rewritten tokens", static_cast<double>(stats.rewriteTokens), "  %-22s %10.0f\n");
+    row("method call rewrites", static_cast<double>(stats.methodCallIterations), "  %-22s %10.0f\n");
+    row("pipe rewrites", static_cast<double>(stats.pipeIterations), "  %-22s %10.0f\n");
+    row("symbol lookups", static_cast<double>(stats.symbolLookups), "  %-22s %10.0f\n");
+    row("peak scope depth", static_cast<double>(stats.peakScopeDepth), "  %-22s %10.0f\n");
+    row("bytes allocated", static_cast<double>(stats.bytesAllocated), "  %-22s %10.0f\n");
+    row("modules loaded", static_cast<double>(stats.modulesLoaded), "  %-22s %10.0f\n");
+    row("modules built", static_cast<double>(stats.modulesBuilt), "  %-22s %10.0f\n");
+    row("parallel chunks", static_cast<double>(stats.chunks), "  %-22s %10.0f\n");
+}
+
+void writeStatsJson(std::ostream& out, std::string_view input, bool ok, const TranspileStats& stats) {
+    char buffer[64];
+    auto secondsField = [&](std::chrono::nanoseconds ns) {
+        std::snprintf(buffer, sizeof(buffer), "%.9f", seconds(ns));
+        return std::string(buffer);
+    };
+
+    out << "{\"input\":" << jsonString(input) << ",\"ok\":" << (ok ? "true" : "false")
+        << ",\"cached\":" << (stats.cached ? "true" : "false") << ",\"seconds\":{"
+        << "\"load\":" << secondsField(stats.timings.load)
+        << ",\"discovery\":" << secondsField(stats.timings.discovery)
+        << ",\"transpilation\":" << secondsField(stats.timings.transpilation)
+        << ",\"write\":" << secondsField(stats.timings.write)
+        << ",\"total\":" << secondsField(stats.timings.total()) << "}"
+        << ",\"rewrite_lines\":" << stats.rewriteLines
+        << ",\"rewrite_tokens\":" << stats.rewriteTokens
+        << ",\"method_call_iterations\":" << stats.methodCallIterations
+        << ",\"pipe_iterations\":" << stats.pipeIterations
+        << ",\"symbol_lookups\":" << stats.symbolLookups
+        << ",\"peak_scope_depth\":" << stats.peakScopeDepth
+        << ",\"bytes_allocated\":" << stats.bytesAllocated
+        << ",\"modules_loaded\":" << stats.modulesLoaded
+        << ",\"modules_built\":" << stats.modulesBuilt
+        << ",\"chunks\":" << stats.chunks << "}";
+}
+
+} // namespace onyx
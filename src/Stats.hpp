@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace onyx {
+
+// Wall time of each stage of the last transpile or processFile call. Time spent writing
+// output while pass 2 streams it is counted under `write`, not `transpilation`.
+struct PassTimings {
+    std::chrono::nanoseconds load{0};
+    std::chrono::nanoseconds discovery{0};
+    std::chrono::nanoseconds transpilation{0};
+    std::chrono::nanoseconds write{0};
+
+    [[nodiscard]] std::chrono::nanoseconds total() const { return load + discovery + transpilation + write; }
+};
+
+// Work counters for one transpile or processFile call. Parallel chunks count into their
+// own copy and are merged back; the boundary scan counts nothing, so totals
+// match the serial pass.
+struct TranspileStats {
+    PassTimings timings;
+    bool cached = false; // output came from the cache; no pass ran
+    std::uint64_t rewriteLines = 0;         // lines tokenized by the call rewriter
+    std::uint64_t rewriteTokens = 0;        // tokens those lines held
+    std::uint64_t methodCallIterations = 0; // obj.method() calls expanded
+    std::uint64_t pipeIterations = 0;       // |> stages expanded
+    std::uint64_t symbolLookups = 0;
+    std::uint64_t peakScopeDepth = 0;
+    std::uint64_t bytesAllocated = 0; // operator new requests made on behalf of this file
+    std::uint64_t modulesLoaded = 0;  // imports served from an up-to-date .oxi
+    std::uint64_t modulesBuilt = 0;   // imports whose interface had to be rebuilt
+    std::uint64_t chunks = 0;         // pieces pass 2 was split into; 0 when it ran serially
+
+    void merge(const TranspileStats& other); // counters only; timings are the caller's
+};
+
+// `s` as a quoted, escaped JSON string.
+std::string jsonString(std::string_view s);
+
+void writeStatsText(std::ostream& out, std::string_view input, const TranspileStats& stats);
+// One JSON object per file, no trailing newline.
+void writeStatsJson(std::ostream& out, std::string_view input, bool ok, const TranspileStats& stats);
+
+} // namespace onyx
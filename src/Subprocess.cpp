@@ -0,0 +1,110 @@
+#include "Subprocess.hpp"
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <csignal>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#define ONYX_HAVE_SPAWN 1
+#endif
+
+namespace onyx {
+
+Subprocess::~Subprocess() {
+    if (m_input) std::fclose(m_input);
+    if (m_pid > 0) {
+        kill();
+        wait();
+    }
+}
+
+bool Subprocess::start(const std::vector<std::string>& argv, std::string& error) {
+#ifdef ONYX_HAVE_SPAWN
+    if (argv.empty()) {
+        error = "no command given";
+        return false;
+    }
+    int fds[2];
+    if (::pipe(fds) != 0) {
+        error = std::string("failed to create pipe - ") + std::strerror(errno);
+        return false;
+    }
+    // A child that exits early must surface as a write error, not kill us.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+    posix_spawn_file_actions_addclose(&actions, fds[1]);
+
+    // No process group of its own: the child stays in ours, so Ctrl-C at
+    // the terminal reaches the compiler along with us.
+    std::vector<char*> args;
+    for (const std::string& arg : argv) args.push_back(const_cast<char*>(arg.c_str()));
+    args.push_back(nullptr);
+
+    pid_t pid = 0;
+    const int rc = ::posix_spawnp(&pid, args[0], &actions, nullptr, args.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(fds[0]);
+    if (rc != 0) {
+        ::close(fds[1]);
+        error = "failed to run " + argv[0] + " - " + std::strerror(rc);
+        return false;
+    }
+    m_pid = pid;
+    m_input = ::fdopen(fds[1], "wb");
+    if (!m_input) {
+        ::close(fds[1]);
+        error = std::string("failed to open pipe - ") + std::strerror(errno);
+        kill();
+        wait();
+        return false;
+    }
+    return true;
+#else
+    error = "running " + (argv.empty() ? std::string("a compiler") : argv[0]) + " is not supported on this platform";
+    return false;
+#endif
+}
+
+std::FILE* Subprocess::takeInput() {
+    std::FILE* input = m_input;
+    m_input = nullptr;
+    return input;
+}
+
+int Subprocess::wait() {
+#ifdef ONYX_HAVE_SPAWN
+    if (m_pid <= 0) return -1;
+    if (m_input) {
+        std::fclose(m_input);
+        m_input = nullptr;
+    }
+    int status = 0;
+    while (::waitpid(static_cast<pid_t>(m_pid), &status, 0) < 0) {
+        if (errno != EINTR) {
+            m_pid = -1;
+            return -1;
+        }
+    }
+    m_pid = -1;
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return -1;
+#else
+    return -1;
+#endif
+}
+
+void Subprocess::kill() {
+#ifdef ONYX_HAVE_SPAWN
+    if (m_pid > 0) ::kill(static_cast<pid_t>(m_pid), SIGKILL);
+#endif
+}
+
+} // namespace onyx
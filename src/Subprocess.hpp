@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace onyx {
+
+// A child process fed through a pipe on its stdin. Its stdout and stderr are
+// inherited, so whatever it prints reaches the user directly.
+class Subprocess {
+public:
+    Subprocess() = default;
+    ~Subprocess(); // kills and reaps a child that was never waited for
+
+    Subprocess(const Subprocess&) = delete;
+    Subprocess& operator=(const Subprocess&) = delete;
+
+    // Starts argv[0], searched on PATH. On failure `error` says why.
+    bool start(const std::vector<std::string>& argv, std::string& error);
+
+    // Write end of the child's stdin. The caller owns it; closing it is how
+    // the child sees end of input.
+    std::FILE* takeInput();
+
+    // Waits for the child to exit. Returns its exit code, or 128 + the signal
+    // number if it was killed, or -1 if it was never started.
+    int wait();
+    // Kills the child itself. A compiler driver's own children then read end
+    // of input once the pipe closes, and nothing is left to assemble or link.
+    void kill();
+
+private:
+    long m_pid = -1;
+    std::FILE* m_input = nullptr;
+};
+
+} // namespace onyx
@@ -0,0 +1,58 @@
+#include "SymbolTable.hpp"
+
+namespace onyx {
+
+SymbolId Interner::intern(std::string_view text) {
+    if (auto it = m_ids.find(text); it != m_ids.end()) return it->second;
+    const auto id = static_cast<SymbolId>(m_names.size());
+    const std::string& stored = m_names.emplace_back(text);
+    m_ids.emplace(stored, id);
+    return id;
+}
+
+void SymbolTable::popScope() {
+    if (m_scopeStarts.empty()) return;
+    const std::uint32_t start = m_scopeStarts.back();
+    m_scopeStarts.pop_back();
+    for (std::size_t i = m_bindings.size(); i > start; --i) {
+        const Binding& binding = m_bindings[i - 1];
+        m_innermost[binding.name] = binding.shadowed;
+    }
+    m_bindings.resize(start);
+}
+
+void SymbolTable::add(std::string_view name, std::string_view type) {
+    if (m_scopeStarts.empty()) return;
+    const SymbolId nameId = m_interner.intern(name);
+    const SymbolId typeId = m_interner.intern(type);
+    if (m_innermost.size() < m_interner.size()) m_innermost.resize(m_interner.size(), 0);
+    m_bindings.push_back({nameId, typeId, m_innermost[nameId]});
+    m_innermost[nameId] = static_cast<std::uint32_t>(m_bindings.size());
+}
+
+SymbolTable::Snapshot SymbolTable::snapshot() const {
+    Snapshot snapshot;
+    snapshot.scopeStarts = m_scopeStarts;
+    snapshot.bindings.reserve(m_bindings.size());
+    for (const Binding& binding : m_bindings) {
+        snapshot.bindings.emplace_back(m_interner.name(binding.name), m_interner.name(binding.type));
+    }
+    return snapshot;
+}
+
+void SymbolTable::restore(const Snapshot& snapshot) {
+    m_bindings.clear();
+    m_scopeStarts.clear();
+    m_innermost.assign(m_innermost.size(), 0);
+
+    // Re-add scope by scope so each binding records what it shadows.
+    std::size_t next = 0;
+    for (std::size_t scope = 0; scope < snapshot.scopeStarts.size(); ++scope) {
+        const std::size_t end = scope + 1 < snapshot.scopeStarts.size() ? snapshot.scopeStarts[scope + 1]
+                                                                         : snapshot.bindings.size();
+        pushScope();
+        for (; next < end; ++next) add(snapshot.bindings[next].first, snapshot.bindings[next].second);
+    }
+}
+
+} // namespace onyx
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace onyx {
+
+using SymbolId = std::uint32_t;
+
+// Maps spellings to dense ids. Each spelling is stored once and never moves,
+// so views handed out by name() stay valid for the interner's lifetime.
+class Interner {
+public:
+    Interner() = default;
+    Interner(Interner&&) = default;
+    Interner& operator=(Interner&&) = default;
+    Interner(const Interner&) = delete; // keys view into m_names
+    Interner& operator=(const Interner&) = delete;
+
+    SymbolId intern(std::string_view text);
+    [[nodiscard]] std::optional<SymbolId> find(std::string_view text) const {
+        if (auto it = m_ids.find(text); it != m_ids.end()) return it->second;
+        return std::nullopt;
+    }
+    [[nodiscard]] std::string_view name(SymbolId id) const { return m_names[id]; }
+    [[nodiscard]] std::size_t size() const { return m_names.size(); }
+
+private:
+    std::unordered_map<std::string_view, SymbolId> m_ids;
+    std::deque<std::string> m_names;
+};
+
+// Scoped name -> type bindings. All bindings live in one array with scope
+// start markers; each binding links to the one it shadows, and m_innermost
+// points at the visible binding per symbol. A lookup is one hash plus an
+// index, and popping a scope truncates the array.
+class SymbolTable {
+public:
+    void pushScope() { m_scopeStarts.push_back(static_cast<std::uint32_t>(m_bindings.size())); }
+    void popScope();
+    // Ignored when no scope is open.
+    void add(std::string_view name, std::string_view type);
+    // The bound type, or an empty view. Valid until the table is destroyed.
+    [[nodiscard]] std::string_view lookup(std::string_view name) const {
+        const auto id = m_interner.find(name);
+        if (!id || *id >= m_innermost.size() || m_innermost[*id] == 0) return {};
+        return m_interner.name(m_bindings[m_innermost[*id] - 1].type);
+    }
+    [[nodiscard]] std::size_t depth() const { return m_scopeStarts.size(); }
+    // Spellings interned so far. They are kept after their bindings go.
+    [[nodiscard]] std::size_t interned() const { return m_interner.size(); }
+
+    // Live bindings by spelling, for moving scope state between tables.
+    struct Snapshot {
+        std::vector<std::pair<std::string, std::string>> bindings;
+        std::vector<std::uint32_t> scopeStarts;
+    };
+    [[nodiscard]] Snapshot snapshot() const;
+    void restore(const Snapshot& snapshot);
+
+private:
+    struct Binding {
+        SymbolId name;
+        SymbolId type;
+        std::uint32_t shadowed; // m_innermost value to restore on pop
+    };
+
+    Interner m_interner;
+    std::vector<Binding> m_bindings;
+    std::vector<std::uint32_t> m_scopeStarts;
+    std::vector<std::uint32_t> m_innermost; // per symbol: 1 + index into m_bindings, 0 when unbound
+};
+
+} // namespace onyx
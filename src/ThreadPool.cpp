@@ -0,0 +1,150 @@
+#include "ThreadPool.hpp"
+
+namespace onyx {
+
+namespace {
+// Identifies the pool and queue owned by the current thread, if it is a worker.
+thread_local const ThreadPool* t_pool = nullptr;
+thread_local std::size_t t_index = 0;
+}
+
+ThreadPool::ThreadPool(std::size_t threads) {
+    if (threads == 0) threads = 1;
+    for (std::size_t i = 0; i < threads; ++i) m_queues.push_back(std::make_unique<Queue>());
+    for (std::size_t i = 0; i < threads; ++i) m_workers.emplace_back([this, i] { workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto& worker : m_workers) worker.join();
+}
+
+void ThreadPool::submit(Task task) {
+    const std::size_t index = t_pool == this ? t_index : m_next++ % m_queues.size();
+    m_pending++;
+    {
+        std::lock_guard lock(m_queues[index]->mutex);
+        m_queues[index]->tasks.push_back(std::move(task));
+    }
+    m_queued++;
+    // Taking the lock orders the push against a worker about to sleep.
+    { std::lock_guard lock(m_mutex); }
+    m_wake.notify_one();
+}
+
+bool ThreadPool::runOne() {
+    return tryRun(t_pool == this ? t_index : 0);
+}
+
+void ThreadPool::wait() {
+    while (m_pending.load() != 0) {
+        if (runOne()) continue;
+        std::unique_lock lock(m_mutex);
+        m_idle.wait(lock, [this] { return m_pending.load() == 0; });
+    }
+}
+
+void ThreadPool::workerLoop(std::size_t index) {
+    t_pool = this;
+    t_index = index;
+    for (;;) {
+        if (tryRun(index)) continue;
+        std::unique_lock lock(m_mutex);
+        m_wake.wait(lock, [this] { return m_stopping || m_queued.load() != 0; });
+        if (m_stopping) return;
+    }
+}
+
+bool ThreadPool::tryRun(std::size_t home) {
+    Task task;
+    if (!pop(home, task) && !steal(home, task)) return false;
+    task();
+    if (--m_pending == 0) {
+        std::lock_guard lock(m_mutex);
+        m_idle.notify_all();
+    }
+    return true;
+}
+
+bool ThreadPool::pop(std::size_t index, Task& task) {
+    Queue& queue = *m_queues[index];
+    std::lock_guard lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    m_queued--;
+    return true;
+}
+
+bool ThreadPool::steal(std::size_t thief, Task& task) {
+    for (std::size_t i = 1; i < m_queues.size(); ++i) {
+        Queue& victim = *m_queues[(thief + i) % m_queues.size()];
+        std::lock_guard lock(victim.mutex);
+        if (victim.tasks.empty()) continue;
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        m_queued--;
+        return true;
+    }
+    return false;
+}
+
+struct TaskGroup::State {
+    std::mutex mutex;
+    std::condition_variable changed;  // a task was added or finished
+    std::deque<ThreadPool::Task> tasks; // not started yet
+    std::size_t pending = 0;            // not finished yet
+};
+
+TaskGroup::TaskGroup(ThreadPool& pool) : m_pool(pool), m_state(std::make_shared<State>()) {}
+
+void TaskGroup::run(ThreadPool::Task task) {
+    {
+        std::lock_guard lock(m_state->mutex);
+        m_state->tasks.push_back(std::move(task));
+        m_state->pending++;
+    }
+    m_state->changed.notify_all();
+    // Each pool task runs whichever of the group's tasks is next, if a waiter
+    // has not run them all already.
+    m_pool.submit([state = m_state] { runNext(*state); });
+}
+
+bool TaskGroup::runNext(State& state) {
+    ThreadPool::Task task;
+    {
+        std::lock_guard lock(state.mutex);
+        if (state.tasks.empty()) return false;
+        task = std::move(state.tasks.front());
+        state.tasks.pop_front();
+    }
+    task();
+    {
+        std::lock_guard lock(state.mutex);
+        state.pending--;
+    }
+    state.changed.notify_all();
+    return true;
+}
+
+void TaskGroup::wait(const std::function<bool()>& until) {
+    State& state = *m_state;
+    std::unique_lock lock(state.mutex);
+    while (state.pending != 0 && !(until && until())) {
+        if (state.tasks.empty()) {
+            // The rest are running on workers, which need nothing from us.
+            state.changed.wait(lock);
+            continue;
+        }
+        lock.unlock();
+        runNext(state);
+        lock.lock();
+    }
+}
+
+} // namespace onyx
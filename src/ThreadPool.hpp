@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace onyx {
+
+// Work-stealing thread pool. Every worker owns a deque: it pops its own work
+// from the back and steals from the front of the others when it runs dry.
+// Tasks submitted from inside a worker land on that worker's deque, which
+// keeps nested work local.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Tasks must not throw.
+    void submit(Task task);
+
+    // Blocks until every submitted task has finished. The calling thread runs
+    // queued tasks while there are any, then sleeps until the workers are done.
+    void wait();
+
+    [[nodiscard]] std::size_t size() const { return m_workers.size(); }
+
+    // Runs one queued task on the calling thread, if there is one.
+    bool runOne();
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(std::size_t index);
+    bool tryRun(std::size_t home);
+    bool pop(std::size_t index, Task& task);
+    bool steal(std::size_t thief, Task& task);
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::atomic<std::size_t> m_pending{0}; // queued or running
+    std::atomic<std::size_t> m_queued{0};  // waiting in a deque
+    std::atomic<std::size_t> m_next{0};
+    bool m_stopping = false;
+};
+
+// A set of tasks that can be waited on independently of everything else in the
+// pool. Waiting runs the group's own tasks that no worker has started yet, and
+// only those, so groups may be nested inside tasks without a waiter picking up
+// unrelated work on its stack.
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool);
+    ~TaskGroup() { wait(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    // Tasks must not throw.
+    void run(ThreadPool::Task task);
+    void wait() { wait(nullptr); }
+    // Returns as soon as `until` holds, or once every task has finished.
+    // `until` is checked whenever one of the group's tasks finishes.
+    void wait(const std::function<bool()>& until);
+
+private:
+    struct State;
+    static bool runNext(State& state);
+
+    ThreadPool& m_pool;
+    std::shared_ptr<State> m_state; // shared with the pool's tasks, which may outlive the group
+};
+
+} // namespace onyx
@@ -1,200 +1,2030 @@
 #include "Transpiler.hpp"
-#include <iostream>
-#include <fstream>
-#include <sstream>
-#include <regex>
-#include <set>
+#include "Comptime.hpp"
+#include "Generics.hpp"
+#include "Lexer.hpp"
+#include "ThreadPool.hpp"
+#include "Hash.hpp"
+#include "Module.hpp"
+#include "OutputCache.hpp"
+#include "AllocationCounter.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <stdexcept>
 
 namespace onyx {
 
-static const std::regex R_COMMENT(R"(^\s*#)");
-static const std::regex R_INCLUDE(R"(^\s*@include\s+\"([^\"]+)\")");
-static const std::regex R_SHARED_START(R"(^\s*shared\s+(\w+)\s*[{])");
-static const std::regex R_STRUCT_START(R"(^\s*(?:@\[(.*)\]\s*)?struct\s+(\w+)\s*[{])");
-static const std::regex R_ATTRIBUTE_LINE(R"(^\s*@\[(.*)\]\s*$)"); // Handle standalone attributes
-static const std::regex R_USE_MIXIN(R"(^\s*use\s+(\w+))");
-static const std::regex R_FIELD(R"(^\s*(\w+)\s*:\s*([\w\*]+)\s*)");
-static const std::regex R_RESOLVE_START(R"(^\s*resolve\s+(\w+)\s*[{])");
-static const std::regex R_FUNC_SIGNATURE(R"(^\s*(?:@\[(.*)\]\s*)?(?:(inline|extern|static)\s+)?fn\s+(\w+)\s*\((.*)\)\s*(?:->\s*([\w\*]+))?\s*)");
-static const std::regex R_VAR(R"(^\s*var\s+(?:(volatile|register|const)\s+)?(\w+)\s*:\s*([\w\*]+)\s*(?:=\s*(.*))?)");
-static const std::regex R_IF(R"(^\s*if\s+(.*)\s*[{])");
-static const std::regex R_WHILE(R"(^\s*while\s+(.*)\s*[{])");
-static const std::regex R_LOOP(R"(^\s*loop\s*[{])");
-static const std::regex R_NATIVE_BLOCK(R"(^\s*native\s*[{])");
+// Bump when the generated C changes for identical input, to invalidate caches.
+static constexpr std::string_view CACHE_SCHEMA = "onyx-cache-1";
+
+// Resolve methods with at most this many lines between their braces go into
+// an --emit-header header as static inline.
+static constexpr int SMALL_FUNCTION_LINES = 3;
+
+namespace {
+
+// Line matchers. Each recognises one construct by its leading keyword token and
+// extracts the same captures the original line grammar defined; "rest of line"
+// captures are taken as raw slices so their contents are reproduced verbatim.
+
+std::size_t skipSpace(std::string_view s, std::size_t i) {
+    while (i < s.size() && isSpace(s[i])) ++i;
+    return i;
+}
+
+// End of a "rest of line" capture starting at `from`: captures never span \r or \n.
+std::size_t captureEnd(std::string_view s, std::size_t from) {
+    const std::size_t e = s.find_first_of("\r\n", from);
+    return e == std::string_view::npos ? s.size() : e;
+}
+
+// Length of a [\w*]+ type spelling at `i`.
+std::size_t typeLength(std::string_view s, std::size_t i) {
+    std::size_t e = i;
+    while (e < s.size() && (isWordChar(s[e]) || s[e] == '*')) ++e;
+    return e - i;
+}
+
+std::string_view trimLeft(std::string_view s) {
+    return s.substr(skipSpace(s, 0));
+}
+
+std::string_view trim(std::string_view s) {
+    s = trimLeft(s);
+    while (!s.empty() && isSpace(s.back())) s.remove_suffix(1);
+    return s;
+}
+
+bool isWordText(std::string_view s) {
+    return !s.empty() && std::all_of(s.begin(), s.end(), isWordChar);
+}
+
+bool isBlank(std::string_view s) {
+    return skipSpace(s, 0) == s.size();
+}
+
+bool opensBlock(std::string_view s) {
+    std::size_t e = s.size();
+    while (e > 0 && isSpace(s[e - 1])) --e;
+    if (e > 0 && s[e - 1] == '{') return true;
+    const std::size_t b = skipSpace(s, 0);
+    return b < s.size() && s[b] == '{';
+}
+
+bool closesBlock(std::string_view s) {
+    const std::size_t b = skipSpace(s, 0);
+    return b < s.size() && s[b] == '}';
+}
+
+bool matchComment(std::string_view s) {
+    return Lexer(s).next().is('#');
+}
+
+// `@include "path"` or `@import "path"`.
+bool matchDirective(std::string_view s, Keyword keyword, std::string_view& path) {
+    Lexer lex(s);
+    if (!lex.next().is('@')) return false;
+    if (Token kw = lex.next(); kw.spaced || kw.keyword() != keyword) return false;
+    const std::size_t quote = skipSpace(s, lex.position());
+    if (quote == lex.position() || quote >= s.size() || s[quote] != '"') return false;
+    const std::size_t close = s.find('"', quote + 1);
+    if (close == std::string_view::npos || close == quote + 1) return false;
+    path = s.substr(quote + 1, close - quote - 1);
+    return true;
+}
+
+// A line holding nothing but @[...]
+bool matchAttributeLine(std::string_view s, std::string_view& attr) {
+    const Token head = Lexer(s).next();
+    if (!head.is("@[")) return false;
+    std::size_t e = s.size();
+    while (e > 0 && isSpace(s[e - 1])) --e;
+    if (e < head.end() + 1 || s[e - 1] != ']') return false;
+    attr = s.substr(head.end(), e - 1 - head.end());
+    return attr.find_first_of("\r\n") == std::string_view::npos;
+}
+
+// `keyword Name {` as used by shared and resolve blocks.
+bool matchNamedBlock(std::string_view s, Keyword keyword, std::string_view& name) {
+    Lexer lex(s);
+    if (lex.next().keyword() != keyword) return false;
+    const Token id = lex.next();
+    if (!id.isWord() || !id.spaced || !lex.next().is('{')) return false;
+    name = id.text;
+    return true;
+}
+
+// `pool name<Type> {`
+bool matchPool(std::string_view s, std::string_view& name, std::string_view& type) {
+    Lexer lex(s);
+    if (lex.next().keyword() != Keyword::Pool) return false;
+    const Token id = lex.next();
+    if (!id.isWord() || !id.spaced || !lex.next().is('<')) return false;
+    const std::size_t start = skipSpace(s, lex.position());
+    const std::size_t length = typeLength(s, start);
+    Lexer rest(s, start + length);
+    if (length == 0 || !rest.next().is('>') || !rest.next().is('{')) return false;
+    name = id.text;
+    type = s.substr(start, length);
+    return true;
+}
+
+// `native {`; yields the offset just past the brace.
+bool matchNative(std::string_view s, std::size_t& bodyStart) {
+    Lexer lex(s);
+    if (lex.next().keyword() != Keyword::Native) return false;
+    const Token brace = lex.next();
+    if (!brace.is('{')) return false;
+    bodyStart = brace.end();
+    return true;
+}
+
+bool matchUse(std::string_view s, std::string_view& name) {
+    Lexer lex(s);
+    if (lex.next().keyword() != Keyword::Use) return false;
+    const Token id = lex.next();
+    if (!id.isWord() || !id.spaced) return false;
+    name = id.text;
+    return true;
+}
+
+// `name : type` starting at the lexer's position.
+bool matchTypedName(Lexer& lex, std::string_view& name, std::string_view& type) {
+    const Token id = lex.next();
+    if (!id.isWord() || !lex.next().is(':')) return false;
+    const std::string_view s = lex.line();
+    const std::size_t t = skipSpace(s, lex.position());
+    const std::size_t len = typeLength(s, t);
+    if (len == 0) return false;
+    name = id.text;
+    type = s.substr(t, len);
+    lex.seek(t + len);
+    return true;
+}
+
+bool matchField(std::string_view s, std::string_view& name, std::string_view& type) {
+    Lexer lex(s);
+    return matchTypedName(lex, name, type);
+}
+
+struct VarDecl {
+    std::string_view mods, name, type, value;
+    std::string_view extent; // of `name: type[extent]`
+};
+
+bool matchVar(std::string_view s, VarDecl& var) {
+    Lexer lex(s);
+    if (lex.next().keyword() != Keyword::Var) return false;
+    const Token first = lex.peek();
+    if (!first.isWord() || !first.spaced) return false;
+
+    const std::size_t afterVar = lex.position();
+    bool matched = false;
+    if (const Keyword k = first.keyword(); k == Keyword::Volatile || k == Keyword::Register || k == Keyword::Const) {
+        lex.next();
+        if (lex.peek().spaced && matchTypedName(lex, var.name, var.type)) {
+            var.mods = first.text;
+            matched = true;
+        } else {
+            lex.seek(afterVar);
+        }
+    }
+    if (!matched && !matchTypedName(lex, var.name, var.type)) return false;
+
+    std::size_t eq = skipSpace(s, lex.position());
+    if (eq < s.size() && s[eq] == '[') {
+        const std::size_t close = s.find(']', eq);
+        if (close == std::string_view::npos) return false;
+        var.extent = trim(s.substr(eq + 1, close - eq - 1));
+        if (var.extent.empty()) return false;
+        eq = skipSpace(s, close + 1);
+    }
+    if (eq < s.size() && s[eq] == '=') {
+        const std::size_t v = skipSpace(s, eq + 1);
+        var.value = s.substr(v, captureEnd(s, v) - v);
+    }
+    return true;
+}
+
+// Greedy `@[...]` prefix: tries every closing bracket from the right until the
+// remainder of the line matches `rest`.
+template <typename Rest>
+bool matchAttributed(std::string_view s, std::string_view& attr, Rest rest) {
+    const Token head = Lexer(s).peek();
+    if (!head.is("@[")) return rest(head.offset);
+    const std::size_t from = head.end();
+    for (std::size_t j = captureEnd(s, from); j > from;) {
+        j = s.rfind(']', j - 1);
+        if (j == std::string_view::npos || j < from) break;
+        if (rest(j + 1)) {
+            attr = s.substr(from, j - from);
+            return true;
+        }
+    }
+    return false;
+}
+
+struct StructDecl {
+    std::string_view attr, name;
+};
+
+bool matchStruct(std::string_view s, StructDecl& decl) {
+    return matchAttributed(s, decl.attr, [&](std::size_t pos) {
+        Lexer lex(s, pos);
+        if (lex.next().keyword() != Keyword::Struct) return false;
+        const Token id = lex.next();
+        if (!id.isWord() || !id.spaced || !lex.next().is('{')) return false;
+        decl.name = id.text;
+        return true;
+    });
+}
+
+struct FuncDecl {
+    std::string_view attr, mods, name, args, ret;
+};
+
+bool matchFunc(std::string_view s, FuncDecl& fn) {
+    return matchAttributed(s, fn.attr, [&](std::size_t pos) {
+        Lexer lex(s, pos);
+        Token tok = lex.next();
+        std::string_view mods;
+        if (const Keyword k = tok.keyword();
+            k == Keyword::Inline || k == Keyword::Extern || k == Keyword::Static || k == Keyword::Const) {
+            mods = tok.text;
+            tok = lex.next();
+            if (!tok.spaced) return false;
+        }
+        if (tok.keyword() != Keyword::Fn) return false;
+        const Token id = lex.next();
+        if (!id.isWord() || !id.spaced) return false;
+        const Token open = lex.next();
+        if (!open.is('(')) return false;
+
+        const std::size_t argsStart = open.end();
+        const std::size_t close = s.substr(0, captureEnd(s, argsStart)).rfind(')');
+        if (close == std::string_view::npos || close < argsStart) return false;
+
+        fn.mods = mods;
+        fn.name = id.text;
+        fn.args = s.substr(argsStart, close - argsStart);
+        fn.ret = {};
+        const std::size_t arrow = skipSpace(s, close + 1);
+        if (s.substr(arrow, 2) == "->") {
+            const std::size_t t = skipSpace(s, arrow + 2);
+            fn.ret = s.substr(t, typeLength(s, t));
+        }
+        return true;
+    });
+}
+
+// `if cond {` / `while cond {`; the condition runs up to the last brace.
+bool matchCondition(std::string_view s, Keyword keyword, std::string_view& cond) {
+    Lexer lex(s);
+    if (lex.next().keyword() != keyword) return false;
+    const Token first = lex.peek();
+    if (!first.spaced || first.kind == TokenKind::End) return false;
+    const std::size_t from = first.offset;
+    const std::size_t end = captureEnd(s, from);
+    if (end < s.size()) {
+        const std::size_t b = skipSpace(s, end);
+        if (b < s.size() && s[b] == '{') {
+            cond = s.substr(from, end - from);
+            return true;
+        }
+    }
+    const std::size_t brace = s.substr(0, end).rfind('{');
+    if (brace == std::string_view::npos || brace < from) return false;
+    cond = s.substr(from, brace - from);
+    return true;
+}
+
+struct ForLoop {
+    std::string_view name, type; // type as spelled, if given
+    std::string_view slice;      // base of `slice[from..to]`, empty for a plain range
+    std::string_view from, to;
+};
+
+// `for name[: type] in from..to {` or `for name[: type] in slice[from..to] {`
+bool matchFor(std::string_view s, ForLoop& loop) {
+    Lexer lex(s);
+    if (lex.next().keyword() != Keyword::For) return false;
+    const Token id = lex.next();
+    if (!id.isWord() || !id.spaced) return false;
+    Token in = lex.next();
+    if (in.is(':')) {
+        const std::size_t start = skipSpace(s, lex.position());
+        const std::size_t length = typeLength(s, start);
+        if (length == 0) return false;
+        loop.type = s.substr(start, length);
+        lex = Lexer(s, start + length);
+        in = lex.next();
+    }
+    if (!in.isWord() || in.text != "in") return false;
+    std::size_t e = s.size();
+    while (e > 0 && isSpace(s[e - 1])) --e;
+    if (e <= in.end() || s[e - 1] != '{') return false;
+    std::string_view range = trim(s.substr(in.end(), e - 1 - in.end()));
+    if (!range.empty() && range.back() == ']') {
+        std::size_t open = range.size() - 1;
+        for (int depth = 0; open-- > 0;) {
+            if (range[open] == ']') depth++;
+            else if (range[open] == '[' && depth-- == 0) break;
+        }
+        if (open == std::string_view::npos) return false;
+        loop.slice = trim(range.substr(0, open));
+        range = range.substr(open + 1, range.size() - open - 2);
+        if (loop.slice.empty()) return false;
+    }
+    const std::size_t dots = range.find("..");
+    if (dots == std::string_view::npos) return false;
+    loop.name = id.text;
+    loop.from = trim(range.substr(0, dots));
+    loop.to = trim(range.substr(dots + 2));
+    return !loop.from.empty() && !loop.to.empty() && loop.to.find("..") == std::string_view::npos;
+}
+
+bool matchLoop(std::string_view s) {
+    Lexer lex(s);
+    return lex.next().keyword() == Keyword::Loop && lex.next().is('{');
+}
+
+bool matchFunc(std::string_view s) {
+    FuncDecl fn;
+    return matchFunc(s, fn);
+}
+
+// Splits an argument list on commas and finds the first `name: type` pair in
+// each piece.
+template <typename Fn>
+void forEachArg(std::string_view args, Fn fn) {
+    std::size_t pos = 0;
+    while (pos <= args.size()) {
+        std::size_t comma = args.find(',', pos);
+        if (comma == std::string_view::npos) comma = args.size();
+        const std::string_view arg = args.substr(pos, comma - pos);
+        for (std::size_t i = 0; i < arg.size();) {
+            if (!isWordChar(arg[i])) {
+                ++i;
+                continue;
+            }
+            Lexer lex(arg, i);
+            std::string_view name, type;
+            if (matchTypedName(lex, name, type)) {
+                fn(name, type);
+                break;
+            }
+            while (i < arg.size() && isWordChar(arg[i])) ++i;
+        }
+        pos = comma + 1;
+    }
+}
+
+// Calls fn(item) for each entry of a comma-separated attribute list, trimmed.
+// Commas inside parentheses, as in `aligned(16)`, do not split.
+template <typename Fn>
+void forEachAttribute(std::string_view attrs, Fn fn) {
+    int parens = 0;
+    std::size_t start = 0;
+    for (std::size_t i = 0; i <= attrs.size(); ++i) {
+        if (i < attrs.size() && attrs[i] != ',') {
+            if (attrs[i] == '(') parens++;
+            else if (attrs[i] == ')') parens--;
+            continue;
+        }
+        if (i < attrs.size() && parens > 0) continue;
+        std::string_view item = attrs.substr(start, i - start);
+        item = trimLeft(item);
+        while (!item.empty() && isSpace(item.back())) item.remove_suffix(1);
+        if (!item.empty()) fn(item);
+        start = i + 1;
+    }
+}
+
+// `name` or `name(args)`; yields the trimmed args.
+bool isAttribute(std::string_view item, std::string_view name, std::string_view* args) {
+    if (item.substr(0, name.size()) != name) return false;
+    const std::string_view rest = trimLeft(item.substr(name.size()));
+    if (rest.empty()) {
+        if (args) *args = {};
+        return true;
+    }
+    if (rest.front() != '(' || rest.back() != ')') return false;
+    if (args) {
+        *args = trimLeft(rest.substr(1, rest.size() - 2));
+        while (!args->empty() && isSpace(args->back())) args->remove_suffix(1);
+    }
+    return true;
+}
+
+bool hasAttribute(std::string_view attrs, std::string_view name, std::string_view* args = nullptr) {
+    bool found = false;
+    forEachAttribute(attrs, [&](std::string_view item) {
+        if (!found) found = isAttribute(item, name, args);
+    });
+    return found;
+}
+
+// Drops `name` from an attribute list; the rest is what C gets to see.
+bool takeAttribute(std::string& attrs, std::string_view name, std::string* args = nullptr) {
+    std::string_view found;
+    if (!hasAttribute(attrs, name, &found)) return false;
+    if (args) *args = found;
+    std::string rest;
+    bool taken = false;
+    forEachAttribute(attrs, [&](std::string_view item) {
+        if (!taken && isAttribute(item, name, nullptr)) {
+            taken = true;
+            return;
+        }
+        if (!rest.empty()) rest += ", ";
+        rest += item;
+    });
+    attrs = std::move(rest);
+    return true;
+}
+
+// `self->field` -> `self->field[index]` for each field of an @[soa] struct.
+std::string_view indexFields(Arena& arena, std::string_view s, const std::vector<std::string>& fields) {
+    if (s.find("self") == std::string_view::npos) return s;
+    std::string out;
+    std::size_t copied = 0;
+    Lexer lex(s);
+    Token prev;
+    for (Token tok = lex.next(); tok.kind != TokenKind::End; prev = tok, tok = lex.next()) {
+        if (!tok.isWord() || tok.text != "self" || prev.is('.') || prev.is("->")) continue;
+        const std::size_t after = lex.position();
+        const Token arrow = lex.next();
+        const Token field = lex.next();
+        if (!arrow.is("->") || !field.isWord() ||
+            std::find(fields.begin(), fields.end(), field.text) == fields.end()) {
+            lex.seek(after);
+            continue;
+        }
+        out.append(s, copied, field.end() - copied).append("[index]");
+        copied = field.end();
+        tok = field;
+    }
+    if (copied == 0) return s;
+    out.append(s, copied);
+    return arena.copy(out);
+}
+
+// Indentation below zero means a closing brace had nothing to close.
+void checkDepth(int depth) {
+    if (depth < 0) throw std::runtime_error("unbalanced closing brace");
+}
+
+// Non-overlapping left-to-right replacement, built in the arena.
+std::string_view replaceAll(Arena& arena, std::string_view s, std::string_view from, std::string_view to) {
+    std::size_t count = 0;
+    for (std::size_t pos = s.find(from); pos != std::string_view::npos; pos = s.find(from, pos + from.size())) count++;
+    if (count == 0) return s;
+    char* out = static_cast<char*>(arena.allocate(s.size() + count * to.size() - count * from.size(), 1));
+    char* at = out;
+    std::size_t copied = 0;
+    for (std::size_t pos = s.find(from); pos != std::string_view::npos; pos = s.find(from, pos + from.size())) {
+        at = std::copy(s.begin() + copied, s.begin() + pos, at);
+        at = std::copy(to.begin(), to.end(), at);
+        copied = pos + from.size();
+    }
+    at = std::copy(s.begin() + copied, s.end(), at);
+    return {out, static_cast<std::size_t>(at - out)};
+}
+
+// Const fn bodies: the statements of lines[i...] up to the `}` that closes
+// their block, where `i` is left. Line numbers count from `first`.
+void parseConstBlock(const std::vector<std::string>& lines, std::size_t& i, std::size_t first,
+                     std::vector<ConstStatement>& out);
+
+// The `if` at lines[i], and its `} else {` block if there is one.
+ConstStatement parseConstIf(const std::vector<std::string>& lines, std::size_t& i, std::size_t first,
+                            std::string_view cond) {
+    ConstStatement branch{.kind = ConstStatement::Kind::If, .line = first + i, .expr = std::string(trim(cond))};
+    ++i;
+    parseConstBlock(lines, i, first, branch.body);
+    if (i >= lines.size()) return branch;
+    Lexer lex(trim(lines[i]));
+    lex.next();
+    const Token word = lex.next();
+    if (!word.isWord() || word.text != "else") return branch;
+    if (!lex.next().is('{') || lex.next().kind != TokenKind::End) {
+        throw std::runtime_error("line " + std::to_string(first + i) + ": expected `} else {`");
+    }
+    ++i;
+    parseConstBlock(lines, i, first, branch.orElse);
+    return branch;
+}
+
+void parseConstBlock(const std::vector<std::string>& lines, std::size_t& i, std::size_t first,
+                     std::vector<ConstStatement>& out) {
+    using Kind = ConstStatement::Kind;
+    for (; i < lines.size(); ++i) {
+        const std::string_view s = trim(lines[i]);
+        const Token head = Lexer(s).peek();
+        if (head.kind == TokenKind::End || head.is('#')) continue;
+        if (head.is('}')) return;
+        ConstStatement st{.line = first + i};
+        std::string_view cond;
+        VarDecl var;
+        ForLoop loop;
+        if (head.keyword() == Keyword::Var && matchVar(s, var) && var.extent.empty()) {
+            st.kind = Kind::Var;
+            st.name = var.name;
+            st.type = var.type;
+            st.expr = var.value;
+        } else if (matchCondition(s, Keyword::If, cond)) {
+            out.push_back(parseConstIf(lines, i, first, cond));
+            continue;
+        } else if (matchCondition(s, Keyword::While, cond) || matchLoop(s)) {
+            st.kind = head.keyword() == Keyword::While ? Kind::While : Kind::Loop;
+            st.expr = trim(cond);
+            ++i;
+            parseConstBlock(lines, i, first, st.body);
+        } else if (matchFor(s, loop) && loop.slice.empty()) {
+            st.kind = Kind::For;
+            st.name = loop.name;
+            st.type = loop.type;
+            st.expr = loop.from;
+            st.limit = loop.to;
+            ++i;
+            parseConstBlock(lines, i, first, st.body);
+        } else if (s == "break" || s == "continue") {
+            st.kind = s == "break" ? Kind::Break : Kind::Continue;
+        } else if (head.isWord() && head.text == "return") {
+            st.kind = Kind::Return;
+            st.expr = trim(s.substr(head.end()));
+        } else {
+            // name = expr, or a compound assignment such as name <<= expr
+            static constexpr std::string_view ops[] = {"<<=", ">>=", "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "="};
+            const std::size_t at = head.isWord() ? skipSpace(s, head.end()) : s.size();
+            for (std::string_view op : ops) {
+                if (s.substr(at, op.size()) == op && s.substr(at, 2) != "==") {
+                    st.kind = Kind::Assign;
+                    st.name = head.text;
+                    st.op = op;
+                    st.expr = trim(s.substr(at + op.size()));
+                    break;
+                }
+            }
+            if (st.op.empty()) {
+                throw std::runtime_error("line " + std::to_string(st.line) + ": `" + std::string(s) +
+                                         "` cannot run at compile time");
+            }
+        }
+        out.push_back(std::move(st));
+    }
+}
+
+// `{` v, v, ... `}` wrapped to lines of about 100 columns, one level deeper
+// than `depth`.
+std::string formatTable(const std::vector<ConstValue>& values, int depth) {
+    const std::string indent(static_cast<std::size_t>(depth + 1) * 4, ' ');
+    std::string text = "{\n" + indent;
+    std::size_t column = indent.size();
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        const std::string literal = constLiteral(values[i]);
+        if (i > 0) {
+            if (column + 2 + literal.size() > 100) {
+                text += ",\n" + indent;
+                column = indent.size();
+            } else {
+                text += ", ";
+                column += 2;
+            }
+        }
+        text += literal;
+        column += literal.size();
+    }
+    return text.append("\n").append(static_cast<std::size_t>(depth) * 4, ' ').append("}");
+}
+
+} // namespace
 
 // Implementation
 
-Transpiler::Transpiler(TranspilerConfig config) : m_config(config) {}
+template <typename Fn>
+static void forEachLine(std::string_view content, Fn fn) {
+    std::size_t pos = 0;
+    while (pos < content.size()) {
+        std::size_t end = content.find('\n', pos);
+        if (end == std::string_view::npos) end = content.size();
+        fn(content.substr(pos, end - pos));
+        pos = end + 1;
+    }
+}
+
+// A loaded module interface. The views point into the mapped .oxi when it
+// was up to date, or into `built` when it had to be rebuilt.
+struct Transpiler::Module {
+    std::filesystem::path source;
+    std::uint64_t key = 0; // changes whenever the module or anything it imports does
+    MappedFile mapping;
+    std::string built;
+    InterfaceView view;
+    std::vector<const Module*> imports;
+};
+
+Transpiler::Transpiler(TranspilerConfig config, ThreadPool* pool)
+    : m_config(config), m_pool(pool), m_lineDirectives(config.line_directives || !config.source_map.empty()) {}
+
+Transpiler::~Transpiler() = default;
 
 bool Transpiler::processFile(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath) {
-    loadFile(inputPath);
-    if (m_source.empty()) return false;
+    using Clock = std::chrono::steady_clock;
+    beginRun();
+    AllocationScope allocations(m_stats.bytesAllocated);
+
+    auto mark = Clock::now();
+    auto lap = [&mark] {
+        const auto now = Clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(now - std::exchange(mark, now));
+    };
+
+    const bool loaded = loadFile(inputPath);
+    m_stats.timings.load = lap();
+    if (!loaded) return false;
+    m_dependencies.push_back(inputPath);
+    const std::string name = inputPath.filename().string();
+    m_sourcePath = inputPath.string();
+
+    // Output streams into a staging file that replaces the target only once
+    // transpilation succeeded, so a failed run never leaves a partial .c behind.
+    // An unchanged result leaves the existing .c (and its mtime) alone.
+    const std::filesystem::path stagingPath = uniqueSibling(outputPath);
+    OutputWriter writer;
 
     try {
-        pass1_Discovery(m_source);
-        
-        m_symbols.scopes.clear();
-        m_symbols.pushScope(); 
-        m_braceDepth = 0;
-        m_currentResolveType = "";
-        m_inShared = false;
-        m_inStruct = false;
-        m_pendingAttribute = "";
-        m_currentStructAttribute = "";
-        
-        pass2_Transpilation(m_source);
-        
-        std::ofstream out(outputPath);
-        if (!out) return false;
-        
-        out << "// transpiled from " << inputPath.filename().string() << "\n";
-        // Implicit includes removed per user request
-        
-        for (const auto& line : m_outputLines) {
-            out << line << "\n";
+        loadImports(m_source.view(), inputPath.parent_path());
+        std::optional<OutputCache> cache;
+        std::string key;
+        if (!m_config.cache_dir.empty() && !m_config.layout_report && m_config.header.empty()) {
+            cache.emplace(m_config.cache_dir);
+            // #line directives and profile records name the path as given,
+            // not just the file name.
+            key = cacheKey(m_lineDirectives || m_config.instrument ? m_sourcePath : name, m_source.view(), m_sourcePath,
+                           m_importKeys);
+            if (auto hit = cache->lookup(key)) {
+                std::error_code ec;
+                if (!sameContents(*hit, outputPath) &&
+                    (!std::filesystem::copy_file(*hit, stagingPath, std::filesystem::copy_options::overwrite_existing, ec) ||
+                     !commitOutput(stagingPath, outputPath))) {
+                    throw std::runtime_error("failed to write " + outputPath.string());
+                }
+                writeDepfile(outputPath);
+                writeSourceMap(outputPath);
+                m_stats.cached = true;
+                m_stats.timings.write = lap();
+                return true;
+            }
         }
+
+        if (!writer.open(stagingPath)) return false;
+        m_output = &writer;
+        HeaderParts header;
+        if (!m_config.header.empty()) m_header = &header;
+        m_stats.timings.load += lap(); // cache lookup and output setup
+
+        run(m_source.view(), name);
+        const auto streamed = writer.ioTime();
+        m_stats.timings.transpilation -= streamed;
+
+        m_output = nullptr;
+        mark = Clock::now();
+        if (!writer.close()) throw std::runtime_error("failed to write " + outputPath.string());
+        if (cache) cache->store(key, stagingPath); // a cache that cannot be written is not an error
+        if (!commitOutput(stagingPath, outputPath)) throw std::runtime_error("failed to write " + outputPath.string());
+        writeHeader(name);
+        m_header = nullptr;
+        writeDepfile(outputPath);
+        writeSourceMap(outputPath);
+        m_stats.timings.write = lap() + streamed;
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "transpilation Error: " << e.what() << "\n";
+        m_output = nullptr;
+        m_header = nullptr;
+        writer.close();
+        std::error_code ec;
+        std::filesystem::remove(stagingPath, ec);
+        m_diagnostics.push_back(std::string("transpilation Error: ") + e.what());
         return false;
     }
 }
 
-void Transpiler::loadFile(const std::filesystem::path& path) {
-    std::ifstream in(path);
-    if (!in) return;
-    std::stringstream buffer;
-    buffer << in.rdbuf();
-    m_source = buffer.str();
+bool Transpiler::processFile(const std::filesystem::path& inputPath, OutputWriter& output) {
+    using Clock = std::chrono::steady_clock;
+    beginRun();
+    AllocationScope allocations(m_stats.bytesAllocated);
+
+    const auto start = Clock::now();
+    const bool loaded = loadFile(inputPath);
+    m_stats.timings.load = Clock::now() - start;
+    if (!loaded) return false;
+    m_dependencies.push_back(inputPath);
+    m_sourcePath = inputPath.string();
+
+    const auto ioBefore = output.ioTime();
+    m_output = &output;
+    try {
+        loadImports(m_source.view(), inputPath.parent_path());
+        run(m_source.view(), inputPath.filename().string());
+        m_output = nullptr;
+        m_stats.timings.transpilation -= output.ioTime() - ioBefore;
+        if (!output.flush()) throw std::runtime_error("failed to write output");
+        m_stats.timings.write = output.ioTime() - ioBefore;
+        return true;
+    } catch (const std::exception& e) {
+        m_output = nullptr;
+        m_diagnostics.push_back(std::string("transpilation Error: ") + e.what());
+        return false;
+    }
 }
 
-void Transpiler::pass1_Discovery(const std::string& content) {
-    std::stringstream ss(content);
-    std::string line;
-    std::string currentMixinName;
-    std::string currentMixinBody;
-    bool insideMixin = false;
-    int depth = 0;
+bool Transpiler::transpile(std::string_view source, std::string& output, std::string_view name) {
+    beginRun();
+    AllocationScope allocations(m_stats.bytesAllocated);
 
-    while (std::getline(ss, line)) {
-        std::smatch match;
-        if (!insideMixin && std::regex_search(line, match, R_SHARED_START)) {
-            insideMixin = true;
-            currentMixinName = match[1].str();
-            currentMixinBody = "";
-            depth = 1;
-            continue;
+    // Output is staged so a failed call leaves `output` as it was.
+    std::string staged;
+    OutputWriter writer(0); // string sink
+    writer.open(staged);
+    m_output = &writer;
+    m_sourcePath = name;
+    try {
+        loadImports(source, std::filesystem::path(name).parent_path());
+        run(source, name);
+    } catch (const std::exception& e) {
+        m_output = nullptr;
+        m_diagnostics.push_back(std::string("transpilation Error: ") + e.what());
+        return false;
+    }
+    m_output = nullptr;
+    if (output.empty()) output = std::move(staged);
+    else output += staged;
+    return true;
+}
+
+void Transpiler::reset() {
+    beginRun();
+    m_arena.reset();
+    m_symbols = SymbolTable();
+    m_sharedMixins = {};
+    m_soaStructs = {};
+    m_generics = {};
+    m_genericUses = {};
+    m_instantiated = {};
+    m_instances = {};
+    m_comptime = ConstEvaluator();
+    m_deferredUses = {};
+    m_deferredOutput = {};
+    m_params = {};
+}
+
+// Forgets what the previous call left behind. Arena blocks, interned names
+// and container capacity are kept so back-to-back calls start warm, up to
+// WarmArenaBytes and WarmSymbols, like the server caps its memo.
+void Transpiler::beginRun() {
+    m_diagnostics.clear();
+    m_dependencies.clear();
+    m_layouts.clear();
+    m_stats = {};
+    if (m_arena.bytesReserved() > WarmArenaBytes) m_arena.reset();
+    else m_arena.rewind({});
+    if (m_symbols.interned() > WarmSymbols) m_symbols = SymbolTable();
+    m_output = nullptr;
+    m_source.close();
+    m_sharedMixins.clear();
+    m_soaStructs.clear();
+    m_discovery = {};
+    m_generics.clear();
+    m_genericUses.clear();
+    m_instantiated.clear();
+    m_instances.clear();
+    m_vectorTypes = 0;
+    m_usesRegions = false;
+    m_layoutHeaders = 0;
+    m_comptime.clear();
+    m_header = nullptr;
+    m_headerSection = HeaderSection::None;
+    m_smallFunctions.clear();
+    m_profile = nullptr;
+    m_deferredUses.clear();
+    m_unresolvedUses = 0;
+    m_deferredWriter.close();
+    m_deferredOutput.clear();
+    m_streamOutput = nullptr;
+    m_pendingUse.reset();
+    m_scanning = false;
+    m_sourcePath.clear();
+    m_lineNumber = 0;
+    m_nextLine = 0;
+    m_modules.clear();
+    m_importText.clear();
+    m_importKeys.clear();
+    restoreState(PassState{});
+}
+
+// Both passes over `source`, written to m_output. Throws on malformed input.
+void Transpiler::run(std::string_view source, std::string_view name) {
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    if (m_header && m_config.single_pass) throw std::runtime_error("--emit-header needs the discovery pass; drop --single-pass");
+    if (!m_config.single_pass) {
+        pass1_Discovery(source);
+        instantiateGenerics();
+    }
+    const auto discovered = Clock::now();
+    m_stats.timings.discovery = discovered - start;
+
+    m_symbols.pushScope();
+    m_stats.peakScopeDepth = 1;
+
+    emit(std::string("// transpiled from ").append(name));
+    // Implicit includes removed per user request
+    if (m_config.single_pass) {
+        // Without the discovery pass the preludes still need one look at
+        // the whole source; all of them are found in the same scan.
+        forEachLine(source, [&](std::string_view line) {
+            m_vectorTypes |= vectorTypesIn(line);
+            if (!m_usesRegions) m_usesRegions = mentionsRegions(line);
+            m_layoutHeaders |= layoutHeadersIn(line);
+        });
+    }
+    std::string prelude;
+    if (m_layoutHeaders) writeLayoutPrelude(prelude, m_layoutHeaders);
+    if (m_vectorTypes) writeVectorPrelude(prelude, m_vectorTypes);
+    if (m_usesRegions) writeRegionRuntime(prelude);
+    if (m_header) {
+        // Types and static inline helpers only, so the header can carry them.
+        m_header->types += prelude;
+        emit(std::string("#include \"").append(m_config.header.filename().string()).append("\""));
+    } else if (m_output) {
+        m_output->write(prelude);
+    }
+    if (m_config.instrument && m_output) {
+        std::string runtime;
+        writeProfileRuntime(runtime, static_cast<std::size_t>(std::count(source.begin(), source.end(), '\n')) + 1,
+                            m_sourcePath);
+        m_output->write(runtime);
+    }
+    if (m_config.profile) m_profile = m_config.profile->find(m_sourcePath);
+
+    pass2_Transpilation(source);
+    m_stats.timings.transpilation = Clock::now() - discovered;
+}
+
+// Everything the generated text depends on: the source bytes, the file name
+// (echoed in the header comment), output-affecting options and the transpiler
+// build itself. @include targets are passed through as #include and do not
+// influence the output.
+std::string Transpiler::cacheKey(std::string_view name, std::string_view source) const {
+    return cacheKey(name, source, name, {});
+}
+
+// `sourcePath` selects the profile counts; `importKeys` identify the loaded
+// modules. Both are passed in so no state from an earlier run leaks in.
+std::string Transpiler::cacheKey(std::string_view name, std::string_view source, std::string_view sourcePath,
+                                 const std::vector<std::uint64_t>& importKeys) const {
+    Hasher hasher;
+    hasher.update(CACHE_SCHEMA).update(__DATE__ " " __TIME__);
+    hasher.update(name);
+    hasher.update(static_cast<std::uint64_t>(m_config.keep_comments));
+    hasher.update(static_cast<std::uint64_t>(m_config.single_pass));
+    hasher.update(static_cast<std::uint64_t>(m_lineDirectives));
+    hasher.update(static_cast<std::uint64_t>(m_config.instrument));
+    if (m_config.profile) {
+        const ProfileCounts* counts = m_config.profile->find(sourcePath);
+        hasher.update(counts ? counts->hash() : 0);
+    }
+    hasher.update(source);
+    for (std::uint64_t module : importKeys) hasher.update(module);
+    return hasher.hex();
+}
+
+static std::string escapeDepPath(const std::string& path) {
+    std::string out;
+    for (char c : path) {
+        if (c == ' ' || c == '#') out += '\\';
+        else if (c == '$') out += '$';
+        out += c;
+    }
+    return out;
+}
+
+void Transpiler::writeDepfile(const std::filesystem::path& outputPath) const {
+    if (m_config.depfile.empty()) return;
+    std::string rule = escapeDepPath(outputPath.string()) + ":";
+    for (const auto& dep : m_dependencies) rule += " " + escapeDepPath(dep.string());
+    rule += "\n";
+
+    const std::filesystem::path staging = uniqueSibling(m_config.depfile);
+    OutputWriter writer;
+    if (!writer.open(staging)) throw std::runtime_error("failed to write " + m_config.depfile.string());
+    writer.write(rule);
+    if (!writer.close() || !commitOutput(staging, m_config.depfile)) {
+        throw std::runtime_error("failed to write " + m_config.depfile.string());
+    }
+}
+
+// The header guard is derived from the header's file name.
+void Transpiler::writeHeader(std::string_view name) const {
+    if (!m_header) return;
+    std::string guard = "ONYX_";
+    for (char c : m_config.header.filename().string()) {
+        guard += isWordChar(c) ? static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : '_';
+    }
+    const std::filesystem::path staging = uniqueSibling(m_config.header);
+    OutputWriter writer;
+    if (!writer.open(staging)) throw std::runtime_error("failed to write " + m_config.header.string());
+    writer.write(std::string("// declarations from ").append(name).append("\n"));
+    writer.write("#ifndef " + guard + "\n#define " + guard + "\n");
+    writer.write(m_header->types);
+    writer.write(m_header->prototypes);
+    writer.write(m_header->bodies);
+    writer.write("#endif\n");
+    if (!writer.close() || !commitOutput(staging, m_config.header)) {
+        throw std::runtime_error("failed to write " + m_config.header.string());
+    }
+}
+
+// Takes what belongs in the header: top-level struct typedefs, generic
+// instances, prototypes of exported functions and whole static inline
+// functions. Includes and imports go to both files. False when the node
+// (also) belongs in the .c.
+bool Transpiler::routeHeader(const Node& node) {
+    HeaderParts& header = *m_header;
+    if (m_headerSection == HeaderSection::Struct) {
+        header.types += renderNode(node);
+        if (node.kind == NodeKind::StructEnd) m_headerSection = HeaderSection::None;
+        return true;
+    }
+    if (m_headerSection == HeaderSection::Body) {
+        header.bodies += renderNode(node);
+        return true;
+    }
+    switch (node.kind) {
+    case NodeKind::Include:
+    case NodeKind::Import:
+        header.types += renderNode(node);
+        return false;
+    case NodeKind::Instance:
+        header.types += node.text;
+        return true;
+    case NodeKind::StructHead:
+        if (node.depth != 0) return false;
+        m_headerSection = HeaderSection::Struct;
+        header.types += renderNode(node);
+        return true;
+    case NodeKind::Function: {
+        if (!node.definition || node.depth != 0 || node.name == "main") return false;
+        const bool isStatic = node.mods.find("static") != std::string_view::npos;
+        // Instrumented bodies count into arrays private to the .c.
+        const bool isInline = isStatic && node.mods.find("inline") != std::string_view::npos && !m_config.instrument;
+        if (isStatic && !isInline) return false;
+        Node declaration = node;
+        declaration.definition = false;
+        header.prototypes += renderNode(declaration);
+        if (!isInline) return false;
+        m_headerSection = HeaderSection::Body;
+        m_headerEnd = m_braceDepth - 1;
+        header.bodies += renderNode(node);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// Follows the output's #line directives the way a C compiler does, so the
+// map agrees with what perf and the compiler report.
+void Transpiler::writeSourceMap(const std::filesystem::path& outputPath) const {
+    if (m_config.source_map.empty()) return;
+    MappedFile output;
+    if (!output.open(outputPath)) throw std::runtime_error("failed to read " + outputPath.string());
+    std::string map = "{\"version\":1,\"file\":" + jsonString(outputPath.string()) +
+                      ",\"source\":" + jsonString(m_sourcePath) + ",\"lines\":[";
+    std::size_t next = 0;
+    bool first = true;
+    forEachLine(output.view(), [&](std::string_view line) {
+        std::size_t mapped = 0;
+        if (line.substr(0, 6) == "#line ") {
+            next = std::strtoul(std::string(line.substr(6, 20)).c_str(), nullptr, 10);
+        } else if (next > 0) {
+            mapped = next++;
         }
+        if (!first) map += ',';
+        first = false;
+        map += std::to_string(mapped);
+    });
+    map += "]}\n";
 
-        if (insideMixin) {
-            for (char c : line) {
-                if (c == '{') depth++;
-                else if (c == '}') depth--;
+    const std::filesystem::path staging = uniqueSibling(m_config.source_map);
+    OutputWriter writer;
+    if (!writer.open(staging)) throw std::runtime_error("failed to write " + m_config.source_map.string());
+    writer.write(map);
+    if (!writer.close() || !commitOutput(staging, m_config.source_map)) {
+        throw std::runtime_error("failed to write " + m_config.source_map.string());
+    }
+}
+
+bool Transpiler::loadFile(const std::filesystem::path& path) {
+    return m_source.open(path) && !m_source.empty();
+}
+
+// C for an @import line: the module's declarations behind an include guard,
+// after those of its own imports, so a module reached twice expands once.
+static void renderModule(const InterfaceView& view, const std::vector<std::string>& imports,
+                         const std::string& name, std::uint64_t key, std::string& text) {
+    const std::string guard = "ONYX_IMPORT_" + Hasher::toHex(key);
+    text.append("// imported from ").append(name).append("\n");
+    text.append("#ifndef ").append(guard).append("\n#define ").append(guard).append("\n");
+    for (const std::string& import : imports) text.append(import);
+    for (std::string_view include : view.includes) text.append("#include \"").append(include).append("\"\n");
+    for (std::string_view decl : view.structs) text.append(decl);
+    for (std::string_view decl : view.prototypes) text.append(decl);
+    text.append("#endif\n");
+}
+
+// Loads every module `source` imports before anything else runs: their
+// mixins must be known to discovery and their keys to the cache lookup.
+void Transpiler::loadImports(std::string_view source, const std::filesystem::path& dir) {
+    if (source.find("@import") == std::string_view::npos) return;
+    // Rendered C per module, shared by every import that reaches it.
+    std::unordered_map<const Module*, std::string> rendered;
+    auto render = [&](auto& self, const Module& module) -> const std::string& {
+        if (auto it = rendered.find(&module); it != rendered.end()) return it->second;
+        std::vector<std::string> imports;
+        for (const Module* import : module.imports) imports.push_back(self(self, *import));
+        std::string text;
+        renderModule(module.view, imports, module.source.filename().string(), module.key, text);
+        return rendered.emplace(&module, std::move(text)).first->second;
+    };
+    auto addMixins = [&](auto& self, const Module& module) -> void {
+        for (const Module* import : module.imports) self(self, *import);
+        for (const InterfaceView::Mixin& mixin : module.view.mixins) {
+            auto [it, added] = m_sharedMixins.try_emplace(std::string(mixin.name));
+            if (added) it->second.assign(mixin.fields.begin(), mixin.fields.end());
+        }
+    };
+
+    forEachLine(source, [&](std::string_view line) {
+        std::string_view spelling;
+        if (!matchDirective(trimLeft(line), Keyword::Import, spelling)) return;
+        if (m_importText.count(std::string(spelling))) return;
+        const Module& module = loadModule(findModule(spelling, dir));
+        m_importKeys.push_back(module.key);
+        if (m_interface) m_interface->imports.emplace_back(spelling, module.key);
+        m_importText.emplace(spelling, render(render, module));
+        addMixins(addMixins, module);
+    });
+}
+
+// `@import "core/math"` names core/math.ox, relative to the importing file
+// and then to each import directory.
+std::filesystem::path Transpiler::findModule(std::string_view spelling, const std::filesystem::path& dir) const {
+    std::filesystem::path name(spelling);
+    if (!name.has_extension()) name += ".ox";
+    std::error_code ec;
+    if (name.is_absolute()) {
+        if (std::filesystem::is_regular_file(name, ec)) return name;
+    } else {
+        if (auto candidate = dir / name; std::filesystem::is_regular_file(candidate, ec)) return candidate;
+        for (const auto& importDir : m_config.import_dirs) {
+            if (auto candidate = importDir / name; std::filesystem::is_regular_file(candidate, ec)) return candidate;
+        }
+    }
+    throw std::runtime_error("module not found - " + std::string(spelling));
+}
+
+// Uses <module>.oxi when it was built from the current source against the
+// current versions of the module's imports; otherwise rebuilds and rewrites it.
+const Transpiler::Module& Transpiler::loadModule(const std::filesystem::path& path) {
+    std::error_code ec;
+    std::filesystem::path source = std::filesystem::weakly_canonical(path, ec);
+    if (ec) source = path;
+    if (auto it = m_modules.find(source.string()); it != m_modules.end()) return *it->second;
+    if (std::find(m_importStack.begin(), m_importStack.end(), source) != m_importStack.end()) {
+        throw std::runtime_error("import cycle through " + source.string());
+    }
+
+    MappedFile text;
+    if (!text.open(source)) throw std::runtime_error("failed to read module " + source.string());
+    m_dependencies.push_back(source);
+    const std::uint64_t sourceHash = Hasher().update(text.view()).digest();
+
+    auto module = std::make_unique<Module>();
+    module->source = source;
+    const std::filesystem::path interfacePath = std::filesystem::path(source).replace_extension(".oxi");
+    m_importStack.push_back(source);
+    try {
+        bool fresh = module->mapping.open(interfacePath) && parseInterface(module->mapping.view(), module->view) &&
+                     module->view.sourceHash == sourceHash;
+        for (std::size_t i = 0; fresh && i < module->view.imports.size(); ++i) {
+            const InterfaceView::Import& import = module->view.imports[i];
+            const Module& dependency = loadModule(findModule(import.spelling, source.parent_path()));
+            fresh = dependency.key == import.key;
+            module->imports.push_back(&dependency);
+        }
+
+        if (fresh) {
+            m_stats.modulesLoaded++;
+        } else {
+            module->mapping.close();
+            module->imports.clear();
+            InterfaceData data = buildInterface(source, text.view());
+            data.sourceHash = sourceHash;
+            module->built = serializeInterface(data);
+            parseInterface(module->built, module->view);
+            for (const InterfaceView::Import& import : module->view.imports) {
+                module->imports.push_back(&loadModule(findModule(import.spelling, source.parent_path())));
             }
-            if (depth == 0) {
-                insideMixin = false;
-                m_sharedMixins[currentMixinName] = currentMixinBody;
-            } else {
-                currentMixinBody += line + "\n";
+            // Best effort: an interface that cannot be stored is rebuilt next time.
+            const std::filesystem::path staging = uniqueSibling(interfacePath);
+            OutputWriter writer(module->built.size() + 1);
+            if (writer.open(staging)) {
+                writer.write(module->built);
+                if (!writer.close() || !commitOutput(staging, interfacePath)) std::filesystem::remove(staging, ec);
             }
+            m_stats.modulesBuilt++;
         }
+    } catch (...) {
+        m_importStack.pop_back();
+        throw;
+    }
+    m_importStack.pop_back();
+
+    Hasher key;
+    key.update(INTERFACE_SCHEMA).update(__DATE__ " " __TIME__).update(sourceHash);
+    for (const Module* import : module->imports) key.update(import->key);
+    module->key = key.digest();
+    return *m_modules.emplace(source.string(), std::move(module)).first->second;
+}
+
+// Runs the module through pass 2 without output, collecting its interface.
+InterfaceData Transpiler::buildInterface(const std::filesystem::path& source, std::string_view text) {
+    TranspilerConfig config = m_config;
+    config.parallel = false;
+    config.single_pass = false;
+    config.cache_dir.clear();
+    config.depfile.clear();
+    Transpiler builder(config);
+    builder.beginRun();
+    builder.m_importStack = m_importStack;
+    InterfaceData data;
+    builder.m_interface = &data;
+    builder.m_scanning = true; // only declarations matter, so skip call rewriting
+    try {
+        builder.loadImports(text, source.parent_path());
+        builder.run(text, source.filename().string());
+    } catch (const std::exception& e) {
+        throw std::runtime_error("in module " + source.string() + ": " + e.what());
     }
+    for (auto& [name, fields] : data.mixins) fields = builder.m_sharedMixins[name];
+    m_stats.modulesLoaded += builder.m_stats.modulesLoaded;
+    m_stats.modulesBuilt += builder.m_stats.modulesBuilt;
+    return data;
 }
 
-void Transpiler::pass2_Transpilation(const std::string& content) {
-    std::stringstream ss(content);
-    std::string line;
-    bool insideNative = false;
-
-    while (std::getline(ss, line)) {
-        if (std::regex_search(line, R_NATIVE_BLOCK)) {
-            insideNative = true;
-            // Check if it closes on same line
-            if (line.find('}') != std::string::npos) {
-                insideNative = false;
-                // Extract content: native { content } -> content
-                std::string raw = line;
-                raw = std::regex_replace(raw, R_NATIVE_BLOCK, ""); // Removes start
-                size_t endBrace = raw.rfind('}');
-                if (endBrace != std::string::npos) raw = raw.substr(0, endBrace);
-                
-                // Apply indentation for native block line
-                int indent = m_braceDepth;
-                std::string indentation = std::string(indent * 4, ' ');
-                m_outputLines.push_back(indentation + raw);
+// Records the parts of a module's output that importers need: includes,
+// struct typedefs and prototypes of its exported functions.
+void Transpiler::collect(const Node& node) {
+    InterfaceData& data = *m_interface;
+    switch (node.kind) {
+    case NodeKind::Include:
+        data.includes.emplace_back(node.text);
+        break;
+    case NodeKind::StructHead:
+        if (node.depth == 0) data.structs.push_back(renderNode(node));
+        break;
+    case NodeKind::Field:
+    case NodeKind::UseMixin:
+        if (m_inStruct && !data.structs.empty()) data.structs.back() += renderNode(node);
+        break;
+    case NodeKind::StructEnd:
+        if (node.depth == 0 && !data.structs.empty()) data.structs.back() += renderNode(node);
+        // The importer gets no layout prelude for these structs, so their
+        // headers travel with the interface.
+        if (node.layout) {
+            auto needs = [&data](std::string_view header) {
+                if (std::find(data.includes.begin(), data.includes.end(), header) == data.includes.end()) {
+                    data.includes.emplace_back(header);
+                }
+            };
+            if (node.layout->soa) needs("stdlib.h");
+            if (node.layout->checked) needs("stddef.h");
+        }
+        break;
+    case NodeKind::Function: {
+        // static and inline functions stay private to the module.
+        if (!node.definition || node.depth != 0 || node.name == "main") break;
+        if (node.mods.find("static") != std::string_view::npos || node.mods.find("inline") != std::string_view::npos) break;
+        Node declaration = node;
+        declaration.definition = false;
+        data.prototypes.push_back(renderNode(declaration));
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void Transpiler::pass1_Discovery(std::string_view content) {
+    forEachLine(content, [&](std::string_view line) { discoverLine(line); });
+}
+
+// Collects `shared` bodies and the members of @[soa] structs. Mixin fields
+// are translated once here rather than at every `use`.
+void Transpiler::discoverLine(std::string_view line) {
+    MixinDiscovery& d = m_discovery;
+    d.line++;
+    m_vectorTypes |= vectorTypesIn(line);
+    if (!m_usesRegions) m_usesRegions = mentionsRegions(line);
+    m_layoutHeaders |= layoutHeadersIn(line);
+    auto capture = [&d](std::string_view text) {
+        d.generic->emplace_back(text);
+        for (char c : text) {
+            if (c == '{') d.depth++;
+            else if (c == '}') d.depth--;
+        }
+        if (d.depth == 0) d.generic = nullptr;
+    };
+    if (d.generic) {
+        capture(line);
+        return;
+    }
+    const Token head = Lexer(line).peek();
+    if (!d.inside && (head.keyword() == Keyword::Struct || head.keyword() == Keyword::Resolve ||
+                      head.keyword() == Keyword::Shared)) {
+        std::string_view keyword, name;
+        std::vector<std::string_view> params;
+        if (matchGenericHead(trimLeft(line), keyword, name, params)) {
+            if (m_config.single_pass) {
+                throw std::runtime_error("generic " + std::string(name) + " needs the discovery pass; drop --single-pass");
             }
-            continue; // Don't print 'native {'
+            Generic& generic = m_generics[std::string(name)];
+            std::vector<std::string>* lines = &generic.sharedLines;
+            std::vector<std::string>* names = &generic.sharedParams;
+            if (head.keyword() == Keyword::Struct) {
+                lines = &generic.structLines;
+                names = &generic.structParams;
+                generic.attribute = std::move(d.pendingAttribute);
+            } else if (head.keyword() == Keyword::Resolve) {
+                lines = &generic.resolveLines;
+                names = &generic.resolveParams;
+            }
+            if (!lines->empty()) throw std::runtime_error(std::string(keyword) + " " + std::string(name) + "<...> defined twice");
+            names->assign(params.begin(), params.end());
+            d.pendingAttribute.clear();
+            d.depth = 0;
+            d.generic = lines;
+            capture(line);
+            return;
         }
-        if (insideNative) {
-            if (line.find('}') != std::string::npos) {
-                insideNative = false;
-            } else {
-                int nativeIndentDepth = m_braceDepth;
-                std::string nativeIndentation = std::string(nativeIndentDepth * 4, ' ');
-                std::string trimmedLine = std::regex_replace(line, std::regex(R"(^\s+)"), "");
-                m_outputLines.push_back(nativeIndentation + trimmedLine);
+    }
+    // Generic definitions are captured whole, so this only sees the rest.
+    if (closesBlock(line)) d.topDepth--;
+    if (d.topDepth <= 0) d.topLine = d.line;
+    if (opensBlock(line)) d.topDepth++;
+    if (m_header && d.functionLine) {
+        if (d.topDepth <= d.functionDepth) {
+            if (d.functionBody <= SMALL_FUNCTION_LINES) m_smallFunctions.insert(d.functionLine);
+            d.functionLine = 0;
+        } else if (!isBlank(line) && !head.is('#')) {
+            d.functionBody++;
+        }
+    } else if (m_header && opensBlock(line) && matchFunc(trimLeft(line))) {
+        d.functionLine = d.line;
+        d.functionDepth = d.topDepth - 1;
+        d.functionBody = 0;
+    }
+    // Const fns are defined once their body is complete; top-level constants
+    // as they come, to be evaluated when first used.
+    if (d.constLine) {
+        if (d.topDepth == 0) defineConstFunction();
+        else d.constBody.emplace_back(line);
+    } else if (d.topDepth == 1 && !d.inside && (head.keyword() == Keyword::Const || head.is("@[")) && opensBlock(line)) {
+        if (FuncDecl fn; matchFunc(trimLeft(line), fn) && fn.mods == "const") {
+            d.constLine = d.line;
+            d.constHead = trimLeft(line);
+            d.constBody.clear();
+        }
+    } else if (d.topDepth == 0 && !d.inside && head.keyword() == Keyword::Var) {
+        if (VarDecl var; matchVar(trimLeft(line), var) && var.mods == "const") {
+            m_comptime.defineConstant(std::string(var.name), var.type, var.extent, var.value);
+        }
+    }
+    if (!m_config.single_pass && !head.is('#') && line.find('<') != std::string_view::npos) {
+        GenericSpelling use;
+        for (std::size_t pos = 0; nextGenericSpelling(line, pos, use); pos = use.end) {
+            m_genericUses.emplace_back(line.substr(use.begin, use.end - use.begin), d.topLine);
+        }
+    }
+
+    if (!d.inside) {
+        std::string_view name, attr;
+        if (head.keyword() == Keyword::Shared && matchNamedBlock(line, Keyword::Shared, name)) {
+            d.inside = true;
+            d.soa = false;
+            d.depth = 1;
+            d.name = name;
+            d.pendingAttribute.clear();
+            return;
+        }
+        if (head.is("@[") && matchAttributeLine(line, attr)) {
+            if (!d.pendingAttribute.empty()) d.pendingAttribute += ", ";
+            d.pendingAttribute += attr;
+            return;
+        }
+        if (head.kind == TokenKind::End || head.is('#')) return;
+        StructDecl decl;
+        const bool isStruct = (head.keyword() == Keyword::Struct || head.is("@[")) && matchStruct(line, decl);
+        if (isStruct && (hasAttribute(decl.attr, "soa") || hasAttribute(d.pendingAttribute, "soa"))) {
+            d.inside = true;
+            d.soa = true;
+            d.depth = 1;
+            d.name = decl.name;
+            d.pendingAttribute.clear();
+            return;
+        }
+        d.pendingAttribute.clear();
+        return;
+    }
+
+    for (char c : line) {
+        if (c == '{') d.depth++;
+        else if (c == '}') d.depth--;
+    }
+    if (d.depth == 0) {
+        d.inside = false;
+        if (d.soa) m_soaStructs[d.name] = std::move(d.members);
+        else defineMixin(d.name, std::move(d.fields));
+        d.fields.clear();
+        d.members.clear();
+        return;
+    }
+    // A generic field type is spelled as its instantiation, which is known by
+    // the time the mixin is used.
+    std::string mangled;
+    if (line.find('<') != std::string_view::npos) {
+        GenericSpelling use;
+        std::size_t pos = 0;
+        for (; nextGenericSpelling(line, pos, use); pos = use.end) {
+            mangled.append(line.substr(pos, use.begin - pos)).append(mangleGeneric(line.substr(use.begin, use.end - use.begin)));
+        }
+        line = mangled.append(line.substr(pos));
+    }
+    if (std::string_view fieldName, fieldType; matchField(line, fieldName, fieldType)) {
+        if (d.soa) {
+            d.members.push_back({std::string(fieldName)});
+            return;
+        }
+        const Arena::Scope scratch(m_arena);
+        d.fields.push_back(std::string(translateType(fieldType)).append(" ").append(fieldName));
+    } else if (std::string_view mixin; d.soa && matchUse(line, mixin)) {
+        d.members.push_back({std::string(mixin), true});
+    }
+}
+
+void Transpiler::defineConstFunction() {
+    MixinDiscovery& d = m_discovery;
+    FuncDecl fn;
+    matchFunc(d.constHead, fn);
+    std::vector<std::pair<std::string, std::string>> params;
+    forEachArg(fn.args, [&](std::string_view name, std::string_view type) { params.emplace_back(name, type); });
+    std::vector<ConstStatement> body;
+    try {
+        std::size_t i = 0;
+        parseConstBlock(d.constBody, i, d.constLine + 1, body);
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error("const fn " + std::string(fn.name) + ": " + e.what());
+    }
+    m_comptime.defineFunction(std::string(fn.name), params, fn.ret, std::move(body), d.constLine);
+    d.constLine = 0;
+    d.constBody.clear();
+}
+
+void Transpiler::defineMixin(const std::string& name, std::vector<std::string> fields) {
+    if (m_unresolvedUses > 0) {
+        for (DeferredUse& use : m_deferredUses) {
+            if (use.text || use.mixin != name) continue;
+            use.text = renderNode(Node{.kind = NodeKind::UseMixin, .depth = use.depth, .fields = &fields});
+            m_unresolvedUses--;
+        }
+        if (m_unresolvedUses == 0) flushDeferred(false);
+    }
+    if (m_interface && std::none_of(m_interface->mixins.begin(), m_interface->mixins.end(),
+                                    [&name](const auto& mixin) { return mixin.first == name; })) {
+        m_interface->mixins.emplace_back(name, std::vector<std::string>{});
+    }
+    m_sharedMixins[name] = std::move(fields);
+}
+
+// Renders every instantiation the file uses, keyed by the top-level line of
+// its first use. Instantiations another one depends on come out before it.
+void Transpiler::instantiateGenerics() {
+    if (!m_generics.empty()) {
+        for (const auto& [spelling, line] : m_genericUses) {
+            std::string text;
+            instantiate(spelling, text);
+            if (!text.empty()) m_instances[line] += text;
+        }
+    }
+    m_genericUses.clear();
+}
+
+void Transpiler::instantiate(std::string_view spelling, std::string& out) {
+    GenericSpelling use;
+    if (!nextGenericSpelling(spelling, 0, use)) return;
+    for (std::string_view arg : use.args) {
+        if (arg.find('<') != std::string_view::npos) instantiate(arg, out);
+    }
+    const auto it = m_generics.find(std::string(use.name));
+    if (it == m_generics.end()) return;
+    const std::string mangled = mangleGeneric(spelling);
+    if (!m_instantiated.insert(mangled).second) return;
+
+    const Generic& generic = it->second;
+    if (!generic.sharedLines.empty()) {
+        const std::string body = substitute(generic.sharedLines, generic.sharedParams, use.args, out);
+        std::vector<std::string> fields;
+        forEachLine(body, [&](std::string_view line) {
+            if (std::string_view fieldName, fieldType; matchField(line, fieldName, fieldType)) {
+                const Arena::Scope scratch(m_arena);
+                fields.push_back(std::string(translateType(fieldType)).append(" ").append(fieldName));
             }
-            continue;
+        });
+        defineMixin(mangled, std::move(fields));
+    }
+    if (generic.structLines.empty() && generic.resolveLines.empty()) return;
+    std::string source;
+    if (!generic.attribute.empty()) source.append("@[").append(generic.attribute).append("]\n");
+    source += substitute(generic.structLines, generic.structParams, use.args, out);
+    source += substitute(generic.resolveLines, generic.resolveParams, use.args, out);
+    // Several headers may carry the same instance.
+    if (m_header) out.append("#ifndef ONYX_INSTANCE_").append(mangled).append("\n#define ONYX_INSTANCE_").append(mangled).append("\n");
+    out += renderInstance(source, mangled);
+    if (m_header) out += "#endif\n";
+}
+
+// The definition with its parameters replaced by `args` and every generic
+// spelling by its mangled name. Parameters inside generic spellings take the
+// Onyx spelling, so that Vec<T> becomes Vec_i32; elsewhere they take the C
+// type, which also serves expressions such as sizeof(T). Instantiations the
+// definition refers to are appended to `out` first.
+std::string Transpiler::substitute(const std::vector<std::string>& lines, const std::vector<std::string>& params,
+                                   const std::vector<std::string_view>& args, std::string& out) {
+    std::string text;
+    if (lines.empty()) return text;
+    if (params.size() != args.size()) {
+        const std::string_view head = trimLeft(lines.front());
+        throw std::runtime_error(std::string(head.substr(0, head.find('{'))) + "takes " + std::to_string(params.size()) +
+                                 " type parameter(s), given " + std::to_string(args.size()));
+    }
+    std::vector<std::string> cTypes;
+    for (std::string_view arg : args) {
+        const Arena::Scope scratch(m_arena);
+        cTypes.emplace_back(translateType(mangleGenerics(arg)));
+    }
+    auto replaceParams = [&params](std::string_view source, const auto& with, std::string& into) {
+        Lexer lex(source);
+        std::size_t copied = 0;
+        for (Token token = lex.next(); token.kind != TokenKind::End; token = lex.next()) {
+            const auto param = token.isWord() ? std::find(params.begin(), params.end(), token.text) : params.end();
+            if (param == params.end()) continue;
+            into.append(source.substr(copied, token.offset - copied)).append(with[param - params.begin()]);
+            copied = token.end();
         }
+        into.append(source.substr(copied));
+    };
 
-        if (std::regex_search(line, R_COMMENT)) {
-            int indent = m_braceDepth;
-            // Check if line starts with '}' to dedent? Comments usually follow context.
-            // But simple approach:
-            std::string indentation = std::string(indent * 4, ' ');
-            if (m_config.keep_comments) {
-                 // Trim original line to avoid double indent
-                 std::string trimmed = std::regex_replace(line, std::regex(R"(^\s+)"), "");
-                 m_outputLines.push_back(indentation + std::regex_replace(trimmed, R_COMMENT, "//"));
+    std::string line, spelling;
+    for (const std::string& source : lines) {
+        line.clear();
+        GenericSpelling use;
+        std::size_t pos = 0;
+        for (std::size_t from = 0; nextGenericSpelling(source, from, use);) {
+            if (!m_generics.count(std::string(use.name))) {
+                from = use.begin + use.name.size() + 1;
+                continue;
             }
-            continue;
+            line.append(source, pos, use.begin - pos);
+            spelling.clear();
+            replaceParams(std::string_view(source).substr(use.begin, use.end - use.begin), args, spelling);
+            instantiate(spelling, out);
+            line += mangleGeneric(spelling);
+            pos = from = use.end;
         }
-        
-        // Attribute lines (capture)
-        std::smatch attrMatch;
-        if (std::regex_search(line, attrMatch, R_ATTRIBUTE_LINE)) {
-             if (!m_pendingAttribute.empty()) m_pendingAttribute += ", ";
-             m_pendingAttribute += attrMatch[1].str();
-             continue;
+        line.append(source, pos);
+        replaceParams(line, cTypes, text);
+        text += "\n";
+    }
+    return text;
+}
+
+// Transpiles an instantiation's source on its own, with the mixins and
+// @[soa] structs of this file in view.
+std::string Transpiler::renderInstance(std::string_view source, std::string_view name) {
+    TranspilerConfig config = m_config;
+    config.parallel = false;
+    config.cache_dir.clear();
+    config.depfile.clear();
+    config.layout_report = false;
+    config.line_directives = false;
+    config.source_map.clear();
+    config.instrument = false;
+    config.profile = nullptr;
+    Transpiler instance(config);
+    instance.beginRun();
+    instance.m_sharedMixins = m_sharedMixins;
+    instance.m_soaStructs = m_soaStructs;
+    std::string text;
+    OutputWriter writer(0); // string sink
+    writer.open(text);
+    instance.m_output = &writer;
+    instance.m_scanning = m_scanning;
+    instance.m_inlineInstanceMethods = m_header != nullptr;
+    try {
+        instance.pass1_Discovery(source);
+        instance.m_symbols.pushScope();
+        instance.pass2_Transpilation(source);
+    } catch (const std::exception& e) {
+        throw std::runtime_error("in instantiation " + std::string(name) + ": " + e.what());
+    }
+    m_diagnostics.insert(m_diagnostics.end(), instance.m_diagnostics.begin(), instance.m_diagnostics.end());
+    return text;
+}
+
+// Writes the node's lines, each behind a #line directive unless the
+// compiler's running count already names the source line. Every line of a
+// node that expands to several (mixin fields, SoA helpers) maps to the
+// source line that produced it.
+void Transpiler::emitMapped(const Node& node) {
+    if (rendersEmpty(node)) return;
+    m_rendered.clear();
+    OutputWriter rendered(0);
+    rendered.open(m_rendered);
+    emitNode(rendered, node);
+
+    forEachLine(m_rendered, [&](std::string_view line) {
+        if (m_lineNumber != m_nextLine && !isBlank(line)) {
+            m_output->write("#line ");
+            m_output->write(std::to_string(m_lineNumber));
+            m_output->write(" \"");
+            for (char c : m_sourcePath) {
+                if (c == '"' || c == '\\') m_output->write("\\");
+                m_output->write(std::string_view(&c, 1));
+            }
+            m_output->write("\"\n");
+            m_nextLine = m_lineNumber;
         }
-        
-        std::string processed = processLine(line);
-        if (!processed.empty()) m_outputLines.push_back(processed);
+        m_output->write(line);
+        m_output->write("\n");
+        if (m_nextLine) m_nextLine++;
+    });
+}
+
+// Holds back output from here on and records where the use's text goes once
+// its mixin is known.
+void Transpiler::deferUse(std::string mixin, int depth, std::string fallback) {
+    if (!m_streamOutput) {
+        m_streamOutput = m_output;
+        m_deferredOutput.clear();
+        m_deferredWriter.open(m_deferredOutput);
+        m_output = &m_deferredWriter;
     }
+    m_deferredUses.push_back({m_deferredOutput.size(), std::move(mixin), depth, std::move(fallback), {}});
+    m_unresolvedUses++;
 }
 
-std::string Transpiler::processLine(const std::string& line) {
+// Writes held-back output with every use patched in. At end of input, uses
+// whose mixin never appeared keep their fallback text.
+void Transpiler::flushDeferred(bool final) {
+    if (!m_streamOutput || (m_unresolvedUses > 0 && !final)) return;
+    OutputWriter* out = std::exchange(m_streamOutput, nullptr);
+    m_deferredWriter.close();
+    m_output = out;
+
+    std::size_t written = 0;
+    for (const DeferredUse& use : m_deferredUses) {
+        const std::string& text = use.text ? *use.text : use.fallback;
+        out->write(std::string_view(m_deferredOutput).substr(written, use.offset - written));
+        out->write(text);
+        written = use.offset;
+    }
+    out->write(std::string_view(m_deferredOutput).substr(written));
+    m_deferredUses.clear();
+    m_deferredOutput.clear();
+    m_unresolvedUses = 0;
+}
+
+void Transpiler::transpileLine(std::string_view line) {
+    const Arena::Scope scratch(m_arena); // nodes die with the line once emitted
+    // Parallel chunks start at top-level declarations with no idea of what
+    // came before, so every such line restates its position.
+    if (m_lineDirectives && atTopLevel() && startsDeclaration(line)) m_nextLine = 0;
+    if (m_genericDepth > 0) {
+        for (char c : line) {
+            if (c == '{') m_genericDepth++;
+            else if (c == '}') m_genericDepth--;
+        }
+        return;
+    }
+    if (!m_instances.empty() && !m_insideNative) {
+        if (const auto it = m_instances.find(m_lineNumber); it != m_instances.end()) {
+            emit(Node{.kind = NodeKind::Instance, .text = it->second});
+        }
+    }
+    if (!m_generics.empty()) {
+        std::string_view keyword, name;
+        std::vector<std::string_view> params;
+        if (matchGenericHead(trimLeft(line), keyword, name, params)) {
+            // The definition itself emits nothing; instantiations come out where they are first used.
+            std::string spelling(name);
+            for (std::string_view param : params) spelling.append(spelling.size() == name.size() ? "<" : ", ").append(param);
+            spelling += ">";
+            checkDepth(m_braceDepth);
+            emit(Node{.kind = NodeKind::GenericHead, .depth = m_braceDepth, .name = spelling, .mods = keyword});
+            m_pendingAttribute = "";
+            for (char c : line) {
+                if (c == '{') m_genericDepth++;
+                else if (c == '}') m_genericDepth--;
+            }
+            return;
+        }
+    }
+    std::size_t nativeBody = 0;
+    if (matchNative(line, nativeBody)) {
+        m_insideNative = true;
+        // Check if it closes on same line
+        if (line.find('}') != std::string_view::npos) {
+            m_insideNative = false;
+            // Extract content: native { content } -> content
+            std::string_view raw = line.substr(nativeBody);
+            size_t endBrace = raw.rfind('}');
+            if (endBrace != std::string_view::npos) raw = raw.substr(0, endBrace);
+            
+            // Apply indentation for native block line
+            checkDepth(m_braceDepth);
+            emit(Node{.kind = NodeKind::Native, .depth = m_braceDepth, .text = raw});
+        }
+        return; // Don't print 'native {'
+    }
+    if (m_insideNative) {
+        if (line.find('}') != std::string_view::npos) {
+            m_insideNative = false;
+        } else {
+            checkDepth(m_braceDepth);
+            emit(Node{.kind = NodeKind::Native, .depth = m_braceDepth, .text = trimLeft(line)});
+        }
+        return;
+    }
+
+    if (matchComment(line)) {
+        if (m_config.keep_comments) {
+             // Trim original line to avoid double indent; '#' becomes '//'
+             checkDepth(m_braceDepth);
+             emit(Node{.kind = NodeKind::Comment, .depth = m_braceDepth, .text = trimLeft(line).substr(1)});
+        }
+        return;
+    }
+    
+    // Attribute lines (capture)
+    std::string_view attr;
+    if (matchAttributeLine(line, attr)) {
+         if (!m_pendingAttribute.empty()) m_pendingAttribute += ", ";
+         m_pendingAttribute += attr;
+         return;
+    }
+    
+    const Node* node = processLine(line);
+    if (m_pendingUse) {
+        auto [mixin, depth] = std::move(*std::exchange(m_pendingUse, std::nullopt));
+        deferUse(std::move(mixin), depth, node ? renderNode(*node) : std::string());
+        m_nextLine = 0; // the use's line count is not known yet
+        return;
+    }
+    if (node) emit(*node);
+    if (node && node->kind == NodeKind::For && !node->name.empty()) {
+        const std::string_view element = m_arena.concat({node->type, " ", node->name, " = *onyx_at_", node->name});
+        emit(Node{.kind = NodeKind::Line, .depth = node->depth + 1, .text = element, .semicolon = true});
+    }
+    if (node && node->kind == NodeKind::Function && node->definition && m_config.instrument) {
+        const std::string_view count = m_arena.concat({"onyx_prof_fn[", std::to_string(m_lineNumber), "]++"});
+        emit(Node{.kind = NodeKind::Line, .depth = node->depth + 1, .text = count, .semicolon = true});
+    }
+    if (m_headerSection == HeaderSection::Body && m_braceDepth == m_headerEnd) m_headerSection = HeaderSection::None;
+}
+
+struct Transpiler::Chunk {
+    std::size_t begin = 0; // byte range of whole lines in the source
+    std::size_t end = 0;
+    std::size_t firstLine = 1;
+    PassState state;       // state on entry, as the serial pass would have it
+    std::string output;
+    HeaderParts header;
+    TranspileStats stats;
+    std::vector<std::string> diagnostics;
+    std::vector<StructLayout> layouts;
+    std::exception_ptr error;
+    std::atomic<bool> done{false};
+};
+
+void Transpiler::pass2_Transpilation(std::string_view content) {
+    if (m_pool && m_config.parallel && !m_config.single_pass && content.size() > 0) {
+        pass2_Parallel(content);
+        return;
+    }
+    if (m_config.single_pass) {
+        forEachLine(content, [&](std::string_view line) {
+            m_lineNumber++;
+            discoverLine(line);
+            transpileLine(line);
+        });
+        flushDeferred(true);
+        return;
+    }
+    forEachLine(content, [&](std::string_view line) {
+        m_lineNumber++;
+        transpileLine(line);
+    });
+}
+
+// Splits the file at top-level declarations and transpiles the pieces on the
+// pool. A serial scan runs only the lines that can change pass state (block
+// openers/closers, declarations, attributes, native blocks), and merely
+// follows the braces through function bodies, to capture the exact state
+// each chunk starts from, so the stitched output is identical to the serial
+// pass. Chunks are written out in order as they complete, keeping at most a
+// few per worker in memory.
+void Transpiler::pass2_Parallel(std::string_view content) {
+    const std::size_t maxInFlight = m_pool->size() * 4;
+    std::deque<std::unique_ptr<Chunk>> inFlight;
+    TaskGroup group(*m_pool);
+    // The chunks' counters, kept apart from whatever the scan counts.
+    TranspileStats counted;
+
+    auto drain = [&](std::size_t keep) {
+        while (inFlight.size() > keep) {
+            Chunk& front = *inFlight.front();
+            group.wait([&front] { return front.done.load(); });
+            if (front.error) std::rethrow_exception(front.error);
+            if (m_output) m_output->write(front.output);
+            if (m_header) {
+                m_header->types += front.header.types;
+                m_header->prototypes += front.header.prototypes;
+                m_header->bodies += front.header.bodies;
+            }
+            counted.merge(front.stats);
+            m_diagnostics.insert(m_diagnostics.end(), front.diagnostics.begin(), front.diagnostics.end());
+            std::move(front.layouts.begin(), front.layouts.end(), std::back_inserter(m_layouts));
+            inFlight.pop_front();
+        }
+    };
+    auto submit = [&](std::size_t begin, std::size_t end, std::size_t firstLine, PassState state) {
+        auto chunk = std::make_unique<Chunk>();
+        chunk->begin = begin;
+        chunk->end = end;
+        chunk->firstLine = firstLine;
+        chunk->state = std::move(state);
+        Chunk* raw = chunk.get();
+        inFlight.push_back(std::move(chunk));
+        counted.chunks++;
+        group.run([this, raw, content] {
+            runChunk(*raw, content);
+            raw->done.store(true);
+        });
+    };
+
+    std::size_t chunkBegin = 0;
+    std::size_t chunkFirstLine = m_lineNumber + 1;
+    std::size_t chunkLines = 0;
+    PassState chunkState = saveState();
+    OutputWriter* output = std::exchange(m_output, nullptr);
+    const TranspileStats entry = m_stats;
+    m_scanning = true;
+
+    try {
+        forEachLine(content, [&](std::string_view line) {
+            const std::size_t offset = static_cast<std::size_t>(line.data() - content.data());
+            m_lineNumber++;
+            if (chunkLines >= m_config.chunk_lines && atTopLevel() && startsDeclaration(line)) {
+                submit(chunkBegin, offset, chunkFirstLine, std::exchange(chunkState, saveState()));
+                chunkBegin = offset;
+                chunkFirstLine = m_lineNumber;
+                chunkLines = 0;
+                if (inFlight.size() > maxInFlight) {
+                    m_output = output;
+                    drain(maxInFlight);
+                    m_output = nullptr;
+                }
+            }
+            if (!skimBodyLine(line) && (m_insideNative || !isInertLine(line))) transpileLine(line);
+            chunkLines++;
+        });
+    } catch (...) {
+        // Nothing is lost by dropping the error here. The scan does a subset
+        // of the serial work from the same state, so whatever it threw, the
+        // remainder chunk (run from the last good boundary) throws again at
+        // the same line with the diagnostic the serial pass would give.
+    }
+
+    m_scanning = false;
+    m_output = output;
+    // Only the chunks count, so --stats reads the same for any split.
+    m_stats = entry;
+    submit(chunkBegin, content.size(), chunkFirstLine, std::move(chunkState));
+    try {
+        drain(0);
+    } catch (...) {
+        group.wait();
+        m_stats.merge(counted);
+        throw;
+    }
+    m_stats.merge(counted);
+}
+
+void Transpiler::runChunk(Chunk& chunk, std::string_view content) const {
+    Transpiler worker(m_config);
+    worker.m_sharedMixins = m_sharedMixins;
+    worker.m_soaStructs = m_soaStructs;
+    worker.m_generics = m_generics;
+    worker.m_instances = m_instances;
+    worker.m_comptime = m_comptime;
+    worker.m_importText = m_importText;
+    worker.restoreState(std::move(chunk.state));
+    worker.m_sourcePath = m_sourcePath;
+    worker.m_lineNumber = chunk.firstLine - 1;
+    worker.m_profile = m_profile;
+    worker.m_smallFunctions = m_smallFunctions;
+    if (m_header) worker.m_header = &chunk.header;
+    OutputWriter writer(0); // string sink
+    writer.open(chunk.output);
+    worker.m_output = &writer;
+    AllocationScope allocations(worker.m_stats.bytesAllocated);
+    try {
+        forEachLine(content.substr(chunk.begin, chunk.end - chunk.begin),
+                    [&](std::string_view line) {
+                        worker.m_lineNumber++;
+                        worker.transpileLine(line);
+                    });
+    } catch (...) {
+        chunk.error = std::current_exception();
+    }
+    chunk.stats = worker.m_stats;
+    chunk.diagnostics = std::move(worker.m_diagnostics);
+    chunk.layouts = std::move(worker.m_layouts);
+}
+
+Transpiler::PassState Transpiler::saveState() const {
+    PassState state;
+    state.symbols = m_symbols.snapshot();
+    state.currentResolveType = m_currentResolveType;
+    state.braceDepth = m_braceDepth;
+    state.pendingAttribute = m_pendingAttribute;
+    state.currentStructAttribute = m_currentStructAttribute;
+    state.inShared = m_inShared;
+    state.sharedStartDepth = m_sharedStartDepth;
+    state.inStruct = m_inStruct;
+    state.structStartDepth = m_structStartDepth;
+    state.currentStructName = m_currentStructName;
+    state.structLayout = m_structLayout;
+    state.hotFields = m_hotFields;
+    state.structTypes = m_structTypes;
+    state.soaFields = m_soaFields;
+    state.insideNative = m_insideNative;
+    state.genericDepth = m_genericDepth;
+    return state;
+}
+
+void Transpiler::restoreState(PassState state) {
+    m_symbols.restore(state.symbols);
+    m_currentResolveType = std::move(state.currentResolveType);
+    m_braceDepth = state.braceDepth;
+    m_pendingAttribute = std::move(state.pendingAttribute);
+    m_currentStructAttribute = std::move(state.currentStructAttribute);
+    m_inShared = state.inShared;
+    m_sharedStartDepth = state.sharedStartDepth;
+    m_inStruct = state.inStruct;
+    m_structStartDepth = state.structStartDepth;
+    m_currentStructName = std::move(state.currentStructName);
+    m_structLayout = std::move(state.structLayout);
+    m_hotFields = std::move(state.hotFields);
+    m_structTypes = std::move(state.structTypes);
+    m_soaFields = std::move(state.soaFields);
+    m_insideNative = state.insideNative;
+    m_genericDepth = state.genericDepth;
+}
+
+bool Transpiler::atTopLevel() const {
+    return m_braceDepth == 0 && !m_insideNative && m_genericDepth == 0 && !m_inShared && !m_inStruct &&
+           m_currentResolveType.empty() && m_pendingAttribute.empty();
+}
+
+// True for lines whose handling cannot change pass state: no block brace, no
+// declaration keyword. Only their output depends on the state.
+bool Transpiler::isInertLine(std::string_view line) const {
+    if (m_inStruct) return false; // fields feed the layouts of later structs
+    if (m_genericDepth > 0) return false;
+    const Token head = Lexer(line).peek();
+    if (head.is('}') || head.is("@[")) return false;
+    switch (head.keyword()) {
+    case Keyword::Native: case Keyword::Shared: case Keyword::Struct: case Keyword::Resolve:
+    case Keyword::Fn: case Keyword::Inline: case Keyword::Extern: case Keyword::Static: case Keyword::Const:
+    case Keyword::Var:
+        return false;
+    default:
+        return !opensBlock(line);
+    }
+}
+
+// Follows a line of a function body for the boundary scan without
+// transpiling it. Statements there only move the brace depth and the scope
+// stack, and the function's closing brace pops whatever they declared, so
+// no boundary state depends on them. False for lines the scan must run in
+// full: declarations, attributes, native blocks, regions and pools.
+bool Transpiler::skimBodyLine(std::string_view line) {
+    if (m_braceDepth <= (m_currentResolveType.empty() ? 0 : 1)) return false; // top level or a resolve's methods
+    if (m_inStruct || m_inShared || m_insideNative || m_genericDepth > 0 || !m_pendingAttribute.empty()) return false;
+    if (matchComment(line)) return true;
+    const std::string_view out = trimLeft(line);
+    const Token head = Lexer(out).peek();
+    if (head.is("@[")) return false;
+    switch (head.keyword()) {
+    case Keyword::None: case Keyword::Var:
+    case Keyword::If: case Keyword::While: case Keyword::Loop: case Keyword::For:
+        break;
+    default:
+        return false;
+    }
+    if (closesBlock(out)) {
+        m_braceDepth--;
+        m_symbols.popScope();
+    }
+    if (opensBlock(out)) openBlock();
+    return true;
+}
+
+bool Transpiler::startsDeclaration(std::string_view line) const {
+    const Token head = Lexer(line).peek();
+    if (head.is("@[")) return true;
+    switch (head.keyword()) {
+    case Keyword::Native: case Keyword::Shared: case Keyword::Struct: case Keyword::Resolve:
+    case Keyword::Fn: case Keyword::Inline: case Keyword::Extern: case Keyword::Static: case Keyword::Const:
+        return true;
+    default:
+        return false;
+    }
+}
+
+const Node* Transpiler::processLine(std::string_view line) {
     // Trim leading whitespace
-    std::string out = std::regex_replace(line, std::regex(R"(^\s+)"), "");
-    std::smatch match;
+    std::string_view out = trimLeft(line);
     
     // Handle Includes
-    if (std::regex_search(out, match, R_INCLUDE)) {
+    if (std::string_view spelling; matchDirective(out, Keyword::Import, spelling)) {
+        // Every import was loaded up front; the line expands to its module's C.
+        const auto it = m_importText.find(std::string(spelling));
+        if (it == m_importText.end()) throw std::runtime_error("module not loaded - " + std::string(spelling));
+        return m_arena.make<Node>(Node{.kind = NodeKind::Import, .text = it->second});
+    }
+    if (std::string_view path; matchDirective(out, Keyword::Include, path)) {
         // @include "..." -> #include "..."
         // Typically includes are at top level, braceDepth 0.
-        return "#include \"" + match[1].str() + "\"";
+        return m_arena.make<Node>(Node{.kind = NodeKind::Include, .text = path});
     }
 
     // Strict brace detection
-    bool opensBrace = std::regex_search(out, std::regex(R"(\{\s*$)")) || std::regex_search(out, std::regex(R"(^\s*\{)"));
-    bool startsClosing = std::regex_search(out, std::regex(R"(^\})"));
-    bool closesBrace = std::regex_search(out, std::regex(R"(^\s*\})")); // Same as startsClosing for now
+    const bool opensBrace = opensBlock(out);
+    const bool closesBrace = closesBlock(out);
 
     // Calculate Indentation
     int printDepth = m_braceDepth;
-    if (startsClosing && printDepth > 0) printDepth--;
+    if (closesBrace && printDepth > 0) printDepth--;
 
     // Un-indent for resolve blocks
     if (!m_currentResolveType.empty() && printDepth > 0) {
         printDepth--;
     }
+    checkDepth(printDepth);
+    auto node = [&](NodeKind kind) {
+        Node* n = m_arena.make<Node>();
+        n->kind = kind;
+        n->depth = printDepth;
+        return n;
+    };
 
-    std::string indentation = std::string(printDepth * 4, ' ');
-
+    if (!m_generics.empty() && out.find('<') != std::string_view::npos) out = mangleGenerics(out);
     // Replace self. with self->
-    if (out.find("self.") != std::string::npos) {
-        out = std::regex_replace(out, std::regex("self\\."), "self->");
-    }
+    out = replaceAll(m_arena, out, "self.", "self->");
+    if (!m_soaFields.empty()) out = indexFields(m_arena, out, m_soaFields);
+    if (out.find("alloc") != std::string_view::npos) out = rewriteAllocs(out);
+    if (!m_scanning && out.find("comptime") != std::string_view::npos) out = foldComptime(out);
     
     // --- Closing Contexts ---
     if (closesBrace) {
@@ -203,286 +2033,678 @@ std::string Transpiler::processLine(const std::string& line) {
         if (m_inShared && m_braceDepth == m_sharedStartDepth) {
             m_inShared = false;
             if (m_braceDepth >= 0) m_symbols.popScope();
-            return ""; // Don't print closing brace for shared mixin
+            return nullptr; // Don't print closing brace for shared mixin
         }
         if (m_inStruct && m_braceDepth == m_structStartDepth) {
             m_inStruct = false;
-            out = "} " + m_currentStructName;
-            if (!m_currentStructAttribute.empty()) {
-                out += " __attribute__((" + m_currentStructAttribute + "))";
-                m_currentStructAttribute = "";
-            }
-            out += ";";
-            return indentation + out;
+            endStruct();
+            Node* end = node(NodeKind::StructEnd);
+            end->name = m_arena.copy(m_currentStructName);
+            end->attr = m_arena.copy(m_currentStructAttribute);
+            const StructLayout& layout = m_structLayout;
+            if (layout.soa || layout.reordered || layout.checked) end->layout = &layout;
+            m_currentStructAttribute = "";
+            return end;
         }
         
         // Resolve Block End
         if (!m_currentResolveType.empty() && m_braceDepth == 0) {
              m_currentResolveType = "";
+             m_soaFields.clear();
              if (m_braceDepth >= 0) m_symbols.popScope();
-             return indentation + "// end resolve";
+             return node(NodeKind::ResolveEnd);
         }
         
         if (m_braceDepth >= 0) m_symbols.popScope();
     }
 
-    if (std::regex_search(out, match, R_SHARED_START)) {
+    // Dispatch on the leading keyword
+    const Token head = Lexer(out).peek();
+    const Keyword keyword = head.keyword();
+    const bool attributed = head.is("@[");
+
+    std::string_view name;
+    if (keyword == Keyword::Shared && matchNamedBlock(out, Keyword::Shared, name)) {
         m_inShared = true;
         m_sharedStartDepth = m_braceDepth;
-        std::string attrMsg = "";
-        if (!m_pendingAttribute.empty()) {
-            attrMsg = " [attributes: " + m_pendingAttribute + "]";
-            m_pendingAttribute = ""; // Consumed
-        }
-        if (opensBrace) m_braceDepth++;
-        return indentation + "// shared " + match[1].str() + " (elided)" + attrMsg;
+        Node* shared = node(NodeKind::SharedHead);
+        shared->name = name;
+        shared->attr = m_arena.copy(m_pendingAttribute);
+        m_pendingAttribute = ""; // Consumed
+        if (opensBrace) openBlock();
+        return shared;
     }
     if (m_inShared) {
-        if (opensBrace) m_braceDepth++;
-        return ""; 
+        if (opensBrace) openBlock();
+        return nullptr;
     }
 
-    if (std::regex_search(out, match, R_STRUCT_START)) {
+    if (StructDecl decl; (keyword == Keyword::Struct || attributed) && matchStruct(out, decl)) {
         m_inStruct = true;
         m_structStartDepth = m_braceDepth;
-        // Group 1: Attr, Group 2: Name
-        std::string attr = match[1].str();
+        std::string attr(decl.attr);
         if (attr.empty()) attr = m_pendingAttribute;
         else if (!m_pendingAttribute.empty()) attr = m_pendingAttribute + ", " + attr;
         m_pendingAttribute = ""; // Consumed
+        beginStruct(decl.name, attr);
         m_currentStructAttribute = attr;
 
-        m_currentStructName = match[2].str();
-        if (opensBrace) m_braceDepth++;
-        return indentation + "typedef struct " + m_currentStructName + " {";
+        m_currentStructName = decl.name;
+        if (opensBrace) m_braceDepth++; // its closing brace pops no scope
+        Node* head = node(NodeKind::StructHead);
+        head->name = decl.name;
+        return head;
     }
     
-    if (std::regex_search(out, match, R_USE_MIXIN)) {
-        std::string mixinName = match[1].str();
-        if (m_sharedMixins.count(mixinName)) {
-            std::stringstream bodySS(m_sharedMixins[mixinName]);
-            std::string bodyLine, injected;
-            while(std::getline(bodySS, bodyLine)) {
-                 if (bodyLine.empty()) continue;
-                 std::smatch fieldMatch;
-                 if (std::regex_search(bodyLine, fieldMatch, R_FIELD)) {
-                     injected += indentation + translateType(fieldMatch[2].str()) + " " + fieldMatch[1].str() + ";\n";
-                 }
+    if (keyword == Keyword::Use && matchUse(out, name)) {
+        if (auto mixin = m_sharedMixins.find(std::string(name)); mixin != m_sharedMixins.end()) {
+            // use doesn't open braces.
+            Node* use = node(NodeKind::UseMixin);
+            use->fields = &mixin->second;
+            if (m_inStruct) {
+                for (const std::string& field : mixin->second) {
+                    const std::size_t space = field.rfind(' ');
+                    addStructField(std::string_view(field).substr(0, space), std::string_view(field).substr(space + 1));
+                }
+                if (m_structLayout.reordered) return nullptr; // emitted with the struct's end
             }
-            // R_USE_MIXIN doesn't open braces.
-            return injected;
+            return use;
         }
+        if (m_inStruct && (m_structLayout.soa || m_structLayout.reordered)) {
+            throw std::runtime_error("struct " + m_currentStructName + " uses unknown mixin " + std::string(name));
+        }
+        if (m_inStruct && m_structLayout.known()) m_structLayout.unknownType = "use " + std::string(name);
+        // Possibly a forward reference; transpileLine defers it with whatever
+        // the rest of this function makes of the line as its fallback.
+        if (m_config.single_pass) m_pendingUse.emplace(name, printDepth);
     }
 
-    if (m_inStruct && !std::regex_search(out, R_FUNC_SIGNATURE) && !closesBrace) { 
-        if (std::regex_search(out, match, R_FIELD)) {
-             return indentation + translateType(match[2].str()) + " " + match[1].str() + ";";
+    if (m_inStruct && head.isWord() && !closesBrace && !matchFunc(out)) { 
+        if (std::string_view fieldName, fieldType; matchField(out, fieldName, fieldType)) {
+            Node* field = node(NodeKind::Field);
+            field->name = fieldName;
+            field->type = translateType(fieldType);
+            addStructField(field->type, fieldName);
+            if (m_structLayout.reordered) return nullptr; // emitted with the struct's end
+            return field;
         }
     }
 
-    if (std::regex_search(out, match, R_RESOLVE_START)) {
-        m_currentResolveType = match[1].str();
-        if (opensBrace) m_braceDepth++;
-        return indentation + "// resolve " + m_currentResolveType;
+    if (keyword == Keyword::Resolve && matchNamedBlock(out, Keyword::Resolve, name)) {
+        m_currentResolveType = name;
+        m_soaFields = soaFieldNames(m_currentResolveType);
+        if (opensBrace) openBlock();
+        Node* resolve = node(NodeKind::ResolveHead);
+        resolve->name = name;
+        return resolve;
+    }
+
+    std::string_view poolType;
+    if ((keyword == Keyword::Region && matchNamedBlock(out, Keyword::Region, name)) ||
+        (keyword == Keyword::Pool && matchPool(out, name, poolType))) {
+        if (m_braceDepth == 0 || m_inStruct) {
+            throw std::runtime_error(std::string(keyword == Keyword::Region ? "region " : "pool ") + std::string(name) +
+                                     " outside a function");
+        }
+        openBlock();
+        Node* block = node(NodeKind::Region);
+        block->name = name;
+        if (keyword == Keyword::Pool) block->type = translateType(poolType);
+        m_symbols.add(name, keyword == Keyword::Region ? "onyx_region" : "onyx_pool");
+        return block;
     }
 
-    if (std::regex_search(out, match, R_FUNC_SIGNATURE)) {
-        bool isDefinition = line.find('{') != std::string::npos;
+    FuncDecl fn;
+    const bool fnHead = keyword == Keyword::Fn || keyword == Keyword::Inline || keyword == Keyword::Extern ||
+                        keyword == Keyword::Static || keyword == Keyword::Const || attributed;
+    if (fnHead && matchFunc(out, fn)) {
+        Node* func = node(NodeKind::Function);
+        func->definition = line.find('{') != std::string_view::npos;
 
         // Common logic for both declaration and definition
-        std::string attr = match[1].str();
-        if (isDefinition) { // Only consume pending attributes for definitions for now
-             if (attr.empty()) attr = m_pendingAttribute;
-             else if (!m_pendingAttribute.empty()) attr = m_pendingAttribute + ", " + attr;
+        func->attr = fn.attr;
+        if (func->definition) { // Only consume pending attributes for definitions for now
+             if (func->attr.empty()) func->attr = m_arena.copy(m_pendingAttribute);
+             else if (!m_pendingAttribute.empty()) func->attr = m_arena.concat({m_pendingAttribute, ", ", fn.attr});
              m_pendingAttribute = "";
         }
-
-        std::string mods = match[2].str();
-        std::string name = match[3].str();
-        std::string args = match[4].str();
-        std::string ret_onyx = match[5].str(); // Capture the raw Onyx return type
-        std::string ret_c;
-        if (ret_onyx.empty()) {
-            ret_c = "void"; // Default to void if no return type specified
-        } else {
-            ret_c = translateType(ret_onyx); // Translate if a type was specified
+        if (func->definition && m_profile && !hasAttribute(func->attr, "hot") && !hasAttribute(func->attr, "cold")) {
+            const std::string_view temperature = m_profile->hot(m_lineNumber) ? "hot" : m_profile->cold(m_lineNumber) ? "cold" : "";
+            if (!temperature.empty()) {
+                func->attr = func->attr.empty() ? temperature : m_arena.concat({func->attr, ", ", temperature});
+            }
         }
 
-        std::vector<std::string> cArgs;
+        func->name = fn.name;
+        func->mods = fn.mods;
+        if (fn.mods == "const") {
+            // Pure by construction; instrumented bodies write their counters.
+            func->mods = {};
+            if (!m_config.instrument) func->attr = func->attr.empty() ? "const" : m_arena.concat({func->attr, ", const"});
+        }
+        func->type = fn.ret.empty() ? "void" : translateType(fn.ret); // Default to void if no return type specified
 
-        if (!m_currentResolveType.empty()) {
-            name = m_currentResolveType + "_" + name;
+        m_params.clear();
+        if (!m_currentResolveType.empty() && m_soaStructs.count(m_currentResolveType)) {
+            // Methods of an @[soa] struct act on one element of its container.
+            func->owner = m_arena.concat({m_currentResolveType, "SoA"});
+            m_symbols.add("self", func->owner);
+            m_params.push_back({m_arena.concat({func->owner, "*"}), "self"});
+            m_params.push_back({"size_t", "index"});
+        } else if (!m_currentResolveType.empty()) {
+            func->owner = m_arena.copy(m_currentResolveType);
             m_symbols.add("self", m_currentResolveType);
-            cArgs.push_back(m_currentResolveType + "* self");
-        }
-
-        std::regex argSplit(R"(\s*,\s*)");
-        std::sregex_token_iterator iter(args.begin(), args.end(), argSplit, -1);
-        std::sregex_token_iterator end;
-        for (; iter != end; ++iter) {
-            std::string arg = *iter;
-            if (arg.empty()) continue;
-            std::smatch argMatch;
-            static const std::regex R_ARG(R"((\w+)\s*:\s*([\w\*]+))");
-            if (std::regex_search(arg, argMatch, R_ARG)) {
-                std::string argName = argMatch[1].str();
-                if (!m_currentResolveType.empty() && argName == "self") {
-                    continue;
-                }
-                cArgs.push_back(translateType(argMatch[2].str()) + " " + argName);
-                if(isDefinition) m_symbols.add(argName, translateType(argMatch[2].str()));
-            }
+            m_params.push_back({m_arena.concat({m_currentResolveType, "*"}), "self"});
         }
-        std::string cArgStr;
-        for (size_t i=0; i<cArgs.size(); ++i) {
-            cArgStr += cArgs[i] + (i < cArgs.size()-1 ? ", " : "");
+
+        forEachArg(fn.args, [&](std::string_view argName, std::string_view argType) {
+            if (!m_currentResolveType.empty() && (argName == "self" || (!m_soaFields.empty() && argName == "index"))) return;
+            const std::string_view cType = translateType(argType);
+            m_params.push_back({cType, argName});
+            if (func->definition) m_symbols.add(argName, cType);
+        });
+        Param* params = m_arena.makeArray<Param>(m_params.size());
+        std::copy(m_params.begin(), m_params.end(), params);
+        func->params = params;
+        func->paramCount = static_cast<std::uint32_t>(m_params.size());
+
+        if (func->definition && (m_header || m_inlineInstanceMethods) && !m_config.instrument) {
+            std::string attrs(func->attr);
+            const bool marked = takeAttribute(attrs, "inline");
+            const bool small = !func->owner.empty() && m_smallFunctions.count(m_lineNumber);
+            if (m_inlineInstanceMethods || marked || small || func->mods.find("inline") != std::string_view::npos) {
+                func->attr = m_arena.copy(attrs);
+                func->mods = "static inline";
+            }
         }
-        
-        std::string attrPrefix = "";
-        if (!attr.empty()) attrPrefix = "__attribute__((" + attr + ")) ";
-        
-        std::string result = indentation + attrPrefix + (mods.empty() ? "" : mods + " ") + ret_c + " " + name + "(" + cArgStr + ")";
 
-        if (isDefinition) {
+        if (func->definition) {
             if (opensBrace) m_braceDepth++;
-            m_symbols.pushScope();
-            return result + " {";
-        } else {
-            return result + ";";
+            openScope();
         }
+        return func;
     }
 
-    if (std::regex_search(out, match, R_VAR)) {
-        std::string mods = match[1].str();
-        std::string name = match[2].str();
-        std::string type = translateType(match[3].str());
-        std::string val = match[4].str();
-        m_symbols.add(name, match[3].str()); // Store Original Type (Packet) for lookup
+    if (VarDecl var; keyword == Keyword::Var && matchVar(out, var)) {
+        Node* decl = node(NodeKind::Var);
+        decl->mods = var.mods;
+        decl->type = translateType(var.type);
+        decl->name = var.name;
+        m_symbols.add(var.name, var.type); // Store Original Type (Packet) for lookup
+        if (m_scanning) return decl;
 
-        std::string res = indentation + (mods.empty() ? "" : mods + " ") + type + " " + name;
-        if (!val.empty()) {
-            val = replaceMethodCalls(val);
-            val = replacePipeOperators(val);
-            res += " = " + val;
+        // Lengths and constant initializers that use constants or const fns
+        // become literals, since C accepts neither in a file-scope initializer.
+        const bool constant = var.mods == "const";
+        decl->extent = var.extent;
+        if (!var.extent.empty() && (m_comptime.mentions(var.extent) || (constant && !var.value.empty()))) {
+            const std::optional<std::size_t> count = m_comptime.count(var.extent, m_constSizes);
+            if (!count || *count == 0) {
+                throw std::runtime_error("length of " + std::string(var.name) + " is not a positive compile-time constant");
+            }
+            decl->extent = m_arena.copy(std::to_string(*count));
+            if (constant && !var.value.empty() && var.value.front() != '{') {
+                // A table: the initializer is evaluated once per element, with `_` as its index.
+                std::string why;
+                const auto values = m_comptime.table(var.value, var.type, *count, m_constSizes, &why);
+                if (!values) throw std::runtime_error("table " + std::string(var.name) + " is not a compile-time constant: " + why);
+                decl->mods = "static const";
+                decl->text = m_arena.copy(formatTable(*values, printDepth));
+                return decl;
+            }
         }
-        res += ";";
-        return res;
+        if (constant && var.extent.empty() && m_comptime.mentions(var.value)) {
+            if (const auto value = m_comptime.evaluate(var.value, m_constSizes, var.type)) {
+                decl->text = m_arena.copy(constLiteral(*value));
+                return decl;
+            }
+        }
+        if (!var.value.empty()) decl->text = rewriteCalls(var.value);
+        return decl;
     }
+    if (head.isWord() && head.text == "assert_static") return assertStatic(out, printDepth);
 
-    out = replaceMethodCalls(out);
-    out = replacePipeOperators(out);
-    
-    if (std::regex_search(out, match, R_IF)) {
-        if (opensBrace) m_braceDepth++;
-        return indentation + "if (" + match[1].str() + ") {";
+    // Rewrites cannot affect pass state unless the line opens a block.
+    if (!m_scanning || opensBrace) out = rewriteCalls(out);
+
+    const Keyword statement = Lexer(out).peek().keyword();
+    std::string_view cond;
+    if (statement == Keyword::If && matchCondition(out, Keyword::If, cond)) {
+        if (opensBrace) openBlock();
+        Node* branch = node(NodeKind::If);
+        branch->text = profileCondition(cond);
+        return branch;
+    }
+    if (statement == Keyword::While && matchCondition(out, Keyword::While, cond)) {
+        if (opensBrace) openBlock();
+        Node* loop = node(NodeKind::While);
+        loop->attr = takeLoopHints();
+        loop->text = profileCondition(cond);
+        return loop;
     }
-    if (std::regex_search(out, match, R_WHILE)) {
-        if (opensBrace) m_braceDepth++;
-        return indentation + "while (" + match[1].str() + ") {";
+    if (statement == Keyword::Loop && matchLoop(out)) {
+        if (opensBrace) openBlock();
+        Node* loop = node(NodeKind::Loop);
+        loop->attr = takeLoopHints();
+        return loop;
     }
-    if (std::regex_search(out, match, R_LOOP)) {
-        if (opensBrace) m_braceDepth++;
-        return indentation + "while (1) {";
+    if (statement == Keyword::For) {
+        ForLoop loop;
+        if (!matchFor(out, loop)) throw std::runtime_error("expected `for name in from..to {` or `for name in slice[from..to] {`");
+        openBlock();
+        Node* f = node(NodeKind::For);
+        f->attr = takeLoopHints();
+        auto group = [&](std::string_view expr) { return isWordText(expr) ? expr : m_arena.concat({"(", expr, ")"}); };
+        if (loop.slice.empty()) {
+            // Bounds other than a name or literal are evaluated once, up front.
+            const std::string_view type = loop.type.empty() ? "int" : translateType(loop.type);
+            m_symbols.add(loop.name, loop.type.empty() ? "i32" : loop.type);
+            std::string_view init = m_arena.concat({type, " ", loop.name, " = ", loop.from});
+            std::string_view end = loop.to;
+            if (!isWordText(loop.to)) {
+                end = m_arena.concat({"onyx_end_", loop.name});
+                init = m_arena.concat({init, ", ", end, " = ", loop.to});
+            }
+            f->text = m_arena.concat({init, "; ", loop.name, " < ", end, "; ", loop.name, "++"});
+            return f;
+        }
+        // Slices walk an element pointer; the element is bound by value on the next line.
+        std::string_view element = loop.type;
+        if (element.empty() && isWordText(loop.slice)) {
+            const std::string_view sliceType = m_symbols.lookup(loop.slice);
+            if (sliceType.size() > 1 && sliceType.back() == '*') element = sliceType.substr(0, sliceType.size() - 1);
+        }
+        f->name = loop.name;
+        f->type = element.empty() ? m_arena.concat({"__typeof__(", group(loop.slice), "[0])"}) : translateType(element);
+        if (!element.empty()) m_symbols.add(loop.name, element);
+        // ivdep promises the body reaches the elements only through this loop.
+        const std::string_view at = m_arena.concat({"onyx_at_", loop.name});
+        f->text = m_arena.concat({f->type, hasAttribute(f->attr, "ivdep") ? " *restrict " : " *", at, " = ", group(loop.slice), " + ",
+                                  group(loop.from), ", *const onyx_end_", loop.name, " = ", group(loop.slice), " + ",
+                                  group(loop.to), "; ", at, " < onyx_end_", loop.name, "; ", at, "++"});
+        return f;
     }
     
     // Auto-semicolon for expressions
-    bool isWhitespace = std::regex_match(out, std::regex(R"(^\s*$)"));
-    bool isStatement = !out.empty() && !isWhitespace && !opensBrace && !closesBrace && out.back() != ';';
-    if (isStatement) {
-        out += ";";
-    }
+    const bool isStatement = !isBlank(out) && !opensBrace && !closesBrace && out.back() != ';';
 
-    if (opensBrace && !std::regex_search(out, R_SHARED_START) && !std::regex_search(out, R_STRUCT_START) && 
-        !std::regex_search(out, R_RESOLVE_START) && !std::regex_search(out, R_FUNC_SIGNATURE) && 
-        !std::regex_search(out, R_IF) && !std::regex_search(out, R_WHILE) && !std::regex_search(out, R_LOOP)) {
-            m_braceDepth++;
+    if (opensBrace) {
+        StructDecl decl;
+        if (!matchNamedBlock(out, Keyword::Shared, name) && !matchStruct(out, decl) &&
+            !matchNamedBlock(out, Keyword::Resolve, name) && !matchFunc(out) &&
+            !matchCondition(out, Keyword::If, cond) && !matchCondition(out, Keyword::While, cond) && !matchLoop(out)) {
+            openBlock();
+        }
     }
     
     // Fallback for generic lines (expressions, assignments, etc)
-    // Ensure we don't return empty line if it was just braces
-    if (out == "}" || out == "};") return indentation + out; 
-    if (out == "{") return indentation + out;
+    Node* generic = node(NodeKind::Line);
+    generic->text = out;
+    generic->semicolon = isStatement;
+    return generic;
+}
 
-    return indentation + out;
+// Every closing brace outside a struct pops a scope, so every other opening
+// brace pushes one.
+void Transpiler::openBlock() {
+    m_braceDepth++;
+    openScope();
 }
 
-std::string Transpiler::translateType(const std::string& onyxType) {
-    if (onyxType == "i32") return "int";
-    if (onyxType == "u32") return "uint32_t";
-    if (onyxType == "u8") return "uint8_t";
-    if (onyxType == "f32") return "float";
-    if (onyxType == "f64") return "double";
-    if (onyxType == "bool") return "bool";
-    if (onyxType == "str") return "char*";
-    if (onyxType == "ptr") return "void*";
-    if (onyxType == "void") return "void";
-    if (onyxType == "char") return "char"; // Explicitly map 'char'
-    if (onyxType.back() == '*') return translateType(onyxType.substr(0, onyxType.size()-1)) + "*";
-    return onyxType;
+void Transpiler::openScope() {
+    m_symbols.pushScope();
+    m_stats.peakScopeDepth = std::max<std::uint64_t>(m_stats.peakScopeDepth, m_symbols.depth());
 }
 
-std::string Transpiler::replaceMethodCalls(std::string line) {
-    static const std::regex R_METHOD_CALL(R"((["\w>]+)\.(\w+)\(([^)]*)\))");
-    std::string current = line;
-    std::smatch match;
-    while (std::regex_search(current, match, R_METHOD_CALL)) {
-        std::string varName = match[1].str();
-        std::string methodName = match[2].str();
-        std::string args = match[3].str();
-        std::string typeName = m_symbols.lookup(varName);
-        std::string replacement;
-        if (!typeName.empty()) {
-            std::string newArgs = "&" + varName; // Naive address-of
-            if (!args.empty()) newArgs += ", " + args;
-            replacement = typeName + "_" + methodName + "(" + newArgs + ")";
-            current = match.prefix().str() + replacement + match.suffix().str();
-        } else {
-            // Stop if we can't resolve, to avoid infinite loops or bad replacement
-             break;
+// Takes the loop hints off the pending attributes, spelled the way the
+// emitter expects them: "unroll(N), vectorize, ivdep".
+std::string_view Transpiler::takeLoopHints() {
+    if (m_pendingAttribute.empty()) return {};
+    std::string hints, count;
+    if (takeAttribute(m_pendingAttribute, "unroll", &count)) {
+        if (count.empty() || count.find_first_not_of("0123456789") != std::string::npos) {
+            throw std::runtime_error("unroll needs a constant count, as in @[unroll(4)]");
         }
+        hints = "unroll(" + count + ")";
     }
-    return current;
+    if (takeAttribute(m_pendingAttribute, "vectorize")) hints += hints.empty() ? "vectorize" : ", vectorize";
+    if (takeAttribute(m_pendingAttribute, "ivdep")) hints += hints.empty() ? "ivdep" : ", ivdep";
+    return m_arena.copy(hints);
 }
 
-std::string Transpiler::replacePipeOperators(std::string line) {
-    static const std::regex R_PIPE(R"((.+?)\s*\|>\s*([\w]+)\(([^)]*)\))");
-    std::string current = line;
-    std::smatch match;
-    while (std::regex_search(current, match, R_PIPE)) {
-        std::string arg1 = match[1].str();
-        std::string func = match[2].str();
-        std::string otherArgs = match[3].str();
-        
-        // Trim whitespace from the piped argument
-        arg1 = std::regex_replace(arg1, std::regex(R"(^\s+|\s+$)"), "");
+// Method-call and pipe sugar. Lines without either are returned as is.
+std::string_view Transpiler::rewriteCalls(std::string_view text) {
+    if (text.find('.') == std::string_view::npos && text.find("|>") == std::string_view::npos) return text;
+    return m_arena.copy(m_rewriter.rewrite(text));
+}
 
-        std::string finalArg = arg1;
-        std::string typeName = m_symbols.lookup(arg1);
-        // Heuristic: If the function name starts with the variable's type name,
-        // it's probably a resolve-style function call needing a pointer.
-        if (!typeName.empty() && func.rfind(typeName + "_", 0) == 0) {
-             finalArg = "&" + arg1;
+// Counts the condition's outcomes under --instrument, and states the likely
+// one when the profile shows a clear bias.
+std::string_view Transpiler::profileCondition(std::string_view cond) {
+    if (m_scanning) return cond;
+    if (m_config.instrument) {
+        cond = m_arena.concat({"onyx_prof_branch(", std::to_string(m_lineNumber), ", !!(", cond, "))"});
+    }
+    if (const int expected = m_profile ? m_profile->expected(m_lineNumber) : -1; expected >= 0) {
+        cond = m_arena.concat({"__builtin_expect(!!(", cond, "), ", expected ? "1" : "0", ")"});
+    }
+    return cond;
+}
+
+// comptime(expr) becomes the literal expr evaluates to; anything it cannot
+// evaluate is an error.
+std::string_view Transpiler::foldComptime(std::string_view text) {
+    std::string folded;
+    std::size_t copied = 0;
+    Lexer lex(text);
+    for (Token t = lex.next(); t.kind != TokenKind::End; t = lex.next()) {
+        if (!t.isWord() || t.text != "comptime" || !lex.peek().is('(')) continue;
+        const std::size_t open = lex.next().end();
+        Token close = lex.next();
+        for (int depth = 0; !(close.is(')') && depth == 0); close = lex.next()) {
+            if (close.kind == TokenKind::End) throw std::runtime_error("comptime( is never closed");
+            if (close.is('(')) depth++;
+            else if (close.is(')')) depth--;
         }
-        
-        std::string replacement;
-        std::regex placeholder_regex(R"(\b_\b)");
+        const std::string_view expr = trim(text.substr(open, close.offset - open));
+        std::string why;
+        const std::optional<ConstValue> value = m_comptime.evaluate(expr, m_constSizes, {}, &why);
+        if (!value) throw std::runtime_error("comptime(" + std::string(expr) + ") is not a compile-time constant: " + why);
+        const std::string literal = constLiteral(*value);
+        folded.append(text.substr(copied, t.offset - copied));
+        if (literal.front() == '-') folded.append("(").append(literal).append(")");
+        else folded.append(literal);
+        copied = close.end();
+    }
+    if (copied == 0) return text;
+    return m_arena.copy(folded.append(text.substr(copied)));
+}
 
-        if (std::regex_search(otherArgs, placeholder_regex)) {
-            // Placeholder exists: replace all occurrences of `_`
-            std::string newArgs = std::regex_replace(otherArgs, placeholder_regex, finalArg);
-            replacement = func + "(" + newArgs + ")";
-        } else {
-            // No placeholder: prepend as the first argument (default behavior)
-            std::string newArgs = finalArg;
-            if (!otherArgs.empty()) {
-                newArgs += ", " + otherArgs;
+// sizeof(type) for compile-time evaluation, under the LP64 layouts the
+// struct checks use. Types that hold pointers differ by target and, like
+// structs not yet defined, have no size here.
+std::optional<std::size_t> Transpiler::constSize(std::string_view type) {
+    TypeLayout layout;
+    if (!lookupLayout(translateType(type), m_structTypes, layout) || layout.pointerSized) return std::nullopt;
+    return layout.size;
+}
+
+// assert_static(cond, "message") is checked here when cond is a
+// compile-time constant and emits nothing. When the only unknowns are sizes
+// that differ by target it is left to the C compiler as _Static_assert, with
+// constants replaced by their values; anything else is an error.
+const Node* Transpiler::assertStatic(std::string_view text, int depth) {
+    if (m_scanning) return nullptr;
+    Lexer lex(text);
+    lex.next();
+    std::size_t from = 0, comma = 0, close = 0;
+    if (const Token open = lex.next(); open.is('(')) from = open.end();
+    for (int nest = 0; from && !close;) {
+        const Token t = lex.next();
+        if (t.kind == TokenKind::End) break;
+        if (t.is('(') || t.is('[')) nest++;
+        else if ((t.is(')') || t.is(']')) && nest-- == 0) close = t.offset;
+        else if (t.is(',') && nest == 0) comma = t.offset;
+    }
+    if (!close || !comma) throw std::runtime_error("expected assert_static(condition, \"message\")");
+    const std::string_view cond = trim(text.substr(from, comma - from));
+    const std::string_view message = trim(text.substr(comma + 1, close - comma - 1));
+    const std::string where = "assert_static on line " + std::to_string(m_lineNumber);
+
+    std::string why;
+    if (const auto holds = m_comptime.evaluate(cond, m_constSizes, "bool", &why)) {
+        if (!holds->bits) throw std::runtime_error(where + " failed: " + std::string(message));
+        return nullptr;
+    }
+    // Evaluate again with every unknown size filled in. If that succeeds,
+    // target-dependent sizes were all that was missing and C can decide.
+    bool guessed = false;
+    const ConstEvaluator::SizeOf anySize = [&](std::string_view type) -> std::optional<std::size_t> {
+        if (const auto size = constSize(type)) return size;
+        guessed = true;
+        TypeLayout layout;
+        return lookupLayout(translateType(type), m_structTypes, layout) ? layout.size : 1;
+    };
+    bool known = true;
+    try {
+        known = m_comptime.evaluate(cond, anySize, "bool", &why).has_value();
+    } catch (const std::runtime_error&) {
+        // An error the guessed sizes may have caused is the C compiler's call.
+        if (!guessed) throw;
+    }
+    if (!known) throw std::runtime_error(where + " is not a compile-time constant: " + why);
+
+    // C only accepts integer constant expressions, so constants and const fn
+    // calls become their values, and Onyx type names inside sizeof(...) are
+    // spelled as C.
+    std::string translated;
+    std::size_t copied = 0;
+    Lexer terms(cond);
+    for (Token t = terms.next(); t.kind != TokenKind::End; t = terms.next()) {
+        if (!t.isWord()) continue;
+        if (t.text == "sizeof" && terms.peek().is('(')) {
+            terms.next();
+            const Token type = terms.next();
+            if (!type.isWord()) continue;
+            translated.append(cond.substr(copied, type.offset - copied)).append(translateType(type.text));
+            copied = type.end();
+            continue;
+        }
+        if (!m_comptime.mentions(t.text)) continue;
+        std::size_t end = t.end();
+        while (terms.peek().is('(') || terms.peek().is('[')) {
+            int nest = 0;
+            for (Token u = terms.next(); u.kind != TokenKind::End; u = terms.next()) {
+                if (u.is('(') || u.is('[')) nest++;
+                else if ((u.is(')') || u.is(']')) && --nest == 0) {
+                    end = u.end();
+                    break;
+                }
             }
-            replacement = func + "(" + newArgs + ")";
         }
-        
-        current = match.prefix().str() + replacement + match.suffix().str();
+        const std::string_view term = cond.substr(t.offset, end - t.offset);
+        const auto value = m_comptime.evaluate(term, m_constSizes, {}, &why);
+        if (!value) {
+            throw std::runtime_error(where + ": " + std::string(term) +
+                                     " depends on a size that differs by target and is not a C constant");
+        }
+        const std::string literal = constLiteral(*value);
+        translated.append(cond.substr(copied, t.offset - copied));
+        if (literal.front() == '-') translated.append("(").append(literal).append(")");
+        else translated.append(literal);
+        copied = end;
+    }
+    translated.append(cond.substr(copied));
+    Node* check = m_arena.make<Node>();
+    check->kind = NodeKind::Line;
+    check->depth = depth;
+    check->text = m_arena.concat({"_Static_assert(", translated, ", ", message, ")"});
+    check->semicolon = true;
+    return check;
+}
+
+// Layout attributes of a struct are taken out of `attr` here; whatever is
+// left goes to __attribute__((...)).
+void Transpiler::beginStruct(std::string_view name, std::string& attr) {
+    m_structLayout = {};
+    m_structLayout.name = name;
+    m_structLayout.soa = takeAttribute(attr, "soa");
+    const bool sort = takeAttribute(attr, "reorder");
+    std::string hot, align;
+    m_hotFields.clear();
+    if (takeAttribute(attr, "hot", &hot)) {
+        forEachAttribute(hot, [&](std::string_view field) { m_hotFields.emplace_back(field); });
+    }
+    if (takeAttribute(attr, "align", &align)) {
+        if (!attr.empty()) attr += ", ";
+        attr.append("aligned(").append(align == "cacheline" ? std::to_string(CACHE_LINE) : align).append(")");
+    }
+    m_structLayout.sorted = sort;
+    m_structLayout.reordered = sort || !m_hotFields.empty();
+    m_structLayout.checked = m_structLayout.reordered || !align.empty();
+}
+
+void Transpiler::addStructField(std::string_view type, std::string_view name) {
+    FieldLayout field{std::string(type), std::string(name)};
+    field.hot = std::find(m_hotFields.begin(), m_hotFields.end(), name) != m_hotFields.end();
+    TypeLayout layout;
+    if (lookupLayout(type, m_structTypes, layout)) {
+        field.size = layout.size;
+        field.align = layout.align;
+        m_structLayout.pointerSized = m_structLayout.pointerSized || layout.pointerSized;
+    } else if (m_structLayout.known()) {
+        m_structLayout.unknownType = type;
+    }
+    m_structLayout.fields.push_back(std::move(field));
+}
+
+// Orders the fields and computes offsets once all of them are known.
+void Transpiler::endStruct() {
+    StructLayout& layout = m_structLayout;
+    for (const std::string& hot : m_hotFields) {
+        if (std::none_of(layout.fields.begin(), layout.fields.end(), [&](const FieldLayout& f) { return f.name == hot; })) {
+            throw std::runtime_error("@[hot] names no field " + hot + " of struct " + layout.name);
+        }
+    }
+    if (!layout.known()) {
+        // Fields held back still come out, in source order and unchecked.
+        if (layout.checked && !m_scanning) {
+            m_diagnostics.push_back("layout warning: struct " + layout.name + " not reordered or checked, layout of " +
+                                    layout.unknownType + " unknown");
+        }
+        layout.checked = false;
+    } else {
+        if (layout.reordered) reorderFields(layout, layout.sorted);
+        std::size_t minAlign = 1;
+        std::string_view aligned;
+        if (hasAttribute(m_currentStructAttribute, "aligned", &aligned)) {
+            minAlign = aligned.empty() ? 16 : std::strtoul(std::string(aligned).c_str(), nullptr, 0);
+        }
+        computeOffsets(layout, hasAttribute(m_currentStructAttribute, "packed"), std::max<std::size_t>(minAlign, 1));
+        m_structTypes[layout.name] = {layout.size, layout.align, layout.pointerSized};
+
+        std::size_t hotEnd = 0;
+        for (const FieldLayout& field : layout.fields) {
+            if (field.hot) hotEnd = std::max(hotEnd, field.offset + field.size);
+        }
+        if (hotEnd > CACHE_LINE && !m_scanning) {
+            m_diagnostics.push_back("layout warning: hot fields of struct " + layout.name + " span " +
+                                    std::to_string(hotEnd) + " bytes, more than one cache line");
+        }
+    }
+    if (m_config.layout_report && !m_scanning) m_layouts.push_back(layout);
+}
+
+// Field names of `type` when it is an @[soa] struct, with mixins expanded.
+std::vector<std::string> Transpiler::soaFieldNames(const std::string& type) const {
+    std::vector<std::string> names;
+    const auto it = m_soaStructs.find(type);
+    if (it == m_soaStructs.end()) return names;
+    for (const SoaMember& member : it->second) {
+        if (!member.mixin) {
+            names.push_back(member.name);
+            continue;
+        }
+        const auto mixin = m_sharedMixins.find(member.name);
+        if (mixin == m_sharedMixins.end()) continue;
+        for (const std::string& field : mixin->second) names.push_back(field.substr(field.rfind(' ') + 1));
+    }
+    return names;
+}
+
+// `Name<args>` spellings of known generics become their mangled names.
+std::string_view Transpiler::mangleGenerics(std::string_view text) {
+    GenericSpelling use;
+    std::string mangled;
+    std::size_t pos = 0;
+    for (std::size_t from = 0; nextGenericSpelling(text, from, use);) {
+        if (!m_generics.count(std::string(use.name))) {
+            from = use.begin + use.name.size() + 1;
+            continue;
+        }
+        mangled.append(text.substr(pos, use.begin - pos)).append(mangleGeneric(text.substr(use.begin, use.end - use.begin)));
+        pos = from = use.end;
     }
-    return current;
+    if (pos == 0) return text;
+    return m_arena.concat({mangled, text.substr(pos)});
+}
+
+// alloc<T>(r) and alloc_array<T>(r, n) become typed calls into the region
+// runtime; alloc<T>(p) on a pool takes one of its fixed-size objects. Pools
+// are told apart by the declared type of `p` (or of `q` in `*q`).
+std::string_view Transpiler::rewriteAllocs(std::string_view text) {
+    std::string rewritten;
+    std::size_t pos = 0;
+    for (std::size_t at = text.find("alloc"); at != std::string_view::npos; at = text.find("alloc", at + 1)) {
+        if (at > 0 && isWordChar(text[at - 1])) continue;
+        std::size_t i = at + 5;
+        const bool array = text.substr(i, 6) == "_array";
+        if (array) i += 6;
+        Lexer lex(text, i);
+        if (!lex.next().is('<')) continue;
+        const std::size_t typeStart = skipSpace(text, lex.position());
+        const std::size_t length = typeLength(text, typeStart);
+        Lexer args(text, typeStart + length);
+        if (length == 0 || !args.next().is('>') || !args.next().is('(')) continue;
+
+        const std::size_t argsStart = args.position();
+        std::size_t depth = 0, comma = std::string_view::npos, close = std::string_view::npos;
+        for (Token t = args.next(); t.kind != TokenKind::End && close == std::string_view::npos; t = args.next()) {
+            if (t.is('(') || t.is('[')) depth++;
+            else if ((t.is(')') || t.is(']')) && depth > 0) depth--;
+            else if (t.is(')')) close = t.offset;
+            else if (t.is(',') && depth == 0 && comma == std::string_view::npos) comma = t.offset;
+        }
+        const std::string_view call = array ? "alloc_array" : "alloc";
+        if (close == std::string_view::npos) throw std::runtime_error("unterminated " + std::string(call) + " call");
+        const std::string_view from = trim(text.substr(argsStart, std::min(comma, close) - argsStart));
+        const std::string_view count = comma == std::string_view::npos ? "" : trim(text.substr(comma + 1, close - comma - 1));
+        if (from.empty() || array == count.empty()) {
+            throw std::runtime_error(array ? "alloc_array<T> takes a region and a count" : "alloc<T> takes one region or pool");
+        }
+        std::string_view owner = from;
+        while (!owner.empty() && (owner.front() == '*' || isSpace(owner.front()))) owner.remove_prefix(1);
+        const bool pool = m_symbols.lookup(owner).substr(0, 9) == "onyx_pool";
+        if (pool && array) throw std::runtime_error("alloc_array<T> needs a region; pool " + std::string(owner) + " holds single objects");
+
+        const std::string_view type = translateType(text.substr(typeStart, length));
+        rewritten.append(text.substr(pos, at - pos)).append("((").append(type).append("*)");
+        if (pool) {
+            rewritten.append("onyx_pool_alloc(&(").append(from).append("), sizeof(").append(type).append("))");
+        } else {
+            rewritten.append(array ? "onyx_region_alloc_array(&(" : "onyx_region_alloc(&(").append(from).append("), ");
+            if (array) rewritten.append("(").append(rewriteAllocs(count)).append("), ");
+            rewritten.append("sizeof(").append(type).append("), __alignof__(").append(type).append("))");
+        }
+        rewritten.append(")");
+        pos = close + 1;
+        at = close;
+    }
+    if (pos == 0) return text;
+    return m_arena.concat({rewritten, text.substr(pos)});
+}
+
+// Primitive spellings map to C; anything else is passed through. Only
+// pointers to primitives need new text, which goes into the arena.
+std::string_view Transpiler::translateType(std::string_view onyxType) {
+    if (onyxType == "i32") return "int";
+    if (onyxType == "u32") return "uint32_t";
+    if (onyxType == "u8") return "uint8_t";
+    if (onyxType == "f32") return "float";
+    if (onyxType == "f64") return "double";
+    if (onyxType == "bool") return "bool";
+    if (onyxType == "str") return "char*";
+    if (onyxType == "ptr") return "void*";
+    if (onyxType == "void") return "void";
+    if (onyxType == "char") return "char"; // Explicitly map 'char'
+    if (!onyxType.empty() && onyxType.back() == '*') {
+        const std::size_t stars = onyxType.size() - onyxType.find_last_not_of('*') - 1;
+        const std::string_view base = onyxType.substr(0, onyxType.size() - std::min(stars, onyxType.size()));
+        const std::string_view translated = translateType(base);
+        if (translated == base) return onyxType;
+        return m_arena.concat({translated, onyxType.substr(base.size())});
+    }
+    return onyxType;
 }
 
-} // namespace onyx
\ No newline at end of file
+} // namespace onyx
@@ -1,48 +1,212 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
-#include <regex>
+#include <unordered_set>
 #include <filesystem>
-#include <deque>
+#include <optional>
+#include <memory>
+#include "Arena.hpp"
+#include "Ast.hpp"
+#include "Comptime.hpp"
+#include "Emitter.hpp"
+#include "Layout.hpp"
+#include "MappedFile.hpp"
+#include "Module.hpp"
+#include "Rewriter.hpp"
+#include "Simd.hpp"
+#include "OutputWriter.hpp"
+#include "Profile.hpp"
+#include "Region.hpp"
+#include "Stats.hpp"
+#include "SymbolTable.hpp"
 
 namespace onyx {
 
+class ThreadPool;
+
 struct TranspilerConfig {
     bool verbose = false;
     bool keep_comments = true;
+    bool parallel = true;           // split pass 2 into chunks when a thread pool is available
+    std::size_t chunk_lines = 4096; // minimum source lines per parallel chunk
+    std::filesystem::path cache_dir; // reuse earlier outputs for identical inputs; empty disables
+    std::filesystem::path depfile;   // write a Make/Ninja dependency file; empty disables
+    // Skip the discovery pass: mixins are collected while transpiling and
+    // forward `use` lines are back-patched once their mixin is seen. Each use
+    // takes the latest definition before it, or the first one after it. Runs
+    // serially.
+    bool single_pass = false;
+    // Searched for `@import`ed modules after the importing file's directory.
+    std::vector<std::filesystem::path> import_dirs;
+    // Record every struct's layout for layouts(). Bypasses the cache.
+    bool layout_report = false;
+    // Precede generated lines with `#line N "file.ox"` wherever the compiler's
+    // own count would not already name the right source line.
+    bool line_directives = false;
+    // Write a JSON map from each generated line to its source line; implies
+    // line_directives. Empty disables.
+    std::filesystem::path source_map;
+    // Count function entries and branch outcomes when the generated program
+    // runs; it appends the counts to a profile file on exit.
+    bool instrument = false;
+    // Counts from an instrumented run: functions get hot or cold attributes
+    // and lopsided conditions __builtin_expect.
+    std::shared_ptr<const Profile> profile;
+    // Move struct typedefs, prototypes and static inline bodies for small or
+    // @[inline] resolve methods into this header, which the .c includes.
+    // Needs the discovery pass and bypasses the cache. Empty disables.
+    std::filesystem::path header;
 };
 
 class Transpiler {
 public:
-    explicit Transpiler(TranspilerConfig config = {});
+    explicit Transpiler(TranspilerConfig config = {}, ThreadPool* pool = nullptr);
+    ~Transpiler();
     
     bool processFile(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath);
+    // Streams the C into `output` as it is produced, e.g. into a compiler's
+    // stdin. Bypasses the cache and the depfile; `output` is flushed but left open.
+    bool processFile(const std::filesystem::path& inputPath, OutputWriter& output);
+    // Transpiles `source` without touching the filesystem and appends the C to
+    // `output`; `name` is echoed in the header comment. Nothing from earlier
+    // calls leaks into this one, but buffers are reused, so one instance can
+    // serve many requests.
+    bool transpile(std::string_view source, std::string& output, std::string_view name = "input.ox");
+    // Also releases the memory earlier calls kept around for reuse.
+    void reset();
+    // Identifies the output transpile(source, output, name) would produce under
+    // this configuration and build. Independent of earlier calls. Sources with
+    // @import also depend on their modules, which this does not see.
+    [[nodiscard]] std::string cacheKey(std::string_view name, std::string_view source) const;
+
+    // Messages reported by the last call, in the order they occurred.
+    [[nodiscard]] const std::vector<std::string>& diagnostics() const { return m_diagnostics; }
+    [[nodiscard]] const PassTimings& timings() const { return m_stats.timings; }
+    [[nodiscard]] const TranspileStats& stats() const { return m_stats; }
+    // Files the last call read, input first, then imported modules.
+    [[nodiscard]] const std::vector<std::filesystem::path>& dependencies() const { return m_dependencies; }
+    // Struct layouts of the last call, in source order, when layout_report is set.
+    [[nodiscard]] const std::vector<StructLayout>& layouts() const { return m_layouts; }
 
 private:
+    // How much warm state a call may inherit. A long-lived instance keeps
+    // seeing new names and the odd huge file; past these, the next call
+    // starts cold instead of growing without bound.
+    static constexpr std::size_t WarmArenaBytes = 16u << 20;
+    static constexpr std::size_t WarmSymbols = 1u << 16;
+
     TranspilerConfig m_config;
-    std::string m_source;
-    std::deque<std::string> m_outputLines;
+    ThreadPool* m_pool = nullptr;
+    std::vector<std::string> m_diagnostics;
+    std::vector<std::filesystem::path> m_dependencies;
+    std::vector<StructLayout> m_layouts;
+    TranspileStats m_stats;
+    MappedFile m_source;
+    OutputWriter* m_output = nullptr;
+    Arena m_arena;              // this call's nodes and rewritten text; rewound per call
+    std::vector<Param> m_params; // scratch for function parameters
     
-    // Symbol Table
-    struct SymbolTable {
-        std::vector<std::unordered_map<std::string, std::string>> scopes;
-        void pushScope() { scopes.emplace_back(); }
-        void popScope() { if(!scopes.empty()) scopes.pop_back(); }
-        void add(const std::string& name, const std::string& type) {
-            if(!scopes.empty()) scopes.back()[name] = type;
-        }
-        std::string lookup(const std::string& name) {
-            for(auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
-                if(it->count(name)) return it->at(name);
-            }
-            return "";
-        }
-    } m_symbols;
+    SymbolTable m_symbols;
+    CallRewriter m_rewriter{m_symbols, m_stats};
+
+    // Imports. Modules are loaded once per run, keyed by canonical path, and
+    // every @import line becomes its module's rendered C, keyed by spelling.
+    struct Module;
+    std::unordered_map<std::string, std::unique_ptr<Module>> m_modules;
+    std::unordered_map<std::string, std::string> m_importText;
+    std::vector<std::uint64_t> m_importKeys;          // direct imports; part of the cache key
+    std::vector<std::filesystem::path> m_importStack; // modules being built, to catch cycles
+    InterfaceData* m_interface = nullptr;             // set while this instance builds one
+
+    // The header being split off (config.header). Types keep source order;
+    // all prototypes precede all bodies, so any body may call any function.
+    struct HeaderParts {
+        std::string types; // includes, imports, generic instances, struct typedefs
+        std::string prototypes;
+        std::string bodies; // static inline definitions
+    };
+    HeaderParts* m_header = nullptr;
+    enum class HeaderSection : std::uint8_t { None, Struct, Body };
+    HeaderSection m_headerSection = HeaderSection::None; // open construct whose lines go to the header
+    int m_headerEnd = 0;                                 // brace depth at which a Body section closes
+    std::unordered_set<std::size_t> m_smallFunctions;    // head lines of short bodies, from discovery
+    bool m_inlineInstanceMethods = false;                // generic instances rendered for a header
 
     // Context State
-    std::unordered_map<std::string, std::string> m_sharedMixins; 
+    // Mixin fields, already translated to "<c type> <name>".
+    std::unordered_map<std::string, std::vector<std::string>> m_sharedMixins;
+    // Members of each @[soa] struct: field names, or mixin names for `use`
+    // lines, which are expanded when a resolve block needs them.
+    struct SoaMember {
+        std::string name;
+        bool mixin = false;
+    };
+    std::unordered_map<std::string, std::vector<SoaMember>> m_soaStructs;
+    struct MixinDiscovery {
+        bool inside = false;
+        bool soa = false; // the block is an @[soa] struct, not a shared mixin
+        int depth = 0;
+        std::string name;
+        std::vector<std::string> fields;
+        std::vector<SoaMember> members;
+        std::string pendingAttribute;
+        std::size_t line = 0;      // of the line being discovered, from 1
+        int topDepth = 0;          // brace depth, to find the top-level line a use belongs to
+        std::size_t topLine = 0;   // last line that started at depth 0
+        std::vector<std::string>* generic = nullptr; // body of the generic definition being captured
+        std::size_t functionLine = 0; // head of the function body being measured
+        int functionDepth = 0;
+        int functionBody = 0;         // its statement lines so far
+        std::size_t constLine = 0;    // head of the const fn being captured
+        std::string constHead;
+        std::vector<std::string> constBody;
+    } m_discovery;
+
+    // Generics. Definitions are captured verbatim in discovery, together with
+    // every `Name<args>` spelling and the top-level line it occurs under. Each
+    // instantiation is then rendered once, as the source of an ordinary struct
+    // and resolve block under its mangled name, and emitted ahead of the
+    // declaration that first uses it.
+    struct Generic {
+        std::string attribute;                  // of the struct
+        std::vector<std::string> structParams;
+        std::vector<std::string> structLines;   // `struct Name<T> {` through `}`
+        std::vector<std::string> resolveParams;
+        std::vector<std::string> resolveLines;
+        std::vector<std::string> sharedParams;
+        std::vector<std::string> sharedLines;
+    };
+    std::unordered_map<std::string, Generic> m_generics;
+    std::vector<std::pair<std::string, std::size_t>> m_genericUses; // spelling, top-level line
+    std::unordered_set<std::string> m_instantiated;                 // mangled names
+    std::unordered_map<std::size_t, std::string> m_instances;       // top-level line -> rendered C
+    VectorSet m_vectorTypes = 0; // SIMD vector types the file names; their prelude follows the header comment
+    bool m_usesRegions = false;  // the region runtime follows the vector prelude
+    LayoutHeaders m_layoutHeaders = 0; // headers struct attributes need, ahead of both
+
+    // Compile-time evaluation. Discovery defines every const fn and top-level
+    // `var const`; pass 2 folds them into literals where C needs constants.
+    ConstEvaluator m_comptime;
+    const ConstEvaluator::SizeOf m_constSizes{[this](std::string_view type) { return constSize(type); }};
+
+    // Single-pass mode: output after the first unresolved `use` is held in
+    // m_deferredOutput until every pending use has been patched.
+    struct DeferredUse {
+        std::size_t offset = 0; // position in m_deferredOutput
+        std::string mixin;
+        int depth = 0;
+        std::string fallback;   // the line's output as transpiled without the mixin
+        std::optional<std::string> text;
+    };
+    std::vector<DeferredUse> m_deferredUses;
+    std::size_t m_unresolvedUses = 0;
+    std::string m_deferredOutput;
+    OutputWriter m_deferredWriter{0};
+    OutputWriter* m_streamOutput = nullptr;
+    std::optional<std::pair<std::string, int>> m_pendingUse; // mixin, indentation depth
     std::string m_currentResolveType; 
     int m_braceDepth = 0;
     
@@ -54,19 +218,108 @@ private:
     bool m_inStruct = false;
     int m_structStartDepth = 0;
     std::string m_currentStructName;
+    StructLayout m_structLayout;          // the current struct's fields, as they are emitted
+    std::vector<std::string> m_hotFields; // its @[hot] fields
+    std::unordered_map<std::string, TypeLayout> m_structTypes; // structs with a known layout so far
+    std::vector<std::string> m_soaFields;    // field names while in a resolve block for an @[soa] struct
+    bool m_insideNative = false;
+    int m_genericDepth = 0;  // brace depth inside a generic definition, which is not emitted
+    bool m_scanning = false; // boundary scan: only state changes matter, output is dropped
+
+    // #line directives
+    bool m_lineDirectives = false;
+    std::string m_sourcePath;    // as named in the directives
+    std::size_t m_lineNumber = 0; // source line being transpiled, from 1
+    std::size_t m_nextLine = 0;  // what the compiler takes the next output line to be; 0 when unknown
+    std::string m_rendered;      // scratch for counting a node's lines
+
+    const ProfileCounts* m_profile = nullptr; // this file's counts from profile
+
+    // Everything pass 2 carries from one line to the next.
+    struct PassState {
+        SymbolTable::Snapshot symbols;
+        std::string currentResolveType;
+        int braceDepth = 0;
+        std::string pendingAttribute;
+        std::string currentStructAttribute;
+        bool inShared = false;
+        int sharedStartDepth = 0;
+        bool inStruct = false;
+        int structStartDepth = 0;
+        std::string currentStructName;
+        StructLayout structLayout;
+        std::vector<std::string> hotFields;
+        std::unordered_map<std::string, TypeLayout> structTypes;
+        std::vector<std::string> soaFields;
+        bool insideNative = false;
+        int genericDepth = 0;
+    };
+    struct Chunk;
     
     // Passes
-    void loadFile(const std::filesystem::path& path);
-    void pass1_Discovery(const std::string& content); 
-    void pass2_Transpilation(const std::string& content); 
+    bool loadFile(const std::filesystem::path& path);
+    void beginRun();
+    void run(std::string_view source, std::string_view name);
+    std::string cacheKey(std::string_view name, std::string_view source, std::string_view sourcePath,
+                         const std::vector<std::uint64_t>& importKeys) const;
+    void writeDepfile(const std::filesystem::path& outputPath) const;
+    void writeHeader(std::string_view name) const;
+    bool routeHeader(const Node& node);
+    void loadImports(std::string_view source, const std::filesystem::path& dir);
+    std::filesystem::path findModule(std::string_view spelling, const std::filesystem::path& dir) const;
+    const Module& loadModule(const std::filesystem::path& path);
+    InterfaceData buildInterface(const std::filesystem::path& source, std::string_view text);
+    void collect(const Node& node);
+    void pass1_Discovery(std::string_view content);
+    void discoverLine(std::string_view line);
+    void defineMixin(const std::string& name, std::vector<std::string> fields);
+    void defineConstFunction();
+    void instantiateGenerics();
+    void instantiate(std::string_view spelling, std::string& out);
+    std::string substitute(const std::vector<std::string>& lines, const std::vector<std::string>& params,
+                           const std::vector<std::string_view>& args, std::string& out);
+    std::string renderInstance(std::string_view source, std::string_view name);
+    void pass2_Transpilation(std::string_view content); 
+    void pass2_Parallel(std::string_view content);
+    void runChunk(Chunk& chunk, std::string_view content) const;
     
     // Helpers
-    std::string translateType(const std::string& onyxType);
+    void emit(std::string_view line) { if (m_output) m_output->writeLine(line); }
+    void emit(const Node& node) {
+        if (m_interface) collect(node);
+        if (m_header && m_output && routeHeader(node)) return;
+        if (m_output && m_lineDirectives) emitMapped(node);
+        else if (m_output) emitNode(*m_output, node);
+    }
+    void emitMapped(const Node& node);
+    void writeSourceMap(const std::filesystem::path& outputPath) const;
+    void openBlock();
+    void openScope();
+    PassState saveState() const;
+    void restoreState(PassState state);
+    bool atTopLevel() const;
+    bool isInertLine(std::string_view line) const;
+    bool skimBodyLine(std::string_view line);
+    bool startsDeclaration(std::string_view line) const;
+    std::string_view translateType(std::string_view onyxType);
+    std::string_view mangleGenerics(std::string_view text);
+    std::string_view rewriteAllocs(std::string_view text);
+    std::string_view takeLoopHints();
+    std::string_view foldComptime(std::string_view text);
+    std::optional<std::size_t> constSize(std::string_view type);
+    std::vector<std::string> soaFieldNames(const std::string& type) const;
+    void beginStruct(std::string_view name, std::string& attr);
+    void addStructField(std::string_view type, std::string_view name);
+    void endStruct();
+    void deferUse(std::string mixin, int depth, std::string fallback);
+    void flushDeferred(bool final);
     
     // Line Processors
-    std::string processLine(const std::string& line);
-    std::string replaceMethodCalls(std::string line);
-    std::string replacePipeOperators(std::string line);
+    void transpileLine(std::string_view line);
+    const Node* processLine(std::string_view line);
+    std::string_view rewriteCalls(std::string_view text);
+    std::string_view profileCondition(std::string_view cond);
+    const Node* assertStatic(std::string_view text, int depth);
 };
 
 } // namespace onyx
@@ -0,0 +1,56 @@
+#!/bin/bash
+
+# oxc --cc returns the compiler's exit status, also when the compiler exits
+# before it has read the whole unit, and does not call that a transpile
+# failure.
+
+set -e
+
+BUILD_DIR="${BUILD_DIR:-build}"
+OXC_PATH="${OXC:-${BUILD_DIR}/oxc}"
+COMPILER="${CC:-clang}"
+WORK_DIR="${BUILD_DIR}/tests/cc_status"
+rm -rf "${WORK_DIR}"
+mkdir -p "${WORK_DIR}"
+
+# Far more C than a pipe buffers, so an early exit breaks the pipe.
+SRC="${WORK_DIR}/big.ox"
+{
+    echo '@include "stdio.h"'
+    for i in $(seq 20000); do
+        printf 'fn f%d(x: i32) -> i32 {\n    return x + %d\n}\n' "$i" "$i"
+    done
+    printf 'fn main() -> i32 {\n    return 0\n}\n'
+} > "${SRC}"
+
+# expect_status <name> <status> <oxc args...>
+expect_status() {
+    local name=$1 expected=$2
+    shift 2
+    local status=0
+    "${OXC_PATH}" "$@" 2> "${WORK_DIR}/${name}.err" || status=$?
+    if [ "${status}" -ne "${expected}" ]; then
+        echo "FAIL: ${name} exited ${status}, expected ${expected}"
+        cat "${WORK_DIR}/${name}.err"
+        exit 1
+    fi
+    if grep -q "failed to transpile\|transpilation Error" "${WORK_DIR}/${name}.err"; then
+        echo "FAIL: ${name} was reported as a transpile failure"
+        cat "${WORK_DIR}/${name}.err"
+        exit 1
+    fi
+    echo "ok: ${name}"
+}
+
+# A compiler that exits without reading its input.
+printf '#!/bin/sh\nexit 7\n' > "${WORK_DIR}/exit7"
+chmod +x "${WORK_DIR}/exit7"
+expect_status early_exit 7 "${SRC}" --cc "${WORK_DIR}/exit7"
+
+# A flag the compiler rejects; the status is whatever it returns for it.
+FLAG_STATUS=0
+"${COMPILER}" -x c - -fno-such-flag -o "${WORK_DIR}/none" < /dev/null 2> /dev/null || FLAG_STATUS=$?
+[ "${FLAG_STATUS}" -ne 0 ] || { echo "FAIL: ${COMPILER} accepted -fno-such-flag"; exit 1; }
+expect_status bad_flag "${FLAG_STATUS}" "${SRC}" --cc "${COMPILER}" -- -fno-such-flag -o "${WORK_DIR}/big"
+
+echo "--- Test Passed: cc_status ---"
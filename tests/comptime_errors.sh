@@ -0,0 +1,58 @@
+#!/bin/bash
+
+# assert_static and comptime() must be decided at transpile time: each
+# case below has to stop oxc with the given message, not reach the C compiler.
+
+set -e
+
+BUILD_DIR="${BUILD_DIR:-build}"
+OXC_PATH="${OXC:-${BUILD_DIR}/oxc}"
+WORK_DIR="${BUILD_DIR}/tests/comptime_errors"
+mkdir -p "${WORK_DIR}"
+
+# expect_error <name> <message> reads the Onyx source from stdin.
+expect_error() {
+    local src="${WORK_DIR}/$1.ox"
+    cat > "${src}"
+    if "${OXC_PATH}" "${src}" -o "${WORK_DIR}/$1.c" 2> "${WORK_DIR}/$1.err"; then
+        echo "FAIL: $1 transpiled"
+        exit 1
+    fi
+    if ! grep -qF "$2" "${WORK_DIR}/$1.err"; then
+        echo "FAIL: $1 did not report: $2"
+        cat "${WORK_DIR}/$1.err"
+        exit 1
+    fi
+    echo "ok: $1"
+}
+
+expect_error assert_false "assert_static on line 2 failed: \"too small\"" <<'OX'
+var const N: i32 = 4
+assert_static(N > 8, "too small")
+OX
+
+expect_error assert_runtime_call "assert_static on line 5 is not a compile-time constant: \`f\` is not a const fn" <<'OX'
+var const N: i32 = 4
+fn f() -> i32 {
+    return 4
+}
+assert_static(N == f(), "runtime call")
+OX
+
+expect_error assert_pointer_size_call "twice(sizeof(str)) depends on a size that differs by target" <<'OX'
+const fn twice(x: size_t) -> size_t {
+    return x * 2
+}
+assert_static(twice(sizeof(str)) == 16, "pointer pairs")
+OX
+
+expect_error comptime_runtime_call "comptime(g()) is not a compile-time constant" <<'OX'
+fn g() -> i32 {
+    return 1
+}
+fn main() -> i32 {
+    return comptime(g())
+}
+OX
+
+echo "--- Test Passed: comptime_errors ---"
@@ -0,0 +1,55 @@
+#!/bin/bash
+
+# With several inputs transpiled concurrently, diagnostics come out in input
+# order whichever file finishes first, a failure fails the run, and the files
+# that did transpile are still written.
+
+set -e
+
+BUILD_DIR="${BUILD_DIR:-build}"
+OXC_PATH="${OXC:-${BUILD_DIR}/oxc}"
+WORK_DIR="${BUILD_DIR}/tests/diagnostics_order"
+unset OXC_CACHE_DIR
+rm -rf "${WORK_DIR}"
+mkdir -p "${WORK_DIR}"
+
+# bad1.ox takes far longer than bad2.ox to reach its error, so bad2.ox
+# normally fails first.
+{
+    for i in $(seq 20000); do
+        printf 'fn f%d(x: i32) -> i32 {\n    return x + %d\n}\n' "$i" "$i"
+    done
+    printf 'region late {\n}\n'
+} > "${WORK_DIR}/bad1.ox"
+printf 'fn main() -> i32 {\n    return 0\n}\n' > "${WORK_DIR}/ok.ox"
+printf 'pool early<i32> {\n}\n' > "${WORK_DIR}/bad2.ox"
+
+cat > "${WORK_DIR}/expected.err" <<EOF
+transpilation Error: region late outside a function
+failed to transpile - ${WORK_DIR}/bad1.ox
+transpilation Error: pool early outside a function
+failed to transpile - ${WORK_DIR}/bad2.ox
+EOF
+
+for RUN in 1 2 3 4 5; do
+    rm -rf "${WORK_DIR}/out"
+    STATUS=0
+    "${OXC_PATH}" "${WORK_DIR}/bad1.ox" "${WORK_DIR}/ok.ox" "${WORK_DIR}/bad2.ox" -d "${WORK_DIR}/out" -j 3 \
+        2> "${WORK_DIR}/run.err" || STATUS=$?
+    if [ "${STATUS}" -ne 1 ]; then
+        echo "FAIL: run ${RUN} exited ${STATUS}, expected 1"
+        cat "${WORK_DIR}/run.err"
+        exit 1
+    fi
+    if ! diff -u "${WORK_DIR}/expected.err" "${WORK_DIR}/run.err"; then
+        echo "FAIL: run ${RUN} reported out of input order"
+        exit 1
+    fi
+    if [ ! -s "${WORK_DIR}/out/ok.c" ]; then
+        echo "FAIL: run ${RUN} did not write ok.c"
+        exit 1
+    fi
+    echo "ok: run ${RUN}"
+done
+
+echo "--- Test Passed: diagnostics_order ---"
@@ -0,0 +1,50 @@
+#!/bin/bash
+
+# A second run over unchanged sources is served from the cache without
+# touching the output, the depfile names the source and every imported
+# module, and editing a module forces a rebuild.
+
+set -e
+
+BUILD_DIR="${BUILD_DIR:-build}"
+OXC_PATH=$(realpath "${OXC:-${BUILD_DIR}/oxc}")
+WORK_DIR="${BUILD_DIR}/tests/output_cache"
+rm -rf "${WORK_DIR}"
+mkdir -p "${WORK_DIR}/src/modules" "${WORK_DIR}/out"
+cp tests/import.ox "${WORK_DIR}/src/"
+cp tests/modules/geometry.ox "${WORK_DIR}/src/modules/"
+cd "${WORK_DIR}"
+
+transpile() {
+    "${OXC_PATH}" src/import.ox -o out/import.c -MD --cache-dir cache --stats 2> stats.txt
+    head -n 1 stats.txt
+}
+
+fail() {
+    echo "FAIL: $1"
+    exit 1
+}
+
+FIRST=$(transpile)
+[ "${FIRST}" = "stats - src/import.ox" ] || fail "first run reported: ${FIRST}"
+MTIME=$(stat -c %y out/import.c)
+cp out/import.c first.c
+
+SECOND=$(transpile)
+[ "${SECOND}" = "stats - src/import.ox (cached)" ] || fail "second run reported: ${SECOND}"
+[ "$(stat -c %y out/import.c)" = "${MTIME}" ] || fail "cache hit rewrote the output"
+cmp first.c out/import.c
+
+DEPS="out/import.c: src/import.ox $(cd src/modules && pwd -P)/geometry.ox"
+[ "$(cat out/import.c.d)" = "${DEPS}" ] || fail "depfile is: $(cat out/import.c.d)"
+echo "ok: cache hit"
+
+# A new field in the imported struct has to reach the importer's output.
+sed -i 's/^    kind: u8$/    kind: u8\n    layer: u8/' src/modules/geometry.ox
+THIRD=$(transpile)
+[ "${THIRD}" = "stats - src/import.ox" ] || fail "run after editing the module reported: ${THIRD}"
+grep -q "layer" out/import.c || fail "output does not show the edited module"
+[ "$(cat out/import.c.d)" = "${DEPS}" ] || fail "depfile after rebuild is: $(cat out/import.c.d)"
+echo "ok: module edit rebuilds"
+
+echo "--- Test Passed: output_cache ---"
@@ -0,0 +1,53 @@
+#!/bin/bash
+
+# Every test source, split into parallel chunks of a few lines each, must
+# transpile byte-for-byte as the serial pass does, and count the same work.
+# chunks.ox puts native blocks, resolve blocks, mixins and attributes next to
+# the split points.
+
+set -e
+
+BUILD_DIR="${BUILD_DIR:-build}"
+OXC_PATH="${OXC:-${BUILD_DIR}/oxc}"
+WORK_DIR="${BUILD_DIR}/tests/parallel_chunks"
+unset OXC_CACHE_DIR
+rm -rf "${WORK_DIR}"
+mkdir -p "${WORK_DIR}"
+
+# chunks.ox has to be split for the comparison to mean anything.
+"${OXC_PATH}" tests/chunks.ox --chunk-lines 1 -j 4 -o "${WORK_DIR}/split.c" --stats=json > "${WORK_DIR}/split.json"
+if ! grep -qE '"chunks":([2-9]|[1-9][0-9]+)[,}]' "${WORK_DIR}/split.json"; then
+    echo "FAIL: chunks.ox was not split into several chunks"
+    cat "${WORK_DIR}/split.json"
+    exit 1
+fi
+
+# --stats without the numbers that legitimately vary: timings, allocations
+# and the chunk count.
+counters() {
+    sed -E 's/"seconds":\{[^}]*\}//; s/"(input|bytes_allocated|chunks)":("[^"]*"|[0-9]+)//g' "$1"
+}
+
+for SRC in tests/*.ox; do
+    NAME=$(basename "${SRC}" .ox)
+    FLAGS=""
+    if [ -f "tests/${NAME}.flags" ]; then
+        FLAGS=$(cat "tests/${NAME}.flags")
+    fi
+    "${OXC_PATH}" ${SRC} ${FLAGS} --serial -d "${WORK_DIR}/${NAME}/serial" --stats=json > "${WORK_DIR}/${NAME}.serial.json"
+    for LINES in 1 2 3 5 8; do
+        "${OXC_PATH}" ${SRC} ${FLAGS} -j 4 --chunk-lines ${LINES} -d "${WORK_DIR}/${NAME}/${LINES}" \
+            --stats=json > "${WORK_DIR}/${NAME}.${LINES}.json"
+        for OUT in "${WORK_DIR}/${NAME}/serial"/*; do
+            cmp "${OUT}" "${WORK_DIR}/${NAME}/${LINES}/$(basename "${OUT}")"
+        done
+        if [ "$(counters "${WORK_DIR}/${NAME}.serial.json")" != "$(counters "${WORK_DIR}/${NAME}.${LINES}.json")" ]; then
+            echo "FAIL: ${NAME} counts differently in chunks of ${LINES} lines"
+            cat "${WORK_DIR}/${NAME}.serial.json" "${WORK_DIR}/${NAME}.${LINES}.json"
+            exit 1
+        fi
+    done
+    echo "ok: ${NAME}"
+done
+
+echo "--- Test Passed: parallel_chunks ---"
@@ -0,0 +1,80 @@
+#!/bin/bash
+
+# Drives oxc --serve over stdin: transpile, a memo hit right after a file
+# request with imports, stats, reset and quit.
+
+set -e
+
+BUILD_DIR="${BUILD_DIR:-build}"
+OXC_PATH="${OXC:-${BUILD_DIR}/oxc}"
+WORK_DIR="${BUILD_DIR}/tests/serve"
+rm -rf "${WORK_DIR}"
+mkdir -p "${WORK_DIR}"
+
+# request <command> <payload> [name]
+request() {
+    printf '%s %d%s\n%s' "$1" "${#2}" "${3:+ $3}" "$2"
+}
+
+HELLO=$(cat tests/hello.ox)
+{
+    request file "tests/import.ox
+${WORK_DIR}/import.c"
+    request transpile "${HELLO}" hello.ox
+    request transpile "${HELLO}" hello.ox
+    request stats ""
+    request reset ""
+    request transpile "${HELLO}" hello.ox
+    request stats ""
+    request bogus ""
+    request quit ""
+    request transpile "${HELLO}" hello.ox
+} > "${WORK_DIR}/requests"
+
+"${OXC_PATH}" --serve -j 1 < "${WORK_DIR}/requests" > "${WORK_DIR}/replies"
+
+printf '%s\n' "${HELLO}" > "${WORK_DIR}/hello.ox"
+"${OXC_PATH}" "${WORK_DIR}/hello.ox" -o "${WORK_DIR}/hello.c"
+EXPECTED_C=$(cat "${WORK_DIR}/hello.c")
+
+REPLIES=()
+while read -r STATUS LENGTH; do
+    PAYLOAD=""
+    if [ "${LENGTH}" -gt 0 ]; then
+        read -r -N "${LENGTH}" PAYLOAD
+    fi
+    REPLIES+=("${STATUS}|${PAYLOAD}")
+done < "${WORK_DIR}/replies"
+
+expect() {
+    if [ "${REPLIES[$1]}" != "$2" ]; then
+        echo "FAIL: reply $1 is: ${REPLIES[$1]}"
+        echo "expected: $2"
+        exit 1
+    fi
+}
+
+expect_match() {
+    if [[ "${REPLIES[$1]}" != $2 ]]; then
+        echo "FAIL: reply $1 is: ${REPLIES[$1]}"
+        exit 1
+    fi
+}
+
+[ "${#REPLIES[@]}" -eq 9 ] || { echo "FAIL: expected 9 replies, got ${#REPLIES[@]}"; exit 1; }
+expect 0 "ok|"
+[ -f "${WORK_DIR}/import.c" ] || { echo "FAIL: file request wrote nothing"; exit 1; }
+expect 1 "ok|${EXPECTED_C}
+"
+expect 2 "ok|${EXPECTED_C}
+"
+expect_match 3 'ok|*"ok":true,"cached":true,*'
+expect 4 "ok|"
+expect 5 "ok|${EXPECTED_C}
+"
+expect_match 6 'ok|*"ok":true,"cached":false,*'
+expect 7 "error|unknown request - bogus
+"
+expect 8 "ok|"
+
+echo "--- Test Passed: serve ---"